@@ -2,13 +2,17 @@
 #include "StarfoundGameMode.h"
 #include "DrawDebugHelpers.h"
 #include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
 
 // Sets default values
 ABlockActor::ABlockActor()
 {
-	PrimaryActorTick.bCanEverTick = true;
+	// Nothing to do every frame. Blueprints with a tick event turn it back on.
+	PrimaryActorTick.bCanEverTick = false;
 
 	bTemporal = false;
+	InstancedMesh = nullptr;
+	BlockSceneCell = FIntPoint(INDEX_NONE, INDEX_NONE);
 }
 
 // Called when the game starts or when spawned
@@ -67,13 +71,7 @@ void ABlockActor::TransformUpdated(USceneComponent* RootComponent, EUpdateTransf
 	}
 }
 
-void ABlockActor::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
-
-}
-
-void UBlockGenerator::GenerateRandomBlockWorld(UWorld* World, const TArray<TSubclassOf<ABlockActor>>& BlockClasses)
+void UBlockGenerator::GenerateRandomBlockWorld(UWorld* World, const TArray<TSubclassOf<ABlockActor>>& BlockClasses, ABlockInstanceActor* BlockInstances)
 {
 	if (!ensure(BlockClasses.Num() != 0))
 	{
@@ -84,13 +82,35 @@ void UBlockGenerator::GenerateRandomBlockWorld(UWorld* World, const TArray<TSubc
 	const int32 SizeY = 20;
 	const int32 SizeZ = 20;
 
-	// Hole
-	const FBox2D StartingArea(FVector2D(-8, -1), FVector2D(8, 4));
-	const int32 HolePercentage = 30;
+	TArray<FIntPoint> Locations;
+	GenerateRandomBlockLocations(SizeY, SizeZ, Locations);
 
 	FActorSpawnParameters ActorSpawnParam;
 	ActorSpawnParam.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
 
+	for (const FIntPoint& Location : Locations)
+	{
+		const int32 ClassIndex = FMath::Rand() % BlockClasses.Num();
+
+		TSubclassOf<ABlockActor> BlockClass = BlockClasses[ClassIndex];
+		const FVector BlockLocation(0, Location.X * 100, Location.Y * 100);
+
+		if (BlockInstances && ABlockInstanceActor::CanInstance(BlockClass))
+		{
+			BlockInstances->AddBlock(BlockLocation, BlockClass);
+			continue;
+		}
+
+		World->SpawnActor<ABlockActor>(BlockClass, FTransform(BlockLocation), ActorSpawnParam);
+	}
+}
+
+void UBlockGenerator::GenerateRandomBlockLocations(int32 SizeY, int32 SizeZ, TArray<FIntPoint>& OutLocations)
+{
+	// Hole
+	const FBox2D StartingArea(FVector2D(-8, -1), FVector2D(8, 4));
+	const int32 HolePercentage = 30;
+
 	for (int32 Y = -SizeY; Y <= SizeY; ++Y)
 	{
 		for (int32 Z = -SizeZ; Z <= SizeZ; ++Z)
@@ -105,11 +125,7 @@ void UBlockGenerator::GenerateRandomBlockWorld(UWorld* World, const TArray<TSubc
 				continue;
 			}
 
-			const int32 ClassIndex = FMath::Rand() % BlockClasses.Num();
-
-			TSubclassOf<ABlockActor> BlockClass = BlockClasses[ClassIndex];
-
-			World->SpawnActor<ABlockActor>(BlockClass, FTransform(FVector(0, Y * 100, Z * 100)), ActorSpawnParam);
+			OutLocations.Add(FIntPoint(Y, Z));
 		}
 	}
 }
@@ -121,57 +137,170 @@ void UBlockActorScene::InitializeGrid(float InGridCellSize, int32 InGridX, int32
 	GridY = InGridY;
 
 	// *4 for negative area
-	const int32 NumCols = (GridX * 2) + 1;
 	const int32 NumRows = (GridY * 2) + 1;
 
-	BlockActors.AddZeroed(NumCols * NumRows);
+	Chunks.Reset();
+	OccupiedBits.Init(0, GetNumRowWords() * NumRows);
 }
 
 void UBlockActorScene::RegisterBlockActor(ABlockActor* BlockActor)
 {
-	BlockActors.Remove(BlockActor);
+	const FIntPoint Cell = WorldSpaceToOriginSpaceGrid(BlockActor->GetActorLocation());
 
-	int32 OldIndex = BlockActors.Find(BlockActor);
-	if (OldIndex != INDEX_NONE)
+	if (Cell.X < 0 || Cell.X >= GetNumGridX())
 	{
-		BlockActors[OldIndex] = nullptr;
+		ensure(0);
+		return;
 	}
 
-	const int32 X = FMath::RoundToInt(BlockActor->GetActorLocation().Y / GridCellSize);
-	const int32 Y = FMath::RoundToInt(BlockActor->GetActorLocation().Z / GridCellSize);
-
-	if (X < -GridX || X > GridX)
+	if (Cell.Y < 0 || Cell.Y >= GetNumGridY())
 	{
 		ensure(0);
 		return;
 	}
 
-	if (Y < -GridY || Y > GridY)
+	FIntPoint OldCell;
+	const bool bRegistered = FindBlockActorCell(BlockActor, OldCell);
+
+	if (bRegistered && OldCell == Cell)
 	{
-		ensure(0);
+		// Moved within its cell
 		return;
 	}
 
-	const int32 OriginX = GetOriginX();
-	const int32 OriginY = GetOriginY();
-	const int32 XFromOrigin = X - OriginX;
-	const int32 YFromOrigin = Y - OriginY;
-	const int32 NumCols = (GridX * 2) + 1;
-	const int32 Index = (XFromOrigin * NumCols) + YFromOrigin;
+	if (bRegistered)
+	{
+		SetBlockAtCell(OldCell, nullptr);
+	}
+
+	// An instanced block gives its cell up to the actor, a promoted one for instance
+	if (BlockInstances && EnumHasAnyFlags(GetBlockFlags(Cell.X, Cell.Y), EBlockCellFlags::Instanced))
+	{
+		BlockInstances->RemoveInstance(Cell);
+	}
 
-	BlockActors[Index] = BlockActor;
+	SetBlockAtCell(Cell, BlockActor);
 }
 
 void UBlockActorScene::UnRegisterBlockActor(ABlockActor* BlockActor)
 {
-	int32 OldIndex = BlockActors.Find(BlockActor);
-	if (OldIndex != INDEX_NONE)
+	FIntPoint OldCell;
+	if (FindBlockActorCell(BlockActor, OldCell))
 	{
-		BlockActors[OldIndex] = nullptr;
+		SetBlockAtCell(OldCell, nullptr);
 	}
 }
 
-ABlockActor* UBlockActorScene::GetBlock(int32 X, int32 Y) const
+bool UBlockActorScene::RegisterInstancedBlock(const FIntPoint& Cell, UClass* BlockClass)
+{
+	if (Cell.X < 0 || Cell.X >= GetNumGridX() || Cell.Y < 0 || Cell.Y >= GetNumGridY())
+	{
+		ensure(0);
+		return false;
+	}
+
+	if (HasBlock(Cell.X, Cell.Y))
+	{
+		return false;
+	}
+
+	SetBlockAtCell(Cell, nullptr, BlockClass);
+
+	return true;
+}
+
+void UBlockActorScene::SetBlockAtCell(const FIntPoint& Cell, ABlockActor* BlockActor, UClass* BlockClass)
+{
+	const bool bHasBlock = (BlockActor != nullptr) || (BlockClass != nullptr);
+
+	const FIntPoint ChunkLocation(Cell.X >> ChunkShift, Cell.Y >> ChunkShift);
+	const int32 Index = ((Cell.Y & ChunkMask) * ChunkSize) + (Cell.X & ChunkMask);
+
+	FBlockChunk* Chunk = Chunks.Find(ChunkLocation);
+
+	if (!Chunk)
+	{
+		if (!bHasBlock)
+		{
+			return;
+		}
+
+		Chunk = &Chunks.Add(ChunkLocation);
+		Chunk->Blocks.AddZeroed(ChunkSize * ChunkSize);
+		Chunk->BlockTypes.AddZeroed(ChunkSize * ChunkSize);
+		Chunk->BlockFlags.AddZeroed(ChunkSize * ChunkSize);
+	}
+
+	ABlockActor* OldBlockActor = Chunk->Blocks[Index];
+	const bool bHadBlock = EnumHasAnyFlags(Chunk->BlockFlags[Index], EBlockCellFlags::Solid);
+
+	// A block registered over another one takes its cell
+	if (OldBlockActor)
+	{
+		OldBlockActor->BlockSceneCell = FIntPoint(INDEX_NONE, INDEX_NONE);
+	}
+
+	Chunk->Blocks[Index] = BlockActor;
+
+	if (BlockActor)
+	{
+		BlockActor->BlockSceneCell = Cell;
+
+		EBlockCellFlags Flags = EBlockCellFlags::Solid;
+
+		if (BlockActor->IsTemporal())
+		{
+			Flags |= EBlockCellFlags::Temporal;
+		}
+
+		if (BlockActor->FindComponentByClass<UStorageComponent>())
+		{
+			Flags |= EBlockCellFlags::Storage;
+		}
+
+		Chunk->BlockTypes[Index] = FindOrAddBlockType(BlockActor->GetClass());
+		Chunk->BlockFlags[Index] = Flags;
+	}
+	else if (BlockClass)
+	{
+		Chunk->BlockTypes[Index] = FindOrAddBlockType(BlockClass);
+		Chunk->BlockFlags[Index] = EBlockCellFlags::Solid | EBlockCellFlags::Instanced;
+	}
+	else
+	{
+		Chunk->BlockTypes[Index] = 0;
+		Chunk->BlockFlags[Index] = EBlockCellFlags::None;
+	}
+
+	if (bHadBlock != bHasBlock)
+	{
+		Chunk->NumBlocks += bHadBlock ? -1 : 1;
+
+		if (Chunk->NumBlocks == 0)
+		{
+			Chunks.Remove(ChunkLocation);
+		}
+
+		OccupiedBits[(Cell.Y * GetNumRowWords()) + (Cell.X / 64)] ^= 1ull << (Cell.X % 64);
+
+		BlockCellChangedEvent.Broadcast(Cell);
+	}
+}
+
+bool UBlockActorScene::FindBlockActorCell(const ABlockActor* BlockActor, FIntPoint& OutCell) const
+{
+	// The cell may be of another scene
+	if (GetBlock(BlockActor->BlockSceneCell) != BlockActor)
+	{
+		return false;
+	}
+
+	OutCell = BlockActor->BlockSceneCell;
+
+	return true;
+}
+
+const FBlockChunk* UBlockActorScene::FindChunk(int32 X, int32 Y, int32& OutIndex) const
 {
 	if (X < 0 || X >= GetNumGridX())
 	{
@@ -183,9 +312,57 @@ ABlockActor* UBlockActorScene::GetBlock(int32 X, int32 Y) const
 		return nullptr;
 	}
 
-	const int32 Index = (X * GetNumGridX()) + Y;
+	OutIndex = ((Y & ChunkMask) * ChunkSize) + (X & ChunkMask);
+
+	return Chunks.Find(FIntPoint(X >> ChunkShift, Y >> ChunkShift));
+}
+
+uint16 UBlockActorScene::FindOrAddBlockType(UClass* BlockClass)
+{
+	const uint16* BlockType = BlockTypes.Find(BlockClass);
+
+	if (BlockType)
+	{
+		return *BlockType;
+	}
+
+	if (!ensure(BlockTypeClasses.Num() < MAX_uint16))
+	{
+		return 0;
+	}
+
+	BlockTypeClasses.Add(BlockClass);
+
+	return BlockTypes.Add(BlockClass, (uint16)BlockTypeClasses.Num());
+}
+
+ABlockActor* UBlockActorScene::GetBlock(int32 X, int32 Y) const
+{
+	int32 Index;
+	const FBlockChunk* Chunk = FindChunk(X, Y, Index);
+
+	return Chunk ? Chunk->Blocks[Index] : nullptr;
+}
+
+uint16 UBlockActorScene::GetBlockType(int32 X, int32 Y) const
+{
+	int32 Index;
+	const FBlockChunk* Chunk = FindChunk(X, Y, Index);
 
-	return BlockActors[Index];
+	return Chunk ? Chunk->BlockTypes[Index] : 0;
+}
+
+UClass* UBlockActorScene::GetBlockTypeClass(uint16 BlockType) const
+{
+	return (BlockType > 0 && BlockType <= BlockTypeClasses.Num()) ? BlockTypeClasses[BlockType - 1] : nullptr;
+}
+
+EBlockCellFlags UBlockActorScene::GetBlockFlags(int32 X, int32 Y) const
+{
+	int32 Index;
+	const FBlockChunk* Chunk = FindChunk(X, Y, Index);
+
+	return Chunk ? Chunk->BlockFlags[Index] : EBlockCellFlags::None;
 }
 
 ABlockActor* UBlockActorScene::GetBlock(const FIntPoint& Location) const
@@ -193,6 +370,73 @@ ABlockActor* UBlockActorScene::GetBlock(const FIntPoint& Location) const
 	return GetBlock(Location.X, Location.Y);
 }
 
+bool UBlockActorScene::HasBlock(int32 X, int32 Y) const
+{
+	if (X < 0 || X >= GetNumGridX() || Y < 0 || Y >= GetNumGridY())
+	{
+		return false;
+	}
+
+	return (OccupiedBits[(Y * GetNumRowWords()) + (X / 64)] >> (X % 64)) & 1;
+}
+
+const uint64* UBlockActorScene::GetOccupiedRow(int32 Y) const
+{
+	if (Y < 0 || Y >= GetNumGridY())
+	{
+		return nullptr;
+	}
+
+	return &OccupiedBits[Y * GetNumRowWords()];
+}
+
+void UBlockActorScene::GetChunkLocations(TArray<FIntPoint>& OutChunkLocations) const
+{
+	Chunks.GetKeys(OutChunkLocations);
+}
+
+void UBlockActorScene::GetChunkMeshInput(const FIntPoint& ChunkLocation, EBlockCellFlags MeshedFlags, FBlockChunkMeshInput& OutInput) const
+{
+	const int32 NumRingCells = (ChunkSize + 2) * (ChunkSize + 2);
+
+	OutInput.Chunk = ChunkLocation;
+	OutInput.ChunkSize = ChunkSize;
+	OutInput.Version = 0;
+	OutInput.MeshedTypes.Init(0, NumRingCells);
+	OutInput.Solid.Init(false, NumRingCells);
+
+	const FBlockChunk* Chunk = Chunks.Find(ChunkLocation);
+	const int32 FirstX = ChunkLocation.X * ChunkSize;
+	const int32 FirstY = ChunkLocation.Y * ChunkSize;
+
+	// The ring only needs to be solid or not, and the bit rows have that for any chunk
+	for (int32 Y = -1; Y <= ChunkSize; ++Y)
+	{
+		for (int32 X = -1; X <= ChunkSize; ++X)
+		{
+			OutInput.Solid[OutInput.GetIndex(X, Y)] = HasBlock(FirstX + X, FirstY + Y);
+		}
+	}
+
+	if (!Chunk)
+	{
+		return;
+	}
+
+	for (int32 Y = 0; Y < ChunkSize; ++Y)
+	{
+		for (int32 X = 0; X < ChunkSize; ++X)
+		{
+			const int32 Index = (Y * ChunkSize) + X;
+
+			if (EnumHasAnyFlags(Chunk->BlockFlags[Index], MeshedFlags))
+			{
+				OutInput.MeshedTypes[OutInput.GetIndex(X, Y)] = Chunk->BlockTypes[Index];
+			}
+		}
+	}
+}
+
 void UBlockActorScene::DebugDrawBoxAt(const FIntPoint& OriginSpaceGridLocation, const FColor& Color) const
 {
 	FVector Location = OriginSpaceGridToWorldSpace(OriginSpaceGridLocation);
@@ -204,17 +448,13 @@ void UBlockActorScene::DebugDraw() const
 {
 	int32 NumActiveBlocks = 0;
 
-	const int32 NumBlocks = BlockActors.Num();
-	for (int32 Index = 0; Index < NumBlocks; ++Index)
+	for (const TPair<FIntPoint, FBlockChunk>& Chunk : Chunks)
 	{
-		if (BlockActors[Index])
-		{
-			++NumActiveBlocks;
-		}
+		NumActiveBlocks += Chunk.Value.NumBlocks;
 	}
 
 	GEngine->AddOnScreenDebugMessage((uint64)(this + 0), 0, FColor::White,
-		FString::Printf(TEXT("Active Blocks: %4d"), NumActiveBlocks));
+		FString::Printf(TEXT("Active Blocks: %4d in %d chunks"), NumActiveBlocks, Chunks.Num()));
 }
 
 UBlockActorScene* GetBlockActorScene(UWorld* World)
@@ -224,6 +464,316 @@ UBlockActorScene* GetBlockActorScene(UWorld* World)
 	return BlockScene;
 }
 
+ABlockInstanceActor::ABlockInstanceActor()
+	: bMeshChunks(false)
+{
+	// Only chunk meshing ticks
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+void ABlockInstanceActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (BlockScene)
+	{
+		BlockScene->OnBlockCellChanged().RemoveAll(this);
+	}
+
+	// Meshes in flight finish on their own, nobody picks them up
+	MeshBuilder.Reset();
+}
+
+void ABlockInstanceActor::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!bMeshChunks || !BlockScene)
+	{
+		return;
+	}
+
+	// Once per chunk however many of its cells changed this frame
+	for (const FIntPoint& ChunkLocation : DirtyChunks)
+	{
+		FBlockChunkMeshInput Input;
+		BlockScene->GetChunkMeshInput(ChunkLocation, EBlockCellFlags::Instanced, Input);
+		Input.Version = ChunkVersions.FindRef(ChunkLocation);
+
+		MeshBuilder->Dispatch(MoveTemp(Input), BlockScene->GetGridCellSize());
+	}
+
+	DirtyChunks.Reset();
+
+	FBlockChunkMesh Mesh;
+
+	while (MeshBuilder->PopMesh(Mesh))
+	{
+		// The chunk changed again since, its newer mesh is on the way
+		if (Mesh.Version == ChunkVersions.FindRef(Mesh.Chunk))
+		{
+			ApplyChunkMesh(*BlockScene, Mesh);
+		}
+	}
+}
+
+void ABlockInstanceActor::SetMeshChunks(bool bInMeshChunks)
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!BlockScene || bMeshChunks == bInMeshChunks || !ensure(CellInstances.Num() == 0 && ChunkVersions.Num() == 0))
+	{
+		return;
+	}
+
+	bMeshChunks = bInMeshChunks;
+	SetActorTickEnabled(bMeshChunks);
+
+	if (bMeshChunks)
+	{
+		MeshBuilder = MakeUnique<FBlockChunkMeshBuilder>();
+
+		// Any block can hide or uncover a face of an instanced one
+		BlockScene->OnBlockCellChanged().AddUObject(this, &ABlockInstanceActor::OnBlockCellChanged);
+	}
+	else
+	{
+		BlockScene->OnBlockCellChanged().RemoveAll(this);
+
+		MeshBuilder.Reset();
+	}
+}
+
+bool ABlockInstanceActor::CanInstance(TSubclassOf<ABlockActor> BlockClass)
+{
+	return BlockClass && BlockClass->GetDefaultObject<ABlockActor>()->GetInstancedMesh() != nullptr;
+}
+
+bool ABlockInstanceActor::AddBlock(const FVector& Location, TSubclassOf<ABlockActor> BlockClass)
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!BlockScene || !ensure(CanInstance(BlockClass)))
+	{
+		return false;
+	}
+
+	const FIntPoint Cell = BlockScene->WorldSpaceToOriginSpaceGrid(Location);
+
+	if (!BlockScene->RegisterInstancedBlock(Cell, BlockClass))
+	{
+		return false;
+	}
+
+	// The cell change marked its chunk
+	if (bMeshChunks)
+	{
+		return true;
+	}
+
+	const uint16 BlockType = BlockScene->GetBlockType(Cell.X, Cell.Y);
+	UHierarchicalInstancedStaticMeshComponent* Component = FindOrAddComponent(BlockType, BlockClass);
+
+	FCellInstance CellInstance;
+	CellInstance.BlockType = BlockType;
+	CellInstance.Instance = Component->AddInstanceWorldSpace(FTransform(BlockScene->OriginSpaceGridToWorldSpace(Cell)));
+
+	TypeInstanceCells[BlockType].Add(Cell);
+	CellInstances.Add(Cell, CellInstance);
+
+	return true;
+}
+
+ABlockActor* ABlockInstanceActor::PromoteBlock(const FIntPoint& Cell)
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!BlockScene || !EnumHasAnyFlags(BlockScene->GetBlockFlags(Cell.X, Cell.Y), EBlockCellFlags::Instanced))
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	// Registering the actor drops the instance
+	return GetWorld()->SpawnActor<ABlockActor>(BlockScene->GetBlockTypeClass(BlockScene->GetBlockType(Cell.X, Cell.Y)),
+		FTransform(BlockScene->OriginSpaceGridToWorldSpace(Cell)), SpawnParameters);
+}
+
+bool ABlockInstanceActor::GetHitCell(const FHitResult& HitResult, FIntPoint& OutCell) const
+{
+	if (bMeshChunks)
+	{
+		UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+		if (!BlockScene || HitResult.GetActor() != this)
+		{
+			return false;
+		}
+
+		// Half a cell into the face that was hit
+		OutCell = BlockScene->WorldSpaceToOriginSpaceGrid(HitResult.ImpactPoint - (HitResult.ImpactNormal * BlockScene->GetGridCellSize() * 0.5f));
+
+		return EnumHasAnyFlags(BlockScene->GetBlockFlags(OutCell.X, OutCell.Y), EBlockCellFlags::Instanced);
+	}
+
+	const int32 BlockType = TypeComponents.Find(Cast<UHierarchicalInstancedStaticMeshComponent>(HitResult.Component.Get()));
+
+	if (BlockType == INDEX_NONE || !TypeInstanceCells[BlockType].IsValidIndex(HitResult.Item))
+	{
+		return false;
+	}
+
+	OutCell = TypeInstanceCells[BlockType][HitResult.Item];
+
+	return true;
+}
+
+void ABlockInstanceActor::RemoveInstance(const FIntPoint& Cell)
+{
+	// The cell stays solid, so only its own chunk changes
+	if (bMeshChunks)
+	{
+		MarkChunkDirty(Cell / UBlockActorScene::GetChunkSize());
+		return;
+	}
+
+	FCellInstance CellInstance;
+
+	if (!CellInstances.RemoveAndCopyValue(Cell, CellInstance))
+	{
+		return;
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* Component = TypeComponents[CellInstance.BlockType];
+	TArray<FIntPoint>& InstanceCells = TypeInstanceCells[CellInstance.BlockType];
+
+	// Instance indices are the positions in InstanceCells. Move the last instance into the hole, then remove the last one,
+	// which leaves every other index alone.
+	const int32 LastInstance = InstanceCells.Num() - 1;
+
+	if (CellInstance.Instance != LastInstance)
+	{
+		FTransform LastTransform;
+		Component->GetInstanceTransform(LastInstance, LastTransform, true);
+		Component->UpdateInstanceTransform(CellInstance.Instance, LastTransform, true, true);
+
+		InstanceCells[CellInstance.Instance] = InstanceCells[LastInstance];
+		CellInstances[InstanceCells[CellInstance.Instance]].Instance = CellInstance.Instance;
+	}
+
+	Component->RemoveInstance(LastInstance);
+	InstanceCells.Pop(false);
+}
+
+UHierarchicalInstancedStaticMeshComponent* ABlockInstanceActor::FindOrAddComponent(uint16 BlockType, UClass* BlockClass)
+{
+	if (TypeComponents.Num() <= BlockType)
+	{
+		TypeComponents.SetNumZeroed(BlockType + 1);
+		TypeInstanceCells.SetNum(BlockType + 1);
+	}
+
+	if (!TypeComponents[BlockType])
+	{
+		UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+		Component->SetStaticMesh(BlockClass->GetDefaultObject<ABlockActor>()->GetInstancedMesh());
+		Component->SetupAttachment(GetRootComponent());
+		Component->RegisterComponent();
+
+		TypeComponents[BlockType] = Component;
+	}
+
+	return TypeComponents[BlockType];
+}
+
+void ABlockInstanceActor::OnBlockCellChanged(const FIntPoint& Cell)
+{
+	const int32 ChunkSize = UBlockActorScene::GetChunkSize();
+	const FIntPoint ChunkLocation = Cell / ChunkSize;
+
+	MarkChunkDirty(ChunkLocation);
+
+	// Cells on the edge of a chunk also hide or uncover faces of the next one
+	const FIntPoint ChunkCell(Cell.X % ChunkSize, Cell.Y % ChunkSize);
+
+	if (ChunkCell.X == 0)
+	{
+		MarkChunkDirty(ChunkLocation - FIntPoint(1, 0));
+	}
+	else if (ChunkCell.X == ChunkSize - 1)
+	{
+		MarkChunkDirty(ChunkLocation + FIntPoint(1, 0));
+	}
+
+	if (ChunkCell.Y == 0)
+	{
+		MarkChunkDirty(ChunkLocation - FIntPoint(0, 1));
+	}
+	else if (ChunkCell.Y == ChunkSize - 1)
+	{
+		MarkChunkDirty(ChunkLocation + FIntPoint(0, 1));
+	}
+}
+
+void ABlockInstanceActor::MarkChunkDirty(const FIntPoint& ChunkLocation)
+{
+	DirtyChunks.Add(ChunkLocation);
+	++ChunkVersions.FindOrAdd(ChunkLocation);
+}
+
+void ABlockInstanceActor::ApplyChunkMesh(const UBlockActorScene& BlockScene, const FBlockChunkMesh& Mesh)
+{
+	UProceduralMeshComponent* Component = ChunkComponents.FindRef(Mesh.Chunk);
+
+	if (Mesh.Sections.Num() == 0)
+	{
+		if (Component)
+		{
+			Component->DestroyComponent();
+			ChunkComponents.Remove(Mesh.Chunk);
+		}
+
+		return;
+	}
+
+	if (!Component)
+	{
+		Component = NewObject<UProceduralMeshComponent>(this);
+		// Collision of rebuilt chunks is cooked off the game thread too
+		Component->bUseAsyncCooking = true;
+		Component->SetupAttachment(GetRootComponent());
+		Component->RegisterComponent();
+		Component->SetWorldLocation(BlockScene.OriginSpaceGridToWorldSpace(Mesh.Chunk * UBlockActorScene::GetChunkSize()));
+
+		ChunkComponents.Add(Mesh.Chunk, Component);
+	}
+
+	Component->ClearAllMeshSections();
+
+	for (int32 i = 0; i < Mesh.Sections.Num(); ++i)
+	{
+		const FBlockChunkMeshSection& Section = Mesh.Sections[i];
+
+		Component->CreateMeshSection(i, Section.Vertices, Section.Triangles, Section.Normals, Section.UVs,
+			TArray<FColor>(), TArray<FProcMeshTangent>(), true);
+
+		// Chunks look like the instanced mesh of the block
+		UClass* BlockClass = BlockScene.GetBlockTypeClass(Section.BlockType);
+		UStaticMesh* InstancedMesh = BlockClass ? BlockClass->GetDefaultObject<ABlockActor>()->GetInstancedMesh() : nullptr;
+
+		Component->SetMaterial(i, InstancedMesh ? InstancedMesh->GetMaterial(0) : nullptr);
+	}
+}
+
 UBlockActorScene* UStarfoundHelper::GetBlockActorScene(const UObject* WorldContextObject)
 {
 	if (!WorldContextObject)
@@ -237,6 +787,8 @@ UBlockActorScene* UStarfoundHelper::GetBlockActorScene(const UObject* WorldConte
 UStorageComponent::UStorageComponent()
 {
 	PrimaryComponentTick.bCanEverTick = true;
+
+	FlowFieldId = 0;
 }
 
 void UStorageComponent::OnComponentDestroyed(bool bDestroyingHierarchy)
@@ -244,6 +796,7 @@ void UStorageComponent::OnComponentDestroyed(bool bDestroyingHierarchy)
 	Super::OnComponentDestroyed(bDestroyingHierarchy);
 
 	CancelIssuedJobs();
+	ReleaseFlowField();
 }
 
 void UStorageComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction)
@@ -253,6 +806,7 @@ void UStorageComponent::TickComponent(float DeltaTime, enum ELevelTick TickType,
 	if (Items.Num() >= ItemCapacity)
 	{
 		CancelIssuedJobs();
+		ReleaseFlowField();
 	}
 	else
 	{
@@ -260,6 +814,8 @@ void UStorageComponent::TickComponent(float DeltaTime, enum ELevelTick TickType,
 
 		if (Block && !Block->IsTemporal())
 		{
+			UpdateFlowField();
+
 			if (IssuedJobIds.Num() == 0)
 			{
 				IssueJobs();
@@ -308,3 +864,47 @@ void UStorageComponent::CancelIssuedJobs()
 		GameMode->GetJobQueue()->RemoveJob(Id);
 	}
 }
+
+void UStorageComponent::UpdateFlowField()
+{
+	AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!GameMode || !BlockScene)
+	{
+		return;
+	}
+
+	ANavigation* Navigation = GameMode->GetNavigation();
+
+	TArray<FIntPoint> Goals;
+	Navigation->GetCellsNextToGridLocation(BlockScene->WorldSpaceToOriginSpaceGrid(GetOwner()->GetActorLocation()), Goals);
+
+	// Blocks changing elsewhere only refresh the field, but new goals need a field of their own
+	const FFlowField* FlowField = Navigation->GetFlowField(FlowFieldId);
+
+	if (FlowField && FlowField->GetGoals() == Goals)
+	{
+		return;
+	}
+
+	ReleaseFlowField();
+	FlowFieldId = Navigation->AcquireFlowField(Goals);
+}
+
+void UStorageComponent::ReleaseFlowField()
+{
+	if (FlowFieldId == 0)
+	{
+		return;
+	}
+
+	AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+
+	if (GameMode)
+	{
+		GameMode->GetNavigation()->ReleaseFlowField(FlowFieldId);
+	}
+
+	FlowFieldId = 0;
+}
@@ -5,7 +5,10 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Engine/AssetUserData.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "ProceduralMeshComponent.h"
 #include "ItemActor.h"
+#include "BlockChunkMesher.h"
 #include "BlockActor.generated.h"
 
 UCLASS(meta=(BlueprintSpawnableComponent))
@@ -28,10 +31,18 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void AddItem(EItemType ItemType);
 
+	// Flow field to the cells next to the storage, held while it issues jobs so every pawn gathering to it shares
+	// one field. 0 if none.
+	uint32 GetFlowFieldId() const { return FlowFieldId; }
+
 private:
 	void IssueJobs();
 	void CancelIssuedJobs();
 
+	// Acquires the field again when the cells next to the storage changed
+	void UpdateFlowField();
+	void ReleaseFlowField();
+
 	UPROPERTY(EditDefaultsOnly)
 	int32 ItemCapacity;
 
@@ -40,6 +51,8 @@ private:
 
 	UPROPERTY()
 	TArray<int32> IssuedJobIds;
+
+	uint32 FlowFieldId;
 };
 
 UCLASS()
@@ -52,7 +65,6 @@ public:
 
 public:
 	virtual void BeginPlay() override;
-	virtual void Tick(float DeltaTime) override;
 
 	virtual void PostRegisterAllComponents() override;
 	virtual void PostUnregisterAllComponents() override;
@@ -67,10 +79,21 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool IsTemporal() const { return bTemporal; }
 
+	UStaticMesh* GetInstancedMesh() const { return InstancedMesh; }
+
 private:
+	friend class UBlockActorScene;
+
+	// Mesh drawn for the block while it has no actor. Leave empty on blocks with behaviour, they always get an actor.
+	UPROPERTY(EditDefaultsOnly, Category = "Block")
+	UStaticMesh* InstancedMesh;
+
 	void TransformUpdated(USceneComponent* RootComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
 
 	bool bTemporal;
+
+	// Cell (origin space) of the block scene the block is registered in, INDEX_NONE if none. Kept by UBlockActorScene.
+	FIntPoint BlockSceneCell;
 };
 
 
@@ -81,10 +104,49 @@ class UBlockGenerator : public UObject
 
 public:
 
-	void GenerateRandomBlockWorld(UWorld* World, const TArray<TSubclassOf<ABlockActor>>& BlockClasses);
+	// Blocks that can be instanced go to BlockInstances if there is one, the others are spawned as actors
+	void GenerateRandomBlockWorld(UWorld* World, const TArray<TSubclassOf<ABlockActor>>& BlockClasses, class ABlockInstanceActor* BlockInstances);
+
+	// Cells (world space grid) of a random world reaching SizeY and SizeZ cells out from the origin
+	static void GenerateRandomBlockLocations(int32 SizeY, int32 SizeZ, TArray<FIntPoint>& OutLocations);
 };
 
 
+// What is in a cell of UBlockActorScene, without looking at the actor
+enum class EBlockCellFlags : uint8
+{
+	None = 0,
+	Solid = 1 << 0,
+	// Has a UStorageComponent
+	Storage = 1 << 1,
+	Temporal = 1 << 2,
+	// Drawn by ABlockInstanceActor, no actor
+	Instanced = 1 << 3,
+};
+
+ENUM_CLASS_FLAGS(EBlockCellFlags);
+
+// Square of ChunkSize x ChunkSize cells of UBlockActorScene
+USTRUCT()
+struct FBlockChunk
+{
+	GENERATED_BODY()
+
+	FBlockChunk() : NumBlocks(0) {}
+
+	// index = (Y * ChunkSize) + X, chunk space
+	UPROPERTY()
+	TArray<ABlockActor*> Blocks;
+
+	// Cell data by the same index, kept next to Blocks. Type 0 and no flags where there is no block.
+	TArray<uint16> BlockTypes;
+	TArray<EBlockCellFlags> BlockFlags;
+
+	int32 NumBlocks;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBlockCellChanged, const FIntPoint& /*OriginSpaceGridLocation*/);
+
 UCLASS()
 class UBlockActorScene : public UAssetUserData
 {
@@ -94,9 +156,19 @@ public:
 
 	void InitializeGrid(float InGridCellSize, int32 InGridX, int32 InGridY);
 
+	// Broadcast whenever a cell gets or loses its block
+	FOnBlockCellChanged& OnBlockCellChanged() { return BlockCellChangedEvent; }
+
 	void RegisterBlockActor(ABlockActor* BlockActor);
 	void UnRegisterBlockActor(ABlockActor* BlockActor);
 
+	// Block without an actor, drawn by the block instance actor. GetBlock is null for it. An actor registered
+	// in its cell takes it over. Returns false if the cell is taken or outside the grid.
+	bool RegisterInstancedBlock(const FIntPoint& Cell, UClass* BlockClass);
+
+	void SetBlockInstanceActor(class ABlockInstanceActor* InBlockInstances) { BlockInstances = InBlockInstances; }
+	class ABlockInstanceActor* GetBlockInstanceActor() const { return BlockInstances; }
+
 	float GetGridCellSize() const { return GridCellSize; }
 	int32 GetGridX() const { return GridX; }
 	int32 GetGridY() const { return GridY; }
@@ -137,6 +209,27 @@ public:
 
 	ABlockActor* GetBlock(int32 X, int32 Y) const;
 
+	// Same as GetBlock() != nullptr, without looking up the chunk
+	bool HasBlock(int32 X, int32 Y) const;
+
+	// Block type of a cell, 0 if empty. Types are numbered as block classes are first registered.
+	uint16 GetBlockType(int32 X, int32 Y) const;
+	UClass* GetBlockTypeClass(uint16 BlockType) const;
+
+	EBlockCellFlags GetBlockFlags(int32 X, int32 Y) const;
+
+	// Cells with a block in row Y. Cell X is bit X % 64 of word X / 64. Null outside the grid.
+	const uint64* GetOccupiedRow(int32 Y) const;
+	int32 GetNumRowWords() const { return (GetNumGridX() + 63) / 64; }
+
+	static int32 GetChunkSize() { return ChunkSize; }
+
+	// Chunks with a block, by origin space cell / GetChunkSize()
+	void GetChunkLocations(TArray<FIntPoint>& OutChunkLocations) const;
+
+	// Cells of a chunk and the ring around it, for FBlockChunkMesher. Blocks with any of MeshedFlags are meshed.
+	void GetChunkMeshInput(const FIntPoint& ChunkLocation, EBlockCellFlags MeshedFlags, FBlockChunkMeshInput& OutInput) const;
+
 	UFUNCTION(BlueprintCallable)
 	ABlockActor* GetBlock(const FIntPoint& Location) const;
 
@@ -146,18 +239,122 @@ public:
 
 private:
 
+	static const int32 ChunkShift = 5;
+	static const int32 ChunkSize = 1 << ChunkShift;
+	static const int32 ChunkMask = ChunkSize - 1;
+
+	// BlockClass is the class of an instanced block. Unused with an actor, which brings its own.
+	void SetBlockAtCell(const FIntPoint& Cell, ABlockActor* BlockActor, UClass* BlockClass = nullptr);
+
+	// False if the block isn't in this scene
+	bool FindBlockActorCell(const ABlockActor* BlockActor, FIntPoint& OutCell) const;
+
+	// Chunk holding the cell and the index of the cell in it. Null if the chunk isn't allocated.
+	const FBlockChunk* FindChunk(int32 X, int32 Y, int32& OutIndex) const;
+
+	uint16 FindOrAddBlockType(UClass* BlockClass);
+
 	float GridCellSize;
 
 	// Grid count. Inclusive
 	int32 GridX;
 	int32 GridY;
 
+	// Chunks with a block, by origin space cell / ChunkSize. Allocated by the first block in them, dropped with the last one.
 	UPROPERTY()
-	TArray<ABlockActor*> BlockActors;
+	TMap<FIntPoint, FBlockChunk> Chunks;
+
+	// Class of each block type, type 1 first
+	UPROPERTY()
+	TArray<UClass*> BlockTypeClasses;
+
+	TMap<UClass*, uint16> BlockTypes;
+
+	// Cells with a block, as bit rows for GetOccupiedRow. index = (Y * GetNumRowWords()) + (X / 64)
+	TArray<uint64> OccupiedBits;
+
+	UPROPERTY()
+	class ABlockInstanceActor* BlockInstances;
+
+	FOnBlockCellChanged BlockCellChangedEvent;
 };
 
 UBlockActorScene* GetBlockActorScene(UWorld* World);
 
+// Draws the blocks of the scene that have no actor, one hierarchical instanced mesh per block class.
+// Ordinary scenery blocks have no behaviour, so grid data and an instance is all they need.
+// With chunk meshing on, draws them as one greedy mesh per scene chunk instead. A changed chunk is rebuilt on a
+// worker thread and swapped in on a later tick.
+UCLASS()
+class ABlockInstanceActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ABlockInstanceActor();
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+	// Set before adding blocks
+	void SetMeshChunks(bool bInMeshChunks);
+	bool IsMeshingChunks() const { return bMeshChunks; }
+
+	// Classes with an instanced mesh
+	static bool CanInstance(TSubclassOf<ABlockActor> BlockClass);
+
+	// Adds a block at the cell of Location, without an actor. False if the cell is taken.
+	bool AddBlock(const FVector& Location, TSubclassOf<ABlockActor> BlockClass);
+
+	// Replaces an instanced block with an actor of its class, for blocks something is about to be done with.
+	// Null if there is no instanced block at the cell (origin space).
+	ABlockActor* PromoteBlock(const FIntPoint& Cell);
+
+	// Cell (origin space) of the instanced block a trace hit
+	bool GetHitCell(const FHitResult& HitResult, FIntPoint& OutCell) const;
+
+private:
+	friend class UBlockActorScene;
+
+	// Drops the instance of the cell. The scene keeps the cell data.
+	void RemoveInstance(const FIntPoint& Cell);
+
+	UHierarchicalInstancedStaticMeshComponent* FindOrAddComponent(uint16 BlockType, UClass* BlockClass);
+
+	void OnBlockCellChanged(const FIntPoint& Cell);
+
+	// Queues a rebuild of the chunk. Meshes of older versions are dropped when they come back.
+	void MarkChunkDirty(const FIntPoint& ChunkLocation);
+
+	void ApplyChunkMesh(const UBlockActorScene& BlockScene, const FBlockChunkMesh& Mesh);
+
+	// By block type of the scene. Null for types that aren't instanced.
+	UPROPERTY(Transient)
+	TArray<UHierarchicalInstancedStaticMeshComponent*> TypeComponents;
+
+	// Cell of each instance, by block type
+	TArray<TArray<FIntPoint>> TypeInstanceCells;
+
+	struct FCellInstance
+	{
+		uint16 BlockType;
+		int32 Instance;
+	};
+
+	TMap<FIntPoint, FCellInstance> CellInstances;
+
+	bool bMeshChunks;
+
+	TUniquePtr<FBlockChunkMeshBuilder> MeshBuilder;
+
+	// By chunk of the scene
+	TSet<FIntPoint> DirtyChunks;
+	TMap<FIntPoint, uint32> ChunkVersions;
+
+	UPROPERTY(Transient)
+	TMap<FIntPoint, UProceduralMeshComponent*> ChunkComponents;
+};
+
 UCLASS()
 class UStarfoundHelper : public UObject
 {
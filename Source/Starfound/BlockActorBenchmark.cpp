@@ -0,0 +1,130 @@
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/World.h"
+#include "BlockActor.h"
+#include "StarfoundGameMode.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStarfoundBlockBenchmark, Log, All);
+
+/**
+ * Block scene benchmark. Spawns a generated world filling a whole scene grid and times registering, moving and
+ * unregistering every block. The blocks are temporal and go in a scene of their own, so the running game is untouched.
+ * Also greedy meshes every chunk of the scene and logs its quads and triangles next to drawing every block on its own.
+ *
+ * Starfound.Blocks.Benchmark [GridSize]
+ */
+namespace StarfoundBlockBenchmark
+{
+	static void RunBenchmark(const TArray<FString>& Args, UWorld* World)
+	{
+		// Default extents of FStarfoundConfiguration
+		const int32 GridSize = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 100;
+
+		AStarfoundGameMode* GameMode = GetStarfoundGameMode(World);
+
+		if (!GameMode || GameMode->GetConfiguration().ScenaryBlocks.Num() == 0)
+		{
+			UE_LOG(LogStarfoundBlockBenchmark, Warning, TEXT("Block benchmark needs a running game with scenary blocks"));
+			return;
+		}
+
+		const TArray<TSubclassOf<ABlockActor>>& BlockClasses = GameMode->GetConfiguration().ScenaryBlocks;
+
+		UBlockActorScene* Scene = NewObject<UBlockActorScene>();
+		Scene->InitializeGrid(100.0f, GridSize, GridSize);
+
+		TArray<FIntPoint> Locations;
+		UBlockGenerator::GenerateRandomBlockLocations(GridSize, GridSize, Locations);
+
+		TArray<ABlockActor*> Blocks;
+		Blocks.Reserve(Locations.Num());
+
+		double StartTime = FPlatformTime::Seconds();
+
+		for (const FIntPoint& Location : Locations)
+		{
+			const FTransform Transform(FVector(0, Location.X * Scene->GetGridCellSize(), Location.Y * Scene->GetGridCellSize()));
+
+			ABlockActor* Block = World->SpawnActorDeferred<ABlockActor>(BlockClasses[FMath::Rand() % BlockClasses.Num()], Transform,
+				nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+
+			if (Block)
+			{
+				// Keeps it out of the scene of the game
+				Block->SetTemporal(true);
+				Block->FinishSpawning(Transform);
+
+				Blocks.Add(Block);
+			}
+		}
+
+		const double SpawnSeconds = FPlatformTime::Seconds() - StartTime;
+		StartTime = FPlatformTime::Seconds();
+
+		for (ABlockActor* Block : Blocks)
+		{
+			Scene->RegisterBlockActor(Block);
+		}
+
+		const double RegisterSeconds = FPlatformTime::Seconds() - StartTime;
+		StartTime = FPlatformTime::Seconds();
+
+		// What every TransformUpdated of a block does
+		for (ABlockActor* Block : Blocks)
+		{
+			Scene->RegisterBlockActor(Block);
+		}
+
+		const double UpdateSeconds = FPlatformTime::Seconds() - StartTime;
+
+		TArray<FIntPoint> ChunkLocations;
+		Scene->GetChunkLocations(ChunkLocations);
+
+		int32 NumQuads = 0;
+		int32 NumTriangles = 0;
+
+		StartTime = FPlatformTime::Seconds();
+
+		for (const FIntPoint& ChunkLocation : ChunkLocations)
+		{
+			FBlockChunkMeshInput Input;
+			Scene->GetChunkMeshInput(ChunkLocation, EBlockCellFlags::Solid, Input);
+
+			FBlockChunkMesh Mesh;
+			FBlockChunkMesher::BuildMesh(Input, Scene->GetGridCellSize(), Mesh);
+
+			NumQuads += Mesh.GetNumQuads();
+			NumTriangles += Mesh.GetNumTriangles();
+		}
+
+		const double MeshSeconds = FPlatformTime::Seconds() - StartTime;
+		StartTime = FPlatformTime::Seconds();
+
+		for (ABlockActor* Block : Blocks)
+		{
+			Scene->UnRegisterBlockActor(Block);
+		}
+
+		const double UnregisterSeconds = FPlatformTime::Seconds() - StartTime;
+
+		for (ABlockActor* Block : Blocks)
+		{
+			Block->Destroy();
+		}
+
+		UE_LOG(LogStarfoundBlockBenchmark, Display,
+			TEXT("Block benchmark. %dx%d grid, %d blocks. Spawn %.2f ms, register %.2f ms, update %.2f ms, unregister %.2f ms"),
+			Scene->GetNumGridX(), Scene->GetNumGridY(), Blocks.Num(),
+			SpawnSeconds * 1000.0, RegisterSeconds * 1000.0, UpdateSeconds * 1000.0, UnregisterSeconds * 1000.0);
+
+		// A block on its own shows every face but the back one
+		UE_LOG(LogStarfoundBlockBenchmark, Display,
+			TEXT("Block meshing. %d chunks, %d quads, %d triangles, %.2f ms. Block by block would be %d quads"),
+			ChunkLocations.Num(), NumQuads, NumTriangles, MeshSeconds * 1000.0, Blocks.Num() * 5);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BlockBenchmarkCommand(
+	TEXT("Starfound.Blocks.Benchmark"),
+	TEXT("Spawns a generated world over a whole block scene, times its registry and meshes its chunks. Args: [GridSize=100]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StarfoundBlockBenchmark::RunBenchmark));
@@ -0,0 +1,271 @@
+#include "BlockChunkMesher.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeCounter.h"
+
+int32 FBlockChunkMesh::GetNumQuads() const
+{
+	int32 NumQuads = 0;
+
+	for (const FBlockChunkMeshSection& Section : Sections)
+	{
+		NumQuads += Section.GetNumQuads();
+	}
+
+	return NumQuads;
+}
+
+int32 FBlockChunkMesh::GetNumTriangles() const
+{
+	int32 NumTriangles = 0;
+
+	for (const FBlockChunkMeshSection& Section : Sections)
+	{
+		NumTriangles += Section.GetNumTriangles();
+	}
+
+	return NumTriangles;
+}
+
+void FBlockChunkMesher::BuildMesh(const FBlockChunkMeshInput& Input, float CellSize, FBlockChunkMesh& OutMesh)
+{
+	OutMesh.Chunk = Input.Chunk;
+	OutMesh.Version = Input.Version;
+	OutMesh.Sections.Reset();
+
+	const int32 Size = Input.ChunkSize;
+
+	// Front faces. Grow each quad along X, then along Y while the whole row matches.
+	TArray<bool> Merged;
+	Merged.SetNumZeroed(Size * Size);
+
+	for (int32 Y = 0; Y < Size; ++Y)
+	{
+		for (int32 X = 0; X < Size; ++X)
+		{
+			const uint16 BlockType = Input.MeshedTypes[Input.GetIndex(X, Y)];
+
+			if (BlockType == 0 || Merged[(Y * Size) + X])
+			{
+				continue;
+			}
+
+			int32 X1 = X + 1;
+
+			while (X1 < Size && Input.MeshedTypes[Input.GetIndex(X1, Y)] == BlockType && !Merged[(Y * Size) + X1])
+			{
+				++X1;
+			}
+
+			int32 Y1 = Y + 1;
+
+			for (; Y1 < Size; ++Y1)
+			{
+				bool bRowMatches = true;
+
+				for (int32 RowX = X; RowX < X1 && bRowMatches; ++RowX)
+				{
+					bRowMatches = Input.MeshedTypes[Input.GetIndex(RowX, Y1)] == BlockType && !Merged[(Y1 * Size) + RowX];
+				}
+
+				if (!bRowMatches)
+				{
+					break;
+				}
+			}
+
+			for (int32 MergedY = Y; MergedY < Y1; ++MergedY)
+			{
+				for (int32 MergedX = X; MergedX < X1; ++MergedX)
+				{
+					Merged[(MergedY * Size) + MergedX] = true;
+				}
+			}
+
+			AddQuad(FindOrAddSection(OutMesh, BlockType), CellSize, FVector(1, 0, 0), X, Y, X1, Y1);
+		}
+	}
+
+	// Top and bottom faces, in strips along X
+	for (int32 Side = -1; Side <= 1; Side += 2)
+	{
+		for (int32 Y = 0; Y < Size; ++Y)
+		{
+			int32 X = 0;
+
+			while (X < Size)
+			{
+				const uint16 BlockType = Input.MeshedTypes[Input.GetIndex(X, Y)];
+
+				if (BlockType == 0 || Input.Solid[Input.GetIndex(X, Y + Side)])
+				{
+					++X;
+					continue;
+				}
+
+				int32 X1 = X + 1;
+
+				while (X1 < Size && Input.MeshedTypes[Input.GetIndex(X1, Y)] == BlockType && !Input.Solid[Input.GetIndex(X1, Y + Side)])
+				{
+					++X1;
+				}
+
+				AddQuad(FindOrAddSection(OutMesh, BlockType), CellSize, FVector(0, 0, Side), X, Y, X1, Y + 1);
+				X = X1;
+			}
+		}
+	}
+
+	// Left and right faces, in strips along Y
+	for (int32 Side = -1; Side <= 1; Side += 2)
+	{
+		for (int32 X = 0; X < Size; ++X)
+		{
+			int32 Y = 0;
+
+			while (Y < Size)
+			{
+				const uint16 BlockType = Input.MeshedTypes[Input.GetIndex(X, Y)];
+
+				if (BlockType == 0 || Input.Solid[Input.GetIndex(X + Side, Y)])
+				{
+					++Y;
+					continue;
+				}
+
+				int32 Y1 = Y + 1;
+
+				while (Y1 < Size && Input.MeshedTypes[Input.GetIndex(X, Y1)] == BlockType && !Input.Solid[Input.GetIndex(X + Side, Y1)])
+				{
+					++Y1;
+				}
+
+				AddQuad(FindOrAddSection(OutMesh, BlockType), CellSize, FVector(0, Side, 0), X, Y, X + 1, Y1);
+				Y = Y1;
+			}
+		}
+	}
+
+	OutMesh.Sections.Sort([](const FBlockChunkMeshSection& A, const FBlockChunkMeshSection& B) { return A.BlockType < B.BlockType; });
+}
+
+FBlockChunkMeshSection& FBlockChunkMesher::FindOrAddSection(FBlockChunkMesh& Mesh, uint16 BlockType)
+{
+	for (FBlockChunkMeshSection& Section : Mesh.Sections)
+	{
+		if (Section.BlockType == BlockType)
+		{
+			return Section;
+		}
+	}
+
+	const int32 Index = Mesh.Sections.AddDefaulted();
+	Mesh.Sections[Index].BlockType = BlockType;
+
+	return Mesh.Sections[Index];
+}
+
+void FBlockChunkMesher::AddQuad(FBlockChunkMeshSection& Section, float CellSize, const FVector& Normal, int32 X0, int32 Y0, int32 X1, int32 Y1)
+{
+	const float HalfCell = CellSize * 0.5f;
+
+	// Cell edges in world Y and Z
+	const float MinY = (X0 * CellSize) - HalfCell;
+	const float MaxY = (X1 * CellSize) - HalfCell;
+	const float MinZ = (Y0 * CellSize) - HalfCell;
+	const float MaxZ = (Y1 * CellSize) - HalfCell;
+
+	FVector Corners[4];
+	FVector2D CornerUVs[4];
+
+	if (Normal.X != 0)
+	{
+		Corners[0] = FVector(HalfCell, MinY, MinZ);
+		Corners[1] = FVector(HalfCell, MaxY, MinZ);
+		Corners[2] = FVector(HalfCell, MaxY, MaxZ);
+		Corners[3] = FVector(HalfCell, MinY, MaxZ);
+	}
+	else if (Normal.Z != 0)
+	{
+		const float Z = (Normal.Z > 0) ? MaxZ : MinZ;
+
+		Corners[0] = FVector(-HalfCell, MinY, Z);
+		Corners[1] = FVector(-HalfCell, MaxY, Z);
+		Corners[2] = FVector(HalfCell, MaxY, Z);
+		Corners[3] = FVector(HalfCell, MinY, Z);
+	}
+	else
+	{
+		const float Y = (Normal.Y > 0) ? MaxY : MinY;
+
+		Corners[0] = FVector(-HalfCell, Y, MinZ);
+		Corners[1] = FVector(-HalfCell, Y, MaxZ);
+		Corners[2] = FVector(HalfCell, Y, MaxZ);
+		Corners[3] = FVector(HalfCell, Y, MinZ);
+	}
+
+	// Edges 0-1 and 0-3 are the sides of the quad
+	const float Width = (Corners[1] - Corners[0]).Size() / CellSize;
+	const float Height = (Corners[3] - Corners[0]).Size() / CellSize;
+
+	CornerUVs[0] = FVector2D(0, Height);
+	CornerUVs[1] = FVector2D(Width, Height);
+	CornerUVs[2] = FVector2D(Width, 0);
+	CornerUVs[3] = FVector2D(0, 0);
+
+	const int32 FirstVertex = Section.Vertices.Num();
+
+	for (int32 i = 0; i < 4; ++i)
+	{
+		Section.Vertices.Add(Corners[i]);
+		Section.Normals.Add(Normal);
+		Section.UVs.Add(CornerUVs[i]);
+	}
+
+	// Front faces wind clockwise seen from the normal side
+	const bool bFlip = (FVector::CrossProduct(Corners[1] - Corners[0], Corners[2] - Corners[0]) | Normal) > 0;
+
+	const int32 Order[6] = { 0, 1, 2, 0, 2, 3 };
+
+	for (int32 i = 0; i < 6; ++i)
+	{
+		Section.Triangles.Add(FirstVertex + (bFlip ? Order[5 - i] : Order[i]));
+	}
+}
+
+struct FBlockChunkMeshBuilder::FSharedState
+{
+	TQueue<FBlockChunkMesh, EQueueMode::Mpsc> Meshes;
+	FThreadSafeCounter NumInFlight;
+};
+
+FBlockChunkMeshBuilder::FBlockChunkMeshBuilder()
+	: SharedState(new FSharedState)
+{
+}
+
+void FBlockChunkMeshBuilder::Dispatch(FBlockChunkMeshInput&& Input, float CellSize)
+{
+	SharedState->NumInFlight.Increment();
+
+	TSharedPtr<FSharedState, ESPMode::ThreadSafe> State = SharedState;
+
+	FFunctionGraphTask::CreateAndDispatchWhenReady([State, Input = MoveTemp(Input), CellSize]()
+	{
+		FBlockChunkMesh Mesh;
+		FBlockChunkMesher::BuildMesh(Input, CellSize, Mesh);
+
+		State->Meshes.Enqueue(MoveTemp(Mesh));
+		State->NumInFlight.Decrement();
+	}, TStatId(), nullptr, ENamedThreads::AnyThread);
+}
+
+bool FBlockChunkMeshBuilder::PopMesh(FBlockChunkMesh& OutMesh)
+{
+	return SharedState->Meshes.Dequeue(OutMesh);
+}
+
+int32 FBlockChunkMeshBuilder::GetNumInFlight() const
+{
+	return SharedState->NumInFlight.GetValue();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Cells of a scene chunk and the ring of cells around it, what FBlockChunkMesher reads
+struct FBlockChunkMeshInput
+{
+	// Chunk coordinate, scene cell / ChunkSize
+	FIntPoint Chunk;
+	int32 ChunkSize;
+
+	// Bumped by every change of the chunk, to tell stale meshes apart
+	uint32 Version;
+
+	// (ChunkSize + 2) x (ChunkSize + 2) cells, the ring included. index = ((Y + 1) * (ChunkSize + 2)) + (X + 1)
+	// Block type of the cells to mesh, 0 for the others
+	TArray<uint16> MeshedTypes;
+
+	// Cells with any block, meshed or not. Faces against them can't be seen.
+	TArray<bool> Solid;
+
+	int32 GetIndex(int32 X, int32 Y) const { return ((Y + 1) * (ChunkSize + 2)) + (X + 1); }
+};
+
+// Faces of one block type
+struct FBlockChunkMeshSection
+{
+	uint16 BlockType;
+
+	TArray<FVector> Vertices;
+	TArray<int32> Triangles;
+	TArray<FVector> Normals;
+	// In cells, so textures repeat once per cell over merged quads
+	TArray<FVector2D> UVs;
+
+	int32 GetNumQuads() const { return Vertices.Num() / 4; }
+	int32 GetNumTriangles() const { return Triangles.Num() / 3; }
+};
+
+struct FBlockChunkMesh
+{
+	FIntPoint Chunk;
+	uint32 Version;
+
+	// One per block type in the chunk, sorted by type
+	TArray<FBlockChunkMeshSection> Sections;
+
+	int32 GetNumQuads() const;
+	int32 GetNumTriangles() const;
+};
+
+// Turns the cells of a chunk into as few quads as it can. Blocks are cubes one cell wide, drawn facing +X, the
+// camera side. Front faces of the same type merge into rectangles, greedily, row by row. Side faces are only made
+// where no block hides them, and merge into strips along their edge. Back faces are never seen and never made.
+// Vertices are relative to the center of cell (0, 0) of the chunk: world Y is cell X and world Z is cell Y.
+// Needs nothing but the input, so it runs on any thread.
+class FBlockChunkMesher
+{
+public:
+	static void BuildMesh(const FBlockChunkMeshInput& Input, float CellSize, FBlockChunkMesh& OutMesh);
+
+private:
+	static FBlockChunkMeshSection& FindOrAddSection(FBlockChunkMesh& Mesh, uint16 BlockType);
+
+	// Quad over cells [X0, X1) x [Y0, Y1), on the given face of them
+	static void AddQuad(FBlockChunkMeshSection& Section, float CellSize, const FVector& Normal, int32 X0, int32 Y0, int32 X1, int32 Y1);
+};
+
+// Runs FBlockChunkMesher on task graph worker threads. Meshes are queued for the game thread.
+class FBlockChunkMeshBuilder
+{
+public:
+	FBlockChunkMeshBuilder();
+
+	void Dispatch(FBlockChunkMeshInput&& Input, float CellSize);
+
+	bool PopMesh(FBlockChunkMesh& OutMesh);
+
+	int32 GetNumInFlight() const;
+
+private:
+	// Kept alive by running tasks, so the builder can be destroyed while meshes are still being built
+	struct FSharedState;
+
+	TSharedPtr<FSharedState, ESPMode::ThreadSafe> SharedState;
+};
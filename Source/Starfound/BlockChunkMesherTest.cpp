@@ -0,0 +1,109 @@
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "BlockChunkMesher.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+ * Meshes hand made chunks and checks the quads and triangles FBlockChunkMesher makes of them.
+ */
+namespace StarfoundBlockChunkMesherTest
+{
+	const static int32 ChunkSize = 32;
+	const static float CellSize = 100;
+
+	static void InitInput(FBlockChunkMeshInput& Input)
+	{
+		const int32 NumCells = (ChunkSize + 2) * (ChunkSize + 2);
+
+		Input.Chunk = FIntPoint::ZeroValue;
+		Input.ChunkSize = ChunkSize;
+		Input.Version = 0;
+		Input.MeshedTypes.Init(0, NumCells);
+		Input.Solid.Init(false, NumCells);
+	}
+
+	// X and Y of the ring are -1 and ChunkSize
+	static void SetBlock(FBlockChunkMeshInput& Input, int32 X, int32 Y, uint16 BlockType)
+	{
+		const int32 Index = Input.GetIndex(X, Y);
+
+		if (X >= 0 && X < ChunkSize && Y >= 0 && Y < ChunkSize)
+		{
+			Input.MeshedTypes[Index] = BlockType;
+		}
+
+		Input.Solid[Index] = true;
+	}
+
+	static bool TestMesh(FAutomationTestBase& Test, const TCHAR* What, const FBlockChunkMeshInput& Input, int32 ExpectedNumQuads)
+	{
+		FBlockChunkMesh Mesh;
+		FBlockChunkMesher::BuildMesh(Input, CellSize, Mesh);
+
+		Test.TestEqual(FString::Printf(TEXT("%s quads"), What), Mesh.GetNumQuads(), ExpectedNumQuads);
+		Test.TestEqual(FString::Printf(TEXT("%s triangles"), What), Mesh.GetNumTriangles(), ExpectedNumQuads * 2);
+
+		return Mesh.GetNumQuads() == ExpectedNumQuads && Mesh.GetNumTriangles() == ExpectedNumQuads * 2;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBlockChunkMesherTest, "Starfound.Blocks.ChunkMesher", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FBlockChunkMesherTest::RunTest(const FString& Parameters)
+{
+	using namespace StarfoundBlockChunkMesherTest;
+
+	bool bPassed = true;
+	FBlockChunkMeshInput Input;
+
+	InitInput(Input);
+	bPassed &= TestMesh(*this, TEXT("Empty chunk"), Input, 0);
+
+	// Front, top, bottom, left and right
+	InitInput(Input);
+	SetBlock(Input, 5, 7, 1);
+	bPassed &= TestMesh(*this, TEXT("Single block"), Input, 5);
+
+	// Every face merges into one quad per side
+	InitInput(Input);
+
+	for (int32 Y = 0; Y < ChunkSize; ++Y)
+	{
+		for (int32 X = 0; X < ChunkSize; ++X)
+		{
+			SetBlock(Input, X, Y, 1);
+		}
+	}
+
+	bPassed &= TestMesh(*this, TEXT("Full chunk"), Input, 5);
+
+	// Ring cells hide every side face, only the front is left
+	for (int32 i = -1; i <= ChunkSize; ++i)
+	{
+		SetBlock(Input, i, -1, 2);
+		SetBlock(Input, i, ChunkSize, 2);
+		SetBlock(Input, -1, i, 2);
+		SetBlock(Input, ChunkSize, i, 2);
+	}
+
+	bPassed &= TestMesh(*this, TEXT("Full chunk in solid ring"), Input, 1);
+
+	// Column at X 2, Y 2 to 5, with a foot along X 3 and 4. Front: the foot row and the rest of the column.
+	// Top: the foot and the column. Bottom: the foot row. Left: the column. Right: the column above the foot and the foot end.
+	InitInput(Input);
+
+	for (int32 Y = 2; Y <= 5; ++Y)
+	{
+		SetBlock(Input, 2, Y, 1);
+	}
+
+	SetBlock(Input, 3, 2, 1);
+	SetBlock(Input, 4, 2, 1);
+
+	bPassed &= TestMesh(*this, TEXT("L shape"), Input, 8);
+
+	return bPassed;
+}
+
+#endif
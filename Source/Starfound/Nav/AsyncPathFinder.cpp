@@ -0,0 +1,245 @@
+#include "AsyncPathFinder.h"
+#include "TypedMicroPather.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/ScopeLock.h"
+
+typedef TMicroPather<FSideScrollGraph> FPathSolver;
+
+struct FAsyncPathFinder::FSharedState
+{
+	FCriticalSection PatherLock;
+	TArray<FPathSolver*> FreePathers;
+
+	TQueue<FAsyncPathResult, EQueueMode::Mpsc> Results;
+	FThreadSafeCounter NumInFlight;
+
+	~FSharedState()
+	{
+		for (FPathSolver* Pather : FreePathers)
+		{
+			delete Pather;
+		}
+	}
+
+	FPathSolver* AcquirePather(const FSideScrollGraph* Graph)
+	{
+		FPathSolver* Pather = nullptr;
+
+		{
+			FScopeLock Lock(&PatherLock);
+
+			if (FreePathers.Num() > 0)
+			{
+				Pather = FreePathers.Pop(false);
+			}
+		}
+
+		if (!Pather)
+		{
+			return new FPathSolver(Graph);
+		}
+
+		Pather->SetGraph(Graph);
+
+		return Pather;
+	}
+
+	void ReleasePather(FPathSolver* Pather)
+	{
+		FScopeLock Lock(&PatherLock);
+
+		FreePathers.Add(Pather);
+	}
+};
+
+struct FAsyncPathSearch
+{
+	// Weak, so results holding a search don't keep the pather pool alive
+	TWeakPtr<FAsyncPathFinder::FSharedState, ESPMode::ThreadSafe> State;
+
+	FSideScrollGraphSnapshotPtr Snapshot;
+	FPathSolver* Pather;
+
+	uint32 RequestId;
+	FIntPoint Start;
+
+	FAsyncPathSearch(const TSharedPtr<FAsyncPathFinder::FSharedState, ESPMode::ThreadSafe>& InState,
+		const FSideScrollGraphSnapshotPtr& InSnapshot, uint32 InRequestId, const FIntPoint& InStart)
+		: State(InState)
+		, Snapshot(InSnapshot)
+		, RequestId(InRequestId)
+		, Start(InStart)
+	{
+		Pather = InState->AcquirePather(GetGraph());
+	}
+
+	~FAsyncPathSearch()
+	{
+		TSharedPtr<FAsyncPathFinder::FSharedState, ESPMode::ThreadSafe> PinnedState = State.Pin();
+
+		if (PinnedState.IsValid())
+		{
+			PinnedState->ReleasePather(Pather);
+		}
+		else
+		{
+			delete Pather;
+		}
+	}
+
+	const FSideScrollGraph* GetGraph() const { return Snapshot.Get(); }
+
+	// Returns false if the search isn't done yet
+	bool Step(int32 MaxExpansions, FAsyncPathResult& OutResult)
+	{
+		TArray<int32> Path;
+		float TotalCost;
+		int32 GoalState = INDEX_NONE;
+
+		const int32 Result = Pather->StepSolve(MaxExpansions > 0 ? MaxExpansions : MAX_int32, Path, TotalCost, GoalState);
+
+		if (Result == MicroPanther::FMicroPather::SOLVING)
+		{
+			return false;
+		}
+
+		if (Result == MicroPanther::FMicroPather::SOLVED || Result == MicroPanther::FMicroPather::PARTIAL)
+		{
+			const int32 GridCountX = GetGraph()->GetGridCountX();
+
+			OutResult.bSuccess = Result == MicroPanther::FMicroPather::SOLVED;
+			OutResult.bPartial = Result == MicroPanther::FMicroPather::PARTIAL;
+			OutResult.Goal = FIntPoint(GoalState % GridCountX, GoalState / GridCountX);
+			OutResult.Path.Reserve(Path.Num());
+
+			for (int32 State : Path)
+			{
+				OutResult.Path.Add(FIntPoint(State % GridCountX, State / GridCountX));
+			}
+		}
+
+		return true;
+	}
+
+	// Worker side of a dispatch. Starts the search of Request if there is one, otherwise continues Search.
+	static void RunSlice(const TSharedPtr<FAsyncPathFinder::FSharedState, ESPMode::ThreadSafe>& State,
+		const FSideScrollGraphSnapshotPtr& Snapshot, const FAsyncPathRequest* Request, FAsyncPathSearchPtr Search, int32 MaxExpansions)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+
+		FAsyncPathResult Result;
+		Result.RequestId = Request ? Request->RequestId : Search->RequestId;
+		Result.bSuccess = false;
+		Result.bPartial = false;
+		Result.Goal = Request ? Request->Start : Search->Start;
+
+		if (Request)
+		{
+			Search = Begin(State, Snapshot, *Request, Result);
+		}
+
+		if (Search.IsValid() && !Search->Step(MaxExpansions, Result))
+		{
+			Result.Search = Search;
+		}
+
+		Result.SolveMilliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		State->Results.Enqueue(MoveTemp(Result));
+		State->NumInFlight.Decrement();
+	}
+
+	// Returns null if the request was answered without a search
+	static FAsyncPathSearchPtr Begin(const TSharedPtr<FAsyncPathFinder::FSharedState, ESPMode::ThreadSafe>& State,
+		const FSideScrollGraphSnapshotPtr& Snapshot, const FAsyncPathRequest& Request, FAsyncPathResult& OutResult)
+	{
+		if (Request.Goals.Num() == 0)
+		{
+			return nullptr;
+		}
+
+		FAsyncPathSearchPtr Search = MakeShareable(new FAsyncPathSearch(State, Snapshot, Request.RequestId, Request.Start));
+		const int32 GridCountX = Search->GetGraph()->GetGridCountX();
+
+		TArray<int32> GoalStates;
+		GoalStates.Reserve(Request.Goals.Num());
+
+		for (const FIntPoint& Goal : Request.Goals)
+		{
+			GoalStates.Add(Goal.X + (Goal.Y * GridCountX));
+		}
+
+		Search->Pather->SetSearchLimits(Request.Limits);
+
+		const int32 Result = Search->Pather->BeginSolveForAnyGoal(Request.Start.X + (Request.Start.Y * GridCountX), GoalStates);
+
+		if (Result == MicroPanther::FMicroPather::START_END_SAME)
+		{
+			OutResult.bSuccess = true;
+			OutResult.Path.Add(Request.Start);
+		}
+
+		if (Result != MicroPanther::FMicroPather::SOLVING)
+		{
+			return nullptr;
+		}
+
+		return Search;
+	}
+};
+
+FAsyncPathFinder::FAsyncPathFinder()
+	: SharedState(new FSharedState)
+{
+}
+
+void FAsyncPathFinder::Dispatch(const FSideScrollGraphSnapshotPtr& Snapshot, FAsyncPathRequest&& Request, int32 MaxExpansions)
+{
+	if (!ensure(Snapshot.IsValid()))
+	{
+		return;
+	}
+
+	SharedState->NumInFlight.Increment();
+
+	TSharedPtr<FSharedState, ESPMode::ThreadSafe> State = SharedState;
+
+	FFunctionGraphTask::CreateAndDispatchWhenReady([State, Snapshot, Request = MoveTemp(Request), MaxExpansions]()
+	{
+		FAsyncPathSearch::RunSlice(State, Snapshot, &Request, nullptr, MaxExpansions);
+	}, TStatId(), nullptr, ENamedThreads::AnyThread);
+}
+
+void FAsyncPathFinder::Continue(const FAsyncPathSearchPtr& Search, int32 MaxExpansions)
+{
+	if (!ensure(Search.IsValid()))
+	{
+		return;
+	}
+
+	SharedState->NumInFlight.Increment();
+
+	TSharedPtr<FSharedState, ESPMode::ThreadSafe> State = SharedState;
+
+	FFunctionGraphTask::CreateAndDispatchWhenReady([State, Search, MaxExpansions]()
+	{
+		FAsyncPathSearch::RunSlice(State, Search->Snapshot, nullptr, Search, MaxExpansions);
+	}, TStatId(), nullptr, ENamedThreads::AnyThread);
+}
+
+void FAsyncPathFinder::AddResult(FAsyncPathResult&& Result)
+{
+	SharedState->Results.Enqueue(MoveTemp(Result));
+}
+
+bool FAsyncPathFinder::PopResult(FAsyncPathResult& OutResult)
+{
+	return SharedState->Results.Dequeue(OutResult);
+}
+
+int32 FAsyncPathFinder::GetNumInFlight() const
+{
+	return SharedState->NumInFlight.GetValue();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SideScrollGraph.h"
+
+// Read-only copy of the nav graph shared with worker threads
+typedef TSharedPtr<const FSideScrollGraph, ESPMode::ThreadSafe> FSideScrollGraphSnapshotPtr;
+
+struct FAsyncPathRequest
+{
+	uint32 RequestId;
+
+	// Origin space
+	FIntPoint Start;
+
+	// One goal is a plain solve, more is a solve to whichever is cheapest
+	TArray<FIntPoint> Goals;
+
+	// Caps on the whole solve, over all its slices
+	MicroPanther::FSearchLimits Limits;
+};
+
+// Search of a time-sliced request between slices. Keeps its pather and snapshot until it is continued or dropped.
+struct FAsyncPathSearch;
+
+typedef TSharedPtr<FAsyncPathSearch, ESPMode::ThreadSafe> FAsyncPathSearchPtr;
+
+struct FAsyncPathResult
+{
+	uint32 RequestId;
+	bool bSuccess;
+
+	// The search limits stopped the solve. Path leads to the explored cell closest to the goals.
+	bool bPartial;
+
+	// Set if the solve ran out of expansions. Pass it to Continue for the rest of the search.
+	FAsyncPathSearchPtr Search;
+
+	// Goal reached, or the end of a partial path. Origin space.
+	FIntPoint Goal;
+
+	// Cells from start to goal. Origin space.
+	TArray<FIntPoint> Path;
+
+	// Time the worker spent on the solve, or on this slice of it
+	float SolveMilliseconds;
+};
+
+// Solves path requests on task graph worker threads, each against the graph snapshot it was dispatched with.
+// Every running solve borrows its own TMicroPather from a pool. Results are queued for the game thread.
+// A solve expands at most MaxExpansions nodes per dispatch, 0 for no limit. Unfinished solves come back as
+// results with a Search, so the caller decides when the next slice runs.
+class FAsyncPathFinder
+{
+public:
+	FAsyncPathFinder();
+
+	void Dispatch(const FSideScrollGraphSnapshotPtr& Snapshot, FAsyncPathRequest&& Request, int32 MaxExpansions);
+	void Continue(const FAsyncPathSearchPtr& Search, int32 MaxExpansions);
+
+	// Queues a result without solving, for requests rejected up front
+	void AddResult(FAsyncPathResult&& Result);
+
+	bool PopResult(FAsyncPathResult& OutResult);
+
+	int32 GetNumInFlight() const;
+
+private:
+	// Kept alive by running tasks, so the finder can be destroyed while solves are still in flight
+	struct FSharedState;
+	friend struct FAsyncPathSearch;
+
+	TSharedPtr<FSharedState, ESPMode::ThreadSafe> SharedState;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Array kept in fixed size pages that copies of it share. A page is copied the first time it is written while
+// another copy still holds it, so copying the array copies one pointer per page, and every later copy only pays
+// for the pages written since. A copy can be read on other threads while the original is written.
+template<typename ElementType, int32 PageShift = 12>
+class TCopyOnWriteArray
+{
+public:
+	static const int32 PageSize = 1 << PageShift;
+	static const int32 PageMask = PageSize - 1;
+
+	TCopyOnWriteArray()
+		: NumElements(0)
+	{
+	}
+
+	// Fresh pages, no copy of the array sees them
+	void Init(const ElementType& Value, int32 InNumElements)
+	{
+		const int32 NumPages = (InNumElements + PageSize - 1) >> PageShift;
+
+		NumElements = InNumElements;
+		Pages.Reset(NumPages);
+
+		for (int32 i = 0; i < NumPages; ++i)
+		{
+			TArray<ElementType>* Page = new TArray<ElementType>();
+			Page->Init(Value, PageSize);
+
+			Pages.Add(MakeShareable(Page));
+		}
+	}
+
+	void Reset()
+	{
+		NumElements = 0;
+		Pages.Reset();
+	}
+
+	int32 Num() const { return NumElements; }
+
+	// Elements of one page are contiguous, so rows that don't cross a page can be read through the reference
+	FORCEINLINE const ElementType& operator[](int32 Index) const
+	{
+		return Pages[Index >> PageShift]->GetData()[Index & PageMask];
+	}
+
+	FORCEINLINE ElementType& GetMutable(int32 Index)
+	{
+		return GetMutablePage(Index >> PageShift)[Index & PageMask];
+	}
+
+private:
+	ElementType* GetMutablePage(int32 PageIndex)
+	{
+		TSharedPtr<TArray<ElementType>, ESPMode::ThreadSafe>& Page = Pages[PageIndex];
+
+		// Only this thread makes copies, so a page no copy holds can't become shared while it is written
+		if (!Page.IsUnique())
+		{
+			Page = MakeShareable(new TArray<ElementType>(*Page));
+		}
+
+		return Page->GetData();
+	}
+
+	TArray<TSharedPtr<TArray<ElementType>, ESPMode::ThreadSafe>> Pages;
+	int32 NumElements;
+};
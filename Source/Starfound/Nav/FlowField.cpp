@@ -0,0 +1,266 @@
+#include "FlowField.h"
+#include "SideScrollGraph.h"
+
+FFlowField::FFlowField(const FSideScrollGraph& InGraph, const TArray<FIntPoint>& InGoals)
+	: Graph(InGraph)
+	, Goals(InGoals)
+{
+	Rebuild();
+}
+
+void FFlowField::Rebuild()
+{
+	const int32 NumStates = Graph.GetGridCountX() * Graph.GetGridCountY();
+
+	Costs.Init(FLT_MAX, NumStates);
+	Directions.Init(NoDirection, NumStates);
+	OpenCells.Reset();
+
+	for (const FIntPoint& Goal : Goals)
+	{
+		if (IsWalkable(Goal))
+		{
+			SeedCell(CellToState(Goal));
+		}
+	}
+
+	Propagate();
+}
+
+void FFlowField::UpdateCells(const TArray<FIntPoint>& ChangedCells)
+{
+	InvalidatedStates.Reset();
+
+	// Cells that led through a newly blocked cell lose their cost, and so do the cells that led through them
+	for (const FIntPoint& Cell : ChangedCells)
+	{
+		if (IsInGrid(Cell) && !IsWalkable(Cell))
+		{
+			const int32 State = CellToState(Cell);
+
+			if (Costs[State] != FLT_MAX)
+			{
+				Costs[State] = FLT_MAX;
+				Directions[State] = NoDirection;
+				InvalidatedStates.Add(State);
+			}
+		}
+	}
+
+	for (int32 i = 0; i < InvalidatedStates.Num(); ++i)
+	{
+		const FIntPoint Cell = StateToCell(InvalidatedStates[i]);
+
+		for (uint8 Direction = PositiveX; Direction <= NegativeY; ++Direction)
+		{
+			const FIntPoint Neighbor = StepInDirection(Cell, Direction);
+
+			if (IsInGrid(Neighbor))
+			{
+				const int32 NeighborState = CellToState(Neighbor);
+
+				if (Directions[NeighborState] != NoDirection && StepInDirection(Neighbor, Directions[NeighborState]) == Cell)
+				{
+					Costs[NeighborState] = FLT_MAX;
+					Directions[NeighborState] = NoDirection;
+					InvalidatedStates.Add(NeighborState);
+				}
+			}
+		}
+	}
+
+	// Everything else kept its cost. Refill the lost cells from their edges, and the opened cells with them.
+	OpenCells.Reset();
+
+	for (int32 State : InvalidatedStates)
+	{
+		if (IsWalkable(StateToCell(State)))
+		{
+			SeedCell(State);
+		}
+	}
+
+	for (const FIntPoint& Cell : ChangedCells)
+	{
+		if (IsWalkable(Cell) && Costs[CellToState(Cell)] == FLT_MAX)
+		{
+			SeedCell(CellToState(Cell));
+		}
+	}
+
+	Propagate();
+}
+
+float FFlowField::GetCost(const FIntPoint& Cell) const
+{
+	return IsInGrid(Cell) ? Costs[CellToState(Cell)] : FLT_MAX;
+}
+
+bool FFlowField::GetNextCell(const FIntPoint& Cell, FIntPoint& OutNext) const
+{
+	if (!IsInGrid(Cell) || Directions[CellToState(Cell)] == NoDirection)
+	{
+		return false;
+	}
+
+	OutNext = StepInDirection(Cell, Directions[CellToState(Cell)]);
+
+	return true;
+}
+
+bool FFlowField::GetPath(const FIntPoint& Start, TArray<int32>& OutPath) const
+{
+	OutPath.Reset();
+
+	if (!IsInGrid(Start))
+	{
+		return false;
+	}
+
+	const int32 StartState = CellToState(Start);
+	int32 State = StartState;
+
+	if (!IsWalkable(Start))
+	{
+		Graph.ForEachAdjacent(StartState, [&](int32 AdjacentState, float Cost)
+		{
+			if (Costs[AdjacentState] < FLT_MAX && (State == StartState || Costs[AdjacentState] < Costs[State]))
+			{
+				State = AdjacentState;
+			}
+		});
+
+		if (State == StartState)
+		{
+			return false;
+		}
+
+		OutPath.Add(StartState);
+	}
+
+	if (Costs[State] == FLT_MAX)
+	{
+		return false;
+	}
+
+	OutPath.Reserve(OutPath.Num() + (int32)Costs[State] + 1);
+	OutPath.Add(State);
+
+	while (Directions[State] != NoDirection)
+	{
+		State = CellToState(StepInDirection(StateToCell(State), Directions[State]));
+		OutPath.Add(State);
+	}
+
+	return true;
+}
+
+bool FFlowField::IsInGrid(const FIntPoint& Cell) const
+{
+	return Cell.X >= 0 && Cell.X < Graph.GetGridCountX() && Cell.Y >= 0 && Cell.Y < Graph.GetGridCountY();
+}
+
+bool FFlowField::IsWalkable(const FIntPoint& Cell) const
+{
+	// Cells outside the grid are blocked
+	return Graph.GetHeight(Cell.X, Cell.Y) != -1;
+}
+
+FIntPoint FFlowField::StateToCell(int32 State) const
+{
+	return FIntPoint(State % Graph.GetGridCountX(), State / Graph.GetGridCountX());
+}
+
+int32 FFlowField::CellToState(const FIntPoint& Cell) const
+{
+	return Cell.X + (Cell.Y * Graph.GetGridCountX());
+}
+
+uint8 FFlowField::GetDirection(const FIntPoint& From, const FIntPoint& To)
+{
+	if (To.X != From.X)
+	{
+		return To.X > From.X ? PositiveX : NegativeX;
+	}
+
+	return To.Y > From.Y ? PositiveY : NegativeY;
+}
+
+FIntPoint FFlowField::StepInDirection(const FIntPoint& Cell, uint8 Direction)
+{
+	switch (Direction)
+	{
+	case PositiveX:
+		return FIntPoint(Cell.X + 1, Cell.Y);
+	case PositiveY:
+		return FIntPoint(Cell.X, Cell.Y + 1);
+	case NegativeX:
+		return FIntPoint(Cell.X - 1, Cell.Y);
+	default:
+		return FIntPoint(Cell.X, Cell.Y - 1);
+	}
+}
+
+void FFlowField::SeedCell(int32 State)
+{
+	const FIntPoint Cell = StateToCell(State);
+
+	if (Goals.Contains(Cell))
+	{
+		Costs[State] = 0.0f;
+		Directions[State] = NoDirection;
+	}
+	else
+	{
+		Graph.ForEachAdjacent(State, [&](int32 AdjacentState, float Cost)
+		{
+			if (Costs[AdjacentState] < FLT_MAX && Costs[AdjacentState] + Cost < Costs[State])
+			{
+				Costs[State] = Costs[AdjacentState] + Cost;
+				Directions[State] = GetDirection(Cell, StateToCell(AdjacentState));
+			}
+		});
+
+		if (Costs[State] == FLT_MAX)
+		{
+			return;
+		}
+	}
+
+	FOpenCell OpenCell = { State, Costs[State] };
+	OpenCells.HeapPush(OpenCell, [](const FOpenCell& A, const FOpenCell& B) { return A.Cost < B.Cost; });
+}
+
+void FFlowField::Propagate()
+{
+	const auto CostLess = [](const FOpenCell& A, const FOpenCell& B) { return A.Cost < B.Cost; };
+
+	while (OpenCells.Num() > 0)
+	{
+		FOpenCell OpenCell;
+		OpenCells.HeapPop(OpenCell, CostLess, false);
+
+		// Queued again since with a lower cost
+		if (OpenCell.Cost > Costs[OpenCell.State])
+		{
+			continue;
+		}
+
+		const FIntPoint Cell = StateToCell(OpenCell.State);
+
+		// Edges are the same both ways, so the cells next to this one can step into it
+		Graph.ForEachAdjacent(OpenCell.State, [&](int32 AdjacentState, float Cost)
+		{
+			const float NewCost = OpenCell.Cost + Cost;
+
+			if (NewCost < Costs[AdjacentState])
+			{
+				Costs[AdjacentState] = NewCost;
+				Directions[AdjacentState] = GetDirection(StateToCell(AdjacentState), Cell);
+
+				FOpenCell AdjacentCell = { AdjacentState, NewCost };
+				OpenCells.HeapPush(AdjacentCell, CostLess);
+			}
+		});
+	}
+}
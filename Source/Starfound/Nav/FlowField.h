@@ -0,0 +1,75 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSideScrollGraph;
+
+// Cost from every cell of FSideScrollGraph to the nearest of a set of goal cells, and the step to take toward it.
+// Built once by Dijkstra out of the goals. Every move costs the same both ways, so the cost out of the goals is the
+// cost to them. Reads are constant time, so any number of pawns heading to the same goals can share one field.
+class FFlowField
+{
+public:
+	FFlowField(const FSideScrollGraph& InGraph, const TArray<FIntPoint>& InGoals);
+
+	const TArray<FIntPoint>& GetGoals() const { return Goals; }
+
+	// Recomputes every cell. Call after the grid is resized or rebuilt.
+	void Rebuild();
+
+	// Recomputes the cells whose cost the changed cells can change. Only blocked-ness matters, changed heights
+	// of walkable cells are ignored.
+	void UpdateCells(const TArray<FIntPoint>& ChangedCells);
+
+	// FLT_MAX if no goal can be reached
+	float GetCost(const FIntPoint& Cell) const;
+
+	// False on a goal and on cells that can't reach one
+	bool GetNextCell(const FIntPoint& Cell, FIntPoint& OutNext) const;
+
+	// States of FSideScrollGraph from the start to the nearest goal. A blocked start steps into its cheapest
+	// neighbor first. False if no goal can be reached.
+	bool GetPath(const FIntPoint& Start, TArray<int32>& OutPath) const;
+
+private:
+	// Directions to the next cell, in the order of FSideScrollGraph edges
+	enum
+	{
+		PositiveX = 0,
+		PositiveY = 1,
+		NegativeX = 2,
+		NegativeY = 3,
+		NoDirection = 0xff
+	};
+
+	struct FOpenCell
+	{
+		int32 State;
+		float Cost;
+	};
+
+	bool IsInGrid(const FIntPoint& Cell) const;
+	bool IsWalkable(const FIntPoint& Cell) const;
+
+	FIntPoint StateToCell(int32 State) const;
+	int32 CellToState(const FIntPoint& Cell) const;
+
+	static uint8 GetDirection(const FIntPoint& From, const FIntPoint& To);
+	static FIntPoint StepInDirection(const FIntPoint& Cell, uint8 Direction);
+
+	// Cost of a walkable cell from its goal or its cheapest neighbor. Queues the cell if that lowers it.
+	void SeedCell(int32 State);
+
+	// Dijkstra from the queued cells
+	void Propagate();
+
+	const FSideScrollGraph& Graph;
+	TArray<FIntPoint> Goals;
+
+	TArray<float> Costs;
+	TArray<uint8> Directions;
+
+	// Kept to reduce memory allocation
+	TArray<FOpenCell> OpenCells;
+	TArray<int32> InvalidatedStates;
+};
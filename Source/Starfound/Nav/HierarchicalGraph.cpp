@@ -0,0 +1,558 @@
+#include "HierarchicalGraph.h"
+#include "SideScrollGraph.h"
+
+FHierarchicalGraph::FHierarchicalGraph(const FSideScrollGraph& InGraph, int32 InClusterSize)
+	: Graph(InGraph)
+	, ClusterSize(FMath::Max(InClusterSize, 2))
+	, NumClustersX(0)
+	, NumClustersY(0)
+	, NumExpandedNodes(0)
+	, QueryVersion(0)
+	, GraphVersion(0)
+	, QueryStart(INDEX_NONE, INDEX_NONE)
+	, QueryEnd(INDEX_NONE, INDEX_NONE)
+	, QueryEndCluster(INDEX_NONE)
+{
+	// Cached abstract paths stay good until a cluster on them changes, or the query nodes stand for other cells
+	AbstractPather.Reset(new MicroPanther::FMicroPather(this, 250, 8, true, MicroPanther::EOpenQueueType::BinaryHeap));
+}
+
+void FHierarchicalGraph::Rebuild()
+{
+	NumClustersX = (Graph.GetGridCountX() + ClusterSize - 1) / ClusterSize;
+	NumClustersY = (Graph.GetGridCountY() + ClusterSize - 1) / ClusterSize;
+
+	const int32 NumClusters = NumClustersX * NumClustersY;
+
+	Nodes.Reset();
+	Nodes.SetNum(NumQueryNodes);
+	FreeNodes.Reset();
+
+	ClusterNodes.Reset();
+	ClusterNodes.SetNum(NumClusters);
+	BorderNodes.Reset();
+	BorderNodes.SetNum(NumClusters * 2);
+
+	DirtyClusters.Reset();
+
+	// Every node changed
+	++GraphVersion;
+	ClusterVersions.Init(GraphVersion, NumClusters);
+
+	QueryStart = FIntPoint(INDEX_NONE, INDEX_NONE);
+	QueryEnd = FIntPoint(INDEX_NONE, INDEX_NONE);
+	QueryEndCluster = INDEX_NONE;
+
+	for (int32 Cluster = 0; Cluster < NumClusters; ++Cluster)
+	{
+		DirtyClusters.Add(Cluster);
+	}
+
+	UpdateDirtyClusters();
+}
+
+void FHierarchicalGraph::MarkCellsDirty(const TArray<FIntPoint>& ChangedCells)
+{
+	for (const FIntPoint& Cell : ChangedCells)
+	{
+		const int32 Cluster = GetClusterIndex(Cell);
+
+		if (Cluster != INDEX_NONE)
+		{
+			DirtyClusters.AddUnique(Cluster);
+		}
+	}
+}
+
+int32 FHierarchicalGraph::GetClusterIndex(const FIntPoint& Cell) const
+{
+	if (Cell.X < 0 || Cell.X >= Graph.GetGridCountX() || Cell.Y < 0 || Cell.Y >= Graph.GetGridCountY())
+	{
+		return INDEX_NONE;
+	}
+
+	return (Cell.X / ClusterSize) + ((Cell.Y / ClusterSize) * NumClustersX);
+}
+
+void FHierarchicalGraph::GetClusterBounds(int32 Cluster, FIntPoint& OutMin, FIntPoint& OutMax) const
+{
+	OutMin.X = (Cluster % NumClustersX) * ClusterSize;
+	OutMin.Y = (Cluster / NumClustersX) * ClusterSize;
+	OutMax.X = FMath::Min(OutMin.X + ClusterSize, Graph.GetGridCountX()) - 1;
+	OutMax.Y = FMath::Min(OutMin.Y + ClusterSize, Graph.GetGridCountY()) - 1;
+}
+
+void FHierarchicalGraph::UpdateDirtyClusters()
+{
+	if (DirtyClusters.Num() == 0)
+	{
+		return;
+	}
+
+	// A changed cluster can gain or lose entrances on all four sides, which changes the nodes of its neighbors too
+	TArray<int32> DirtyBorders;
+	TArray<int32> AffectedClusters;
+
+	for (int32 Cluster : DirtyClusters)
+	{
+		const int32 ClusterX = Cluster % NumClustersX;
+		const int32 ClusterY = Cluster / NumClustersX;
+
+		AffectedClusters.AddUnique(Cluster);
+
+		if (ClusterX + 1 < NumClustersX)
+		{
+			DirtyBorders.AddUnique(Cluster * 2);
+			AffectedClusters.AddUnique(Cluster + 1);
+		}
+		if (ClusterY + 1 < NumClustersY)
+		{
+			DirtyBorders.AddUnique((Cluster * 2) + 1);
+			AffectedClusters.AddUnique(Cluster + NumClustersX);
+		}
+		if (ClusterX > 0)
+		{
+			DirtyBorders.AddUnique((Cluster - 1) * 2);
+			AffectedClusters.AddUnique(Cluster - 1);
+		}
+		if (ClusterY > 0)
+		{
+			DirtyBorders.AddUnique(((Cluster - NumClustersX) * 2) + 1);
+			AffectedClusters.AddUnique(Cluster - NumClustersX);
+		}
+	}
+
+	for (int32 Border : DirtyBorders)
+	{
+		RemoveBorderNodes(Border);
+	}
+
+	for (int32 Border : DirtyBorders)
+	{
+		AddBorderNodes(Border);
+	}
+
+	++GraphVersion;
+
+	// Reused node indices always land in an affected cluster, so their old neighbors go stale too
+	for (int32 Cluster : AffectedClusters)
+	{
+		ConnectCluster(Cluster);
+		ClusterVersions[Cluster] = GraphVersion;
+	}
+
+	DirtyClusters.Reset();
+}
+
+void FHierarchicalGraph::RemoveBorderNodes(int32 Border)
+{
+	for (int32 Node : BorderNodes[Border])
+	{
+		ClusterNodes[Nodes[Node].Cluster].RemoveSingleSwap(Node, false);
+
+		Nodes[Node].Edges.Reset();
+		Nodes[Node].Twin = INDEX_NONE;
+		Nodes[Node].Cluster = INDEX_NONE;
+
+		FreeNodes.Add(Node);
+	}
+
+	BorderNodes[Border].Reset();
+}
+
+void FHierarchicalGraph::AddBorderNodes(int32 Border)
+{
+	const int32 Cluster = Border / 2;
+	const bool bRightSide = (Border % 2) == 0;
+
+	FIntPoint ClusterMin;
+	FIntPoint ClusterMax;
+	GetClusterBounds(Cluster, ClusterMin, ClusterMax);
+
+	// Walk along the border. Cell is inside the cluster, the other cell is across the border.
+	const FIntPoint Step = bRightSide ? FIntPoint(0, 1) : FIntPoint(1, 0);
+	const FIntPoint Across = bRightSide ? FIntPoint(1, 0) : FIntPoint(0, 1);
+	const FIntPoint First = bRightSide ? FIntPoint(ClusterMax.X, ClusterMin.Y) : FIntPoint(ClusterMin.X, ClusterMax.Y);
+	const int32 Length = bRightSide ? (ClusterMax.Y - ClusterMin.Y + 1) : (ClusterMax.X - ClusterMin.X + 1);
+
+	// Long entrances get a node at both ends so paths don't have to detour through the middle
+	const int32 LongEntranceLength = 6;
+
+	int32 RunStart = INDEX_NONE;
+
+	for (int32 i = 0; i <= Length; ++i)
+	{
+		const FIntPoint Cell = First + (Step * i);
+		const FIntPoint OtherCell = Cell + Across;
+
+		const bool bOpen = (i < Length)
+			&& Graph.GetHeight(Cell.X, Cell.Y) != -1
+			&& Graph.GetHeight(OtherCell.X, OtherCell.Y) != -1;
+
+		if (bOpen)
+		{
+			if (RunStart == INDEX_NONE)
+			{
+				RunStart = i;
+			}
+			continue;
+		}
+
+		if (RunStart == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const int32 RunEnd = i - 1;
+
+		if (RunEnd - RunStart + 1 >= LongEntranceLength)
+		{
+			AddEntrance(Border, First + (Step * RunStart), First + (Step * RunStart) + Across);
+			AddEntrance(Border, First + (Step * RunEnd), First + (Step * RunEnd) + Across);
+		}
+		else
+		{
+			const int32 Middle = (RunStart + RunEnd) / 2;
+
+			AddEntrance(Border, First + (Step * Middle), First + (Step * Middle) + Across);
+		}
+
+		RunStart = INDEX_NONE;
+	}
+}
+
+void FHierarchicalGraph::AddEntrance(int32 Border, const FIntPoint& Cell, const FIntPoint& OtherCell)
+{
+	const int32 Node = AddNode(Cell);
+	const int32 OtherNode = AddNode(OtherCell);
+
+	Nodes[Node].Twin = OtherNode;
+	Nodes[OtherNode].Twin = Node;
+
+	BorderNodes[Border].Add(Node);
+	BorderNodes[Border].Add(OtherNode);
+}
+
+int32 FHierarchicalGraph::AddNode(const FIntPoint& Cell)
+{
+	int32 Node;
+
+	if (FreeNodes.Num() > 0)
+	{
+		Node = FreeNodes.Pop(false);
+	}
+	else
+	{
+		Node = Nodes.AddDefaulted();
+	}
+
+	Nodes[Node].Cell = Cell;
+	Nodes[Node].Cluster = GetClusterIndex(Cell);
+	Nodes[Node].Twin = INDEX_NONE;
+	Nodes[Node].Edges.Reset();
+
+	ClusterNodes[Nodes[Node].Cluster].Add(Node);
+
+	return Node;
+}
+
+void FHierarchicalGraph::ConnectCluster(int32 Cluster)
+{
+	const TArray<int32>& NodesInCluster = ClusterNodes[Cluster];
+
+	for (int32 Node : NodesInCluster)
+	{
+		Nodes[Node].Edges.Reset();
+	}
+
+	for (int32 Node : NodesInCluster)
+	{
+		SearchCluster(Nodes[Node].Cell, Cluster);
+
+		for (int32 OtherNode : NodesInCluster)
+		{
+			const int32 Distance = GetClusterDistance(Nodes[OtherNode].Cell);
+
+			if (OtherNode != Node && Distance != INDEX_NONE)
+			{
+				FEdge Edge = { OtherNode, (float)Distance };
+				Nodes[Node].Edges.Add(Edge);
+			}
+		}
+	}
+}
+
+void FHierarchicalGraph::SearchCluster(const FIntPoint& Start, int32 Cluster, const FIntPoint* Target)
+{
+	const int32 AdjacentX[] = { 1, 0, -1, 0 };
+	const int32 AdjacentY[] = { 0, 1, 0, -1 };
+
+	GetClusterBounds(Cluster, SearchMin, SearchMax);
+
+	const int32 Width = SearchMax.X - SearchMin.X + 1;
+	const int32 NumCells = Width * (SearchMax.Y - SearchMin.Y + 1);
+
+	SearchDistances.Init(INDEX_NONE, NumCells);
+	SearchParents.SetNum(NumCells, false);
+	SearchQueue.Reset();
+
+	const int32 StartIndex = (Start.X - SearchMin.X) + ((Start.Y - SearchMin.Y) * Width);
+	const int32 TargetIndex = Target ? (Target->X - SearchMin.X) + ((Target->Y - SearchMin.Y) * Width) : INDEX_NONE;
+
+	SearchDistances[StartIndex] = 0;
+	SearchParents[StartIndex] = INDEX_NONE;
+	SearchQueue.Add(StartIndex);
+
+	for (int32 QueueIndex = 0; QueueIndex < SearchQueue.Num(); ++QueueIndex)
+	{
+		const int32 Index = SearchQueue[QueueIndex];
+
+		if (Index == TargetIndex)
+		{
+			break;
+		}
+
+		const int32 X = SearchMin.X + (Index % Width);
+		const int32 Y = SearchMin.Y + (Index / Width);
+
+		++NumExpandedNodes;
+
+		for (int32 i = 0; i < ARRAY_COUNT(AdjacentX); ++i)
+		{
+			const int32 AdjacentX2 = X + AdjacentX[i];
+			const int32 AdjacentY2 = Y + AdjacentY[i];
+
+			if (AdjacentX2 < SearchMin.X || AdjacentX2 > SearchMax.X || AdjacentY2 < SearchMin.Y || AdjacentY2 > SearchMax.Y)
+			{
+				continue;
+			}
+
+			const int32 AdjacentIndex = (AdjacentX2 - SearchMin.X) + ((AdjacentY2 - SearchMin.Y) * Width);
+
+			if (SearchDistances[AdjacentIndex] == INDEX_NONE && Graph.GetHeight(AdjacentX2, AdjacentY2) != -1)
+			{
+				SearchDistances[AdjacentIndex] = SearchDistances[Index] + 1;
+				SearchParents[AdjacentIndex] = Index;
+				SearchQueue.Add(AdjacentIndex);
+			}
+		}
+	}
+}
+
+int32 FHierarchicalGraph::GetClusterDistance(const FIntPoint& Cell) const
+{
+	if (Cell.X < SearchMin.X || Cell.X > SearchMax.X || Cell.Y < SearchMin.Y || Cell.Y > SearchMax.Y)
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 Width = SearchMax.X - SearchMin.X + 1;
+
+	return SearchDistances[(Cell.X - SearchMin.X) + ((Cell.Y - SearchMin.Y) * Width)];
+}
+
+void FHierarchicalGraph::AppendClusterPath(const FIntPoint& Cell, TArray<void*>& OutPath)
+{
+	const int32 Width = SearchMax.X - SearchMin.X + 1;
+	const int32 FirstIndex = OutPath.Num();
+
+	// Walk back to the start, then put the cells in order
+	for (int32 Index = (Cell.X - SearchMin.X) + ((Cell.Y - SearchMin.Y) * Width); SearchParents[Index] != INDEX_NONE; Index = SearchParents[Index])
+	{
+		OutPath.Add(Graph.Vec2ToState(FIntPoint(SearchMin.X + (Index % Width), SearchMin.Y + (Index / Width))));
+	}
+
+	for (int32 i = FirstIndex, j = OutPath.Num() - 1; i < j; ++i, --j)
+	{
+		OutPath.Swap(i, j);
+	}
+}
+
+int32 FHierarchicalGraph::FindPath(const FIntPoint& Start, const FIntPoint& End, TArray<void*>& OutPath, float& OutCost)
+{
+	UpdateDirtyClusters();
+
+	NumExpandedNodes = 0;
+
+	if (Start == End)
+	{
+		return MicroPanther::FMicroPather::START_END_SAME;
+	}
+
+	const int32 StartCluster = GetClusterIndex(Start);
+	const int32 EndCluster = GetClusterIndex(End);
+
+	if (StartCluster == INDEX_NONE || EndCluster == INDEX_NONE || Graph.GetHeight(End.X, End.Y) == -1)
+	{
+		return MicroPanther::FMicroPather::NO_SOLUTION;
+	}
+
+	// The query nodes stand for other cells, and the old and new end clusters lose or gain edges to the end node.
+	// Asking for the same cells again changes nothing, so the cache can answer it.
+	if (Start != QueryStart || End != QueryEnd)
+	{
+		++GraphVersion;
+		QueryVersion = GraphVersion;
+
+		if (End != QueryEnd)
+		{
+			if (QueryEndCluster != INDEX_NONE)
+			{
+				ClusterVersions[QueryEndCluster] = GraphVersion;
+			}
+
+			ClusterVersions[EndCluster] = GraphVersion;
+		}
+
+		QueryStart = Start;
+		QueryEnd = End;
+		QueryEndCluster = EndCluster;
+	}
+
+	// Connect the query nodes to their clusters
+	FNode& StartQueryNode = Nodes[StartNode];
+	StartQueryNode.Cell = Start;
+	StartQueryNode.Cluster = StartCluster;
+	StartQueryNode.Twin = INDEX_NONE;
+	StartQueryNode.Edges.Reset();
+
+	SearchCluster(Start, StartCluster);
+
+	for (int32 Node : ClusterNodes[StartCluster])
+	{
+		const int32 Distance = GetClusterDistance(Nodes[Node].Cell);
+
+		if (Distance != INDEX_NONE)
+		{
+			FEdge Edge = { Node, (float)Distance };
+			StartQueryNode.Edges.Add(Edge);
+		}
+	}
+
+	if (StartCluster == EndCluster && GetClusterDistance(End) != INDEX_NONE)
+	{
+		FEdge Edge = { (int32)EndNode, (float)GetClusterDistance(End) };
+		StartQueryNode.Edges.Add(Edge);
+	}
+
+	FNode& EndQueryNode = Nodes[EndNode];
+	EndQueryNode.Cell = End;
+	EndQueryNode.Cluster = EndCluster;
+	EndQueryNode.Twin = INDEX_NONE;
+	EndQueryNode.Edges.Reset();
+
+	// Walkable cells connect both ways, so distances from the end are distances to it
+	SearchCluster(End, EndCluster);
+
+	EndEdges.Reset();
+
+	for (int32 Node : ClusterNodes[EndCluster])
+	{
+		const int32 Distance = GetClusterDistance(Nodes[Node].Cell);
+
+		if (Distance != INDEX_NONE)
+		{
+			FEdge Edge = { Node, (float)Distance };
+			EndEdges.Add(Edge);
+		}
+	}
+
+	float TotalCost = 0;
+	const int32 Result = AbstractPather->Solve(NodeToState(StartNode), NodeToState(EndNode), &AbstractPath, &TotalCost);
+
+	NumExpandedNodes += AbstractPather->GetNumExpandedNodes();
+
+	if (Result == MicroPanther::FMicroPather::SOLVED)
+	{
+		OutPath.Reset();
+		OutPath.Add(Graph.Vec2ToState(Start));
+
+		for (int32 i = 0; i + 1 < AbstractPath.Num(); ++i)
+		{
+			const FNode& From = Nodes[StateToNode(AbstractPath[i])];
+			const FNode& To = Nodes[StateToNode(AbstractPath[i + 1])];
+
+			if (From.Cluster != To.Cluster)
+			{
+				// Across an entrance
+				OutPath.Add(Graph.Vec2ToState(To.Cell));
+			}
+			else
+			{
+				SearchCluster(From.Cell, From.Cluster, &To.Cell);
+				AppendClusterPath(To.Cell, OutPath);
+			}
+		}
+
+		OutCost = TotalCost;
+	}
+
+	StartQueryNode.Edges.Reset();
+	EndEdges.Reset();
+
+	return Result;
+}
+
+float FHierarchicalGraph::LeastCostEstimate(void* StartState, void* EndState)
+{
+	const FIntPoint& StartCell = Nodes[StateToNode(StartState)].Cell;
+	const FIntPoint& EndCell = Nodes[StateToNode(EndState)].Cell;
+
+	return FMath::Abs(StartCell.X - EndCell.X) + FMath::Abs(StartCell.Y - EndCell.Y);
+}
+
+void FHierarchicalGraph::AdjacentCost(void* State, TArray<MicroPanther::FStateCost>* AdjacentCosts)
+{
+	const int32 NodeIndex = StateToNode(State);
+	const FNode& Node = Nodes[NodeIndex];
+
+	for (const FEdge& Edge : Node.Edges)
+	{
+		MicroPanther::FStateCost Cost = { NodeToState(Edge.Node), Edge.Cost };
+		AdjacentCosts->Add(Cost);
+	}
+
+	if (Node.Twin != INDEX_NONE)
+	{
+		MicroPanther::FStateCost Cost = { NodeToState(Node.Twin), 1.0f };
+		AdjacentCosts->Add(Cost);
+	}
+
+	if (NodeIndex != StartNode && Node.Cluster == Nodes[EndNode].Cluster)
+	{
+		for (const FEdge& Edge : EndEdges)
+		{
+			if (Edge.Node == NodeIndex)
+			{
+				MicroPanther::FStateCost Cost = { NodeToState(EndNode), Edge.Cost };
+				AdjacentCosts->Add(Cost);
+				break;
+			}
+		}
+	}
+}
+
+uint32 FHierarchicalGraph::GetStateVersion(void* State) const
+{
+	const int32 NodeIndex = StateToNode(State);
+
+	// The start node is connected to every node of its cluster
+	if (NodeIndex < NumQueryNodes)
+	{
+		const int32 Cluster = Nodes[NodeIndex].Cluster;
+
+		return Cluster != INDEX_NONE ? FMath::Max(QueryVersion, ClusterVersions[Cluster]) : QueryVersion;
+	}
+
+	const int32 Cluster = Nodes[NodeIndex].Cluster;
+
+	return Cluster != INDEX_NONE ? ClusterVersions[Cluster] : GraphVersion;
+}
+
+void FHierarchicalGraph::PrintStateInfo(void* State)
+{
+	const int32 NodeIndex = StateToNode(State);
+	const FNode& Node = Nodes[NodeIndex];
+
+	printf("%d(%d,%d) cluster %d", NodeIndex, Node.Cell.X, Node.Cell.Y, Node.Cluster);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Micropather.h"
+
+class FSideScrollGraph;
+
+// Abstract graph over FSideScrollGraph for hierarchical path finding (HPA*).
+// The grid is split into square clusters. Runs of walkable cell pairs across a cluster border are
+// entrances, and every entrance adds a node on each side of the border. Nodes of the same cluster
+// are connected with their shortest path cost inside the cluster.
+// void* state is defined as node index + 1
+class FHierarchicalGraph : public MicroPanther::FGraph
+{
+public:
+	FHierarchicalGraph(const FSideScrollGraph& InGraph, int32 InClusterSize = 16);
+
+	// Rebuilds every cluster. Call after the grid is resized.
+	void Rebuild();
+
+	// Clusters of the changed cells are rebuilt on the next FindPath
+	void MarkCellsDirty(const TArray<FIntPoint>& ChangedCells);
+
+	// Searches the abstract graph, then refines each abstract edge inside its cluster.
+	// Returns FMicroPather::SOLVED, NO_SOLUTION or START_END_SAME. OutPath holds FSideScrollGraph states.
+	int32 FindPath(const FIntPoint& Start, const FIntPoint& End, TArray<void*>& OutPath, float& OutCost);
+
+	// Abstract nodes expanded plus cells visited inside clusters by the last FindPath
+	int32 GetNumExpandedNodes() const { return NumExpandedNodes; }
+
+	int32 GetNumNodes() const { return Nodes.Num() - FreeNodes.Num(); }
+
+	// Path cache of the abstract search. It hits when the same cells are asked for again and no cluster changed.
+	void GetCacheData(MicroPanther::FCacheData* OutData) { AbstractPather->Debug_GetCacheData(OutData); }
+
+	virtual float LeastCostEstimate(void* StartState, void* EndState) override;
+	virtual void AdjacentCost(void* State, TArray<MicroPanther::FStateCost>* AdjacentCosts) override;
+	virtual void PrintStateInfo(void* State) override;
+
+	// Versioned per cluster, so the abstract pather keeps neighbors of clusters that didn't change
+	virtual bool HasStateVersions() const override { return true; }
+	virtual uint32 GetGraphVersion() const override { return GraphVersion; }
+	virtual uint32 GetStateVersion(void* State) const override;
+
+private:
+	struct FEdge
+	{
+		int32 Node;
+		float Cost;
+	};
+
+	struct FNode
+	{
+		FIntPoint Cell;
+		int32 Cluster;
+
+		// Node on the other side of the entrance. INDEX_NONE for the query nodes.
+		int32 Twin;
+
+		// Intra cluster edges
+		TArray<FEdge> Edges;
+	};
+
+	// Query nodes. They are connected to their cluster for one FindPath only.
+	enum
+	{
+		StartNode = 0,
+		EndNode = 1,
+		NumQueryNodes = 2
+	};
+
+	int32 GetClusterIndex(const FIntPoint& Cell) const;
+	void GetClusterBounds(int32 Cluster, FIntPoint& OutMin, FIntPoint& OutMax) const;
+
+	void UpdateDirtyClusters();
+
+	// Border 0 of a cluster is its right side, border 1 its upper side
+	void RemoveBorderNodes(int32 Border);
+	void AddBorderNodes(int32 Border);
+	void AddEntrance(int32 Border, const FIntPoint& Cell, const FIntPoint& OtherCell);
+	int32 AddNode(const FIntPoint& Cell);
+
+	void ConnectCluster(int32 Cluster);
+
+	// Breadth first search from Start without leaving the cluster. Every move costs 1.
+	// Stops early once Target is reached, if given.
+	void SearchCluster(const FIntPoint& Start, int32 Cluster, const FIntPoint* Target = nullptr);
+	int32 GetClusterDistance(const FIntPoint& Cell) const;
+
+	// Appends the cells of the last SearchCluster path to Cell, Cell included and start excluded
+	void AppendClusterPath(const FIntPoint& Cell, TArray<void*>& OutPath);
+
+	FORCEINLINE void* NodeToState(int32 Node) const { return (void*)(intptr_t)(Node + 1); }
+	FORCEINLINE int32 StateToNode(void* State) const { return (int32)(intptr_t)State - 1; }
+
+	const FSideScrollGraph& Graph;
+
+	int32 ClusterSize;
+	int32 NumClustersX;
+	int32 NumClustersY;
+
+	TArray<FNode> Nodes;
+	TArray<int32> FreeNodes;
+
+	// Nodes of each cluster, query nodes excluded
+	TArray<TArray<int32>> ClusterNodes;
+
+	// Nodes added by each border. index = (Cluster * 2) + Side
+	TArray<TArray<int32>> BorderNodes;
+
+	TArray<int32> DirtyClusters;
+
+	// Version of the nodes of each cluster. Raised to the new GraphVersion when the cluster is reconnected,
+	// and when the end node moves into or out of it, since only its nodes are adjacent to the end node.
+	TArray<uint32> ClusterVersions;
+	uint32 QueryVersion;
+	uint32 GraphVersion;
+
+	// Cells the query nodes stand for until a query asks for others
+	FIntPoint QueryStart;
+	FIntPoint QueryEnd;
+	int32 QueryEndCluster;
+
+	// Edges of the cluster nodes to the end node of the running query
+	TArray<FEdge> EndEdges;
+
+	// SearchCluster results, indexed by cell inside the searched cluster
+	FIntPoint SearchMin;
+	FIntPoint SearchMax;
+	TArray<int32> SearchDistances;
+	TArray<int32> SearchParents;
+	TArray<int32> SearchQueue;
+
+	int32 NumExpandedNodes;
+
+	TArray<void*> AbstractPath;
+	TUniquePtr<MicroPanther::FMicroPather> AbstractPather;
+};
@@ -0,0 +1,215 @@
+#include "JumpPointGraph.h"
+#include "SideScrollGraph.h"
+
+FJumpPointGraph::FJumpPointGraph(const FSideScrollGraph& InGraph)
+	: Graph(InGraph)
+	, EndCell(0, 0)
+{
+	// No path cache. Jumps stop at the end cell, so the neighbors of every state change with the end.
+	JumpPather.Reset(new MicroPanther::FMicroPather(this, 250, 4, false, MicroPanther::EOpenQueueType::BinaryHeap));
+}
+
+int32 FJumpPointGraph::FindPath(const FIntPoint& Start, const FIntPoint& End, TArray<void*>& OutPath, float& OutCost)
+{
+	OutPath.Reset();
+	OutCost = 0;
+
+	if (Start == End)
+	{
+		return MicroPanther::FMicroPather::START_END_SAME;
+	}
+
+	if (!IsWalkable(End.X, End.Y))
+	{
+		return MicroPanther::FMicroPather::NO_SOLUTION;
+	}
+
+	EndCell = End;
+
+	const int32 Result = JumpPather->Solve(CellToState(Start, None), CellToState(End, None), &JumpPath, &OutCost);
+
+	if (Result != MicroPanther::FMicroPather::SOLVED)
+	{
+		return Result;
+	}
+
+	// Fill in the straight runs between jump points
+	OutPath.Reserve((int32)OutCost + 1);
+	OutPath.Add(Graph.Vec2ToState(Start));
+
+	for (int32 i = 1; i < JumpPath.Num(); ++i)
+	{
+		FIntPoint Cell = StateToCell(JumpPath[i - 1]);
+		const FIntPoint JumpPoint = StateToCell(JumpPath[i]);
+		const FIntPoint Step(FMath::Sign(JumpPoint.X - Cell.X), FMath::Sign(JumpPoint.Y - Cell.Y));
+
+		while (Cell != JumpPoint)
+		{
+			Cell += Step;
+			OutPath.Add(Graph.Vec2ToState(Cell));
+		}
+	}
+
+	return Result;
+}
+
+float FJumpPointGraph::LeastCostEstimate(void* StartState, void* EndState)
+{
+	const FIntPoint From = StateToCell(StartState);
+	const FIntPoint To = StateToCell(EndState);
+
+	return FMath::Abs(From.X - To.X) + FMath::Abs(From.Y - To.Y);
+}
+
+void FJumpPointGraph::AdjacentCost(void* State, TArray<MicroPanther::FStateCost>* AdjacentCosts)
+{
+	const FIntPoint Cell = StateToCell(State);
+	const EDirection Direction = StateToDirection(State);
+
+	switch (Direction)
+	{
+	case None:
+		AddJump(Cell, Right, AdjacentCosts);
+		AddJump(Cell, Left, AdjacentCosts);
+		AddJump(Cell, Up, AdjacentCosts);
+		AddJump(Cell, Down, AdjacentCosts);
+		break;
+
+	case Right:
+	case Left:
+		// Turning up or down is always allowed after horizontal moves
+		AddJump(Cell, Direction, AdjacentCosts);
+		AddJump(Cell, Up, AdjacentCosts);
+		AddJump(Cell, Down, AdjacentCosts);
+		break;
+
+	case Up:
+	case Down:
+	{
+		AddJump(Cell, Direction, AdjacentCosts);
+
+		// Turning sideways only if the side cell couldn't be reached by moving sideways first
+		const int32 BehindY = Cell.Y - ((Direction == Up) ? 1 : -1);
+
+		if (IsWalkable(Cell.X + 1, Cell.Y) && !IsWalkable(Cell.X + 1, BehindY))
+		{
+			AddJump(Cell, Right, AdjacentCosts);
+		}
+
+		if (IsWalkable(Cell.X - 1, Cell.Y) && !IsWalkable(Cell.X - 1, BehindY))
+		{
+			AddJump(Cell, Left, AdjacentCosts);
+		}
+		break;
+	}
+
+	default:
+		ensure(0);
+		break;
+	}
+}
+
+void FJumpPointGraph::PrintStateInfo(void* State)
+{
+	// Direction the cell was entered in
+	static const char* DirectionNames[NumDirections] = { "", " right", " left", " up", " down" };
+
+	const FIntPoint Cell = StateToCell(State);
+
+	printf("(%d,%d)%s", Cell.X, Cell.Y, DirectionNames[StateToDirection(State)]);
+}
+
+bool FJumpPointGraph::IsWalkable(int32 X, int32 Y) const
+{
+	return Graph.GetHeight(X, Y) != -1;
+}
+
+bool FJumpPointGraph::Jump(const FIntPoint& Cell, EDirection Direction, FIntPoint& OutJumpPoint) const
+{
+	switch (Direction)
+	{
+	case Right:	return JumpHorizontal(Cell.X, Cell.Y, 1, OutJumpPoint);
+	case Left:	return JumpHorizontal(Cell.X, Cell.Y, -1, OutJumpPoint);
+	case Up:	return JumpVertical(Cell.X, Cell.Y, 1, OutJumpPoint);
+	case Down:	return JumpVertical(Cell.X, Cell.Y, -1, OutJumpPoint);
+	default:	return false;
+	}
+}
+
+bool FJumpPointGraph::JumpHorizontal(int32 X, int32 Y, int32 DeltaX, FIntPoint& OutJumpPoint) const
+{
+	FIntPoint VerticalJumpPoint;
+
+	for (;;)
+	{
+		X += DeltaX;
+
+		if (!IsWalkable(X, Y))
+		{
+			return false;
+		}
+
+		// Stop where a vertical run leads somewhere. Vertical runs are short on our terrain, so this stays cheap.
+		if ((X == EndCell.X && Y == EndCell.Y)
+			|| JumpVertical(X, Y, 1, VerticalJumpPoint)
+			|| JumpVertical(X, Y, -1, VerticalJumpPoint))
+		{
+			OutJumpPoint = FIntPoint(X, Y);
+			return true;
+		}
+	}
+}
+
+bool FJumpPointGraph::JumpVertical(int32 X, int32 Y, int32 DeltaY, FIntPoint& OutJumpPoint) const
+{
+	for (;;)
+	{
+		Y += DeltaY;
+
+		if (!IsWalkable(X, Y))
+		{
+			return false;
+		}
+
+		// Stop at the end, or where a side cell opens up that was blocked one step back
+		if ((X == EndCell.X && Y == EndCell.Y)
+			|| (IsWalkable(X + 1, Y) && !IsWalkable(X + 1, Y - DeltaY))
+			|| (IsWalkable(X - 1, Y) && !IsWalkable(X - 1, Y - DeltaY)))
+		{
+			OutJumpPoint = FIntPoint(X, Y);
+			return true;
+		}
+	}
+}
+
+void FJumpPointGraph::AddJump(const FIntPoint& Cell, EDirection Direction, TArray<MicroPanther::FStateCost>* AdjacentCosts) const
+{
+	FIntPoint JumpPoint;
+
+	if (Jump(Cell, Direction, JumpPoint))
+	{
+		// The end is the same state however it's entered
+		const EDirection JumpDirection = (JumpPoint == EndCell) ? None : Direction;
+		const float Cost = FMath::Abs(JumpPoint.X - Cell.X) + FMath::Abs(JumpPoint.Y - Cell.Y);
+
+		MicroPanther::FStateCost StateCost = { CellToState(JumpPoint, JumpDirection), Cost };
+		AdjacentCosts->Add(StateCost);
+	}
+}
+
+void* FJumpPointGraph::CellToState(const FIntPoint& Cell, EDirection Direction) const
+{
+	return (void*)(intptr_t)((Cell.X + (Cell.Y * Graph.GetGridCountX())) * NumDirections + Direction);
+}
+
+FIntPoint FJumpPointGraph::StateToCell(void* State) const
+{
+	const int32 Index = (int32)((intptr_t)State / NumDirections);
+
+	return FIntPoint(Index % Graph.GetGridCountX(), Index / Graph.GetGridCountX());
+}
+
+FJumpPointGraph::EDirection FJumpPointGraph::StateToDirection(void* State) const
+{
+	return (EDirection)((intptr_t)State % NumDirections);
+}
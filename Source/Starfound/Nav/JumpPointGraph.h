@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Micropather.h"
+
+class FSideScrollGraph;
+
+// Jump point search over FSideScrollGraph, for 4 connected grids (JPS4).
+// Every move costs 1, so there are many equally cheap paths between two cells. Only the ones that move
+// horizontally before vertically are searched: straight runs are jumped over, and A* only sees the cells
+// where such a path has to branch. Costs are the same as A* over every cell with an admissible heuristic.
+// void* state is defined as (cell index * NumDirections) + direction the cell was entered in.
+// Start and end cells have no direction.
+class FJumpPointGraph : public MicroPanther::FGraph
+{
+public:
+	FJumpPointGraph(const FSideScrollGraph& InGraph);
+
+	// Returns FMicroPather::SOLVED, NO_SOLUTION or START_END_SAME. OutPath holds FSideScrollGraph states of every cell.
+	int32 FindPath(const FIntPoint& Start, const FIntPoint& End, TArray<void*>& OutPath, float& OutCost);
+
+	// Jump points expanded by the last FindPath
+	int32 GetNumExpandedNodes() const { return JumpPather->GetNumExpandedNodes(); }
+
+	virtual float LeastCostEstimate(void* StartState, void* EndState) override;
+	virtual void AdjacentCost(void* State, TArray<MicroPanther::FStateCost>* AdjacentCosts) override;
+	virtual void PrintStateInfo(void* State) override;
+
+private:
+	enum EDirection
+	{
+		None,
+		Right,
+		Left,
+		Up,
+		Down,
+
+		NumDirections
+	};
+
+	bool IsWalkable(int32 X, int32 Y) const;
+
+	// Steps from Cell in Direction until the search has to branch. False if a wall comes first.
+	bool Jump(const FIntPoint& Cell, EDirection Direction, FIntPoint& OutJumpPoint) const;
+	bool JumpHorizontal(int32 X, int32 Y, int32 DeltaX, FIntPoint& OutJumpPoint) const;
+	bool JumpVertical(int32 X, int32 Y, int32 DeltaY, FIntPoint& OutJumpPoint) const;
+
+	void AddJump(const FIntPoint& Cell, EDirection Direction, TArray<MicroPanther::FStateCost>* AdjacentCosts) const;
+
+	void* CellToState(const FIntPoint& Cell, EDirection Direction) const;
+	FIntPoint StateToCell(void* State) const;
+	EDirection StateToDirection(void* State) const;
+
+	const FSideScrollGraph& Graph;
+
+	// End of the running FindPath
+	FIntPoint EndCell;
+
+	TArray<void*> JumpPath;
+	TUniquePtr<MicroPanther::FMicroPather> JumpPather;
+};
@@ -53,223 +53,607 @@ using namespace MicroPanther;
 class FOpenQueue
 {
 public:
-	FOpenQueue(FGraph* InGraph)
+	FOpenQueue(FGraph* InGraph, FPathNodePool& InPool, EOpenQueueType InType, TArray<int32>& InStorage, TArray<int32>& InUsedBuckets,
+		TArray<int32>& InOverflow)
+		: Type(InType)
+		, Pool(InPool)
+		, Storage(InStorage)
+		, UsedBuckets(InUsedBuckets)
+		, Overflow(InOverflow)
+		, NumOpen(0)
+		, MinBucket(0)
+		, BucketBase(0)
+		, NumInBuckets(0)
+	{
+		Reset(InGraph);
+	}
+
+	~FOpenQueue()
+	{
+		ClearUsedBuckets();
+	}
+
+	// Empties the queue for a new solve
+	void Reset(FGraph* InGraph)
 	{
 		Graph = InGraph;
-		SentinelPathNode = (FPathNode*)SentinelMem;
-		SentinelPathNode->InitSentinel();
-#ifdef DEBUG
-		SentinelPathNode->CheckList();
-#endif
+		SortedHead = INDEX_NONE;
+		NumOpen = 0;
+		MinBucket = 0;
+		BucketBase = 0;
+		NumInBuckets = 0;
+
+		if (Type == EOpenQueueType::BinaryHeap)
+		{
+			// Reset() keeps the allocation.
+			Storage.Reset();
+		}
+
+		Overflow.Reset();
+
+		ClearUsedBuckets();
 	}
-	~FOpenQueue() {}
 
-	void Push(FPathNode* Node);
-	FPathNode* Pop();
+	void Push(int32 Node);
+	int32 Pop();
 
-	void Update(FPathNode* Node);
+	void Update(int32 Node);
 
-	bool IsEmpty() const { return SentinelPathNode->Next == SentinelPathNode; }
+	bool IsEmpty() const
+	{
+		return NumOpen == 0;
+	}
 
 	FOpenQueue(const FOpenQueue&) = delete;
 	void operator=(const FOpenQueue&) = delete;
 
 private:
-	FPathNode* SentinelPathNode;
-	int SentinelMem[(sizeof(FPathNode) + sizeof(int)) / sizeof(int)];
+	void ClearUsedBuckets()
+	{
+		if (Type == EOpenQueueType::BucketQueue)
+		{
+			// Buckets stay allocated between solves. Only clear the ones we used, they
+			// can be far apart when the heuristic is large.
+			for (int32 Bucket : UsedBuckets)
+			{
+				Storage[Bucket] = INDEX_NONE;
+			}
+			UsedBuckets.Reset();
+		}
+	}
+
+	bool IsBefore(int32 A, int32 B) const;
+
+	void LinkAfter(int32 Node, int32 PrevNode);
+	void UnlinkSorted(int32 Node);
+
+	void PushSorted(int32 Node);
+	int32 PopSorted();
+	void UpdateSorted(int32 Node);
+
+	void HeapSiftUp(TArray<int32>& Heap, int32 Index);
+	void HeapSiftDown(TArray<int32>& Heap, int32 Index);
+	int32 HeapPop(TArray<int32>& Heap);
+
+	int32 BucketOf(int32 Node) const;
+	void LinkToBucket(int32 Node);
+	void UnlinkFromBucket(int32 Node);
+
+	EOpenQueueType Type;
+
+	FPathNodePool& Pool;
+
+	// SortedList : first node of the list
+	int32 SortedHead;
+
+	// BinaryHeap : heap ordered by TotalCost, FPathNode::QueueIndex is the position in it.
+	// BucketQueue : head of the node list of each integer cost, FPathNode::QueueIndex is the bucket.
+	TArray<int32>& Storage;
+
+	// BucketQueue : buckets that got a node during this solve
+	TArray<int32>& UsedBuckets;
+
+	// BucketQueue : heap of the nodes whose cost is outside the buckets
+	TArray<int32>& Overflow;
+
+	int32 NumOpen;
+
+	// BucketQueue : no bucket below this one has a node
+	int32 MinBucket;
+
+	// BucketQueue : integer cost of bucket 0. Moves to the next node pushed while the buckets are empty.
+	int32 BucketBase;
+	int32 NumInBuckets;
 
 	// for debugging
 	FGraph* Graph;
 };
 
-void FOpenQueue::Push(FPathNode* Node)
+// Order of the open set. Among equal total costs the node furthest from the start comes first, which walks
+// straight along one of the many equally cheap paths instead of widening over all of them.
+static FORCEINLINE bool IsOpenBefore(const FPathNode& A, const FPathNode& B)
+{
+	return (A.TotalCost < B.TotalCost) || (A.TotalCost == B.TotalCost && A.CostFromStart > B.CostFromStart);
+}
+
+FORCEINLINE bool FOpenQueue::IsBefore(int32 A, int32 B) const
+{
+	return IsOpenBefore(Pool.GetNode(A), Pool.GetNode(B));
+}
+
+void FOpenQueue::Push(int32 Node)
 {
-	MPASSERT(Node->bInOpen == 0);
-	MPASSERT(Node->bInClosed == 0);
+	FPathNode& PathNode = Pool.GetNode(Node);
+
+	MPASSERT(PathNode.bInOpen == 0);
+	MPASSERT(PathNode.bInClosed == 0);
 
 #ifdef DEBUG_PATH_DEEP
 	printf("Open Push: ");
-	Graph->PrintStateInfo(Node->State);
-	printf(" total=%.1f\n", Node->TotalCost);
+	Graph->PrintStateInfo(Pool.GetState(Node));
+	printf(" total=%.1f\n", PathNode.TotalCost);
 #endif
 
-	// Add sorted. Lowest to highest cost path. Note that the sentinel has
-	// a value of FLT_MAX, so it should always be sorted in.
-	MPASSERT(Node->TotalCost < FLT_MAX);
-	FPathNode* IterNode = SentinelPathNode->Next;
-	while (true)
+	MPASSERT(PathNode.TotalCost < FLT_MAX);
+
+	switch (Type)
 	{
-		if (Node->TotalCost < IterNode->TotalCost)
-		{
-			IterNode->AddBefore(Node);
-			Node->bInOpen = 1;
-			break;
-		}
-		IterNode = IterNode->Next;
+	case EOpenQueueType::BinaryHeap:
+		PathNode.QueueIndex = Storage.Add(Node);
+		HeapSiftUp(Storage, PathNode.QueueIndex);
+		break;
+
+	case EOpenQueueType::BucketQueue:
+		LinkToBucket(Node);
+		break;
+
+	default:
+		PushSorted(Node);
+		break;
 	}
-	MPASSERT(Node->bInOpen);	// make sure this was actually added.
-#ifdef DEBUG
-	SentinelPathNode->CheckList();
-#endif
+
+	PathNode.bInOpen = 1;
+	++NumOpen;
 }
 
-FPathNode* FOpenQueue::Pop()
+int32 FOpenQueue::Pop()
 {
-	MPASSERT(SentinelPathNode->Next != SentinelPathNode);
-	FPathNode* Node = SentinelPathNode->Next;
-	Node->Unlink();
-#ifdef DEBUG
-	SentinelPathNode->CheckList();
-#endif
+	int32 Node = INDEX_NONE;
+
+	switch (Type)
+	{
+	case EOpenQueueType::BinaryHeap:
+		Node = HeapPop(Storage);
+		break;
+
+	case EOpenQueueType::BucketQueue:
+		if (NumInBuckets > 0)
+		{
+			while (Storage[MinBucket] == INDEX_NONE)
+			{
+				++MinBucket;
+				MPASSERT(MinBucket < Storage.Num());
+			}
+		}
+
+		// The overflow goes first when its best node is cheaper than every bucket
+		if (Overflow.Num() > 0 && (NumInBuckets == 0 || Pool.GetNode(Overflow[0]).TotalCost < (float)(BucketBase + MinBucket)))
+		{
+			Node = HeapPop(Overflow);
+			Pool.GetNode(Node).bInOverflow = 0;
+		}
+		else
+		{
+			Node = Storage[MinBucket];
+			UnlinkFromBucket(Node);
+		}
+		break;
+
+	default:
+		Node = PopSorted();
+		break;
+	}
+
+	FPathNode& PathNode = Pool.GetNode(Node);
 
-	MPASSERT(Node->bInClosed == 0);
-	MPASSERT(Node->bInOpen == 1);
-	Node->bInOpen = 0;
+	MPASSERT(PathNode.bInClosed == 0);
+	MPASSERT(PathNode.bInOpen == 1);
+	PathNode.bInOpen = 0;
+	--NumOpen;
 
 #ifdef DEBUG_PATH_DEEP
 	printf("Open Pop: ");
-	Graph->PrintStateInfo(Node->State);
-	printf(" total=%.1f\n", Node->TotalCost);
+	Graph->PrintStateInfo(Pool.GetState(Node));
+	printf(" total=%.1f\n", PathNode.TotalCost);
 #endif
 
 	return Node;
 }
 
-void FOpenQueue::Update(FPathNode* Node)
+void FOpenQueue::Update(int32 Node)
 {
 #ifdef DEBUG_PATH_DEEP
 	printf( "Open Update: " );		
-	Graph->PrintStateInfo( Node->State );
-	printf( " total=%.1f\n", Node->TotalCost );		
+	Graph->PrintStateInfo( Pool.GetState(Node) );
+	printf( " total=%.1f\n", Pool.GetNode(Node).TotalCost );		
 #endif
 
-	MPASSERT(Node->bInOpen);
+	MPASSERT(Pool.GetNode(Node).bInOpen);
+
+	switch (Type)
+	{
+	case EOpenQueueType::BinaryHeap:
+		// Cost usually goes down (decrease-key), but handle both directions.
+		HeapSiftUp(Storage, Pool.GetNode(Node).QueueIndex);
+		HeapSiftDown(Storage, Pool.GetNode(Node).QueueIndex);
+		break;
+
+	case EOpenQueueType::BucketQueue:
+		if (Pool.GetNode(Node).bInOverflow)
+		{
+			// Stays in the overflow even if it now fits a bucket, Pop compares both
+			HeapSiftUp(Overflow, Pool.GetNode(Node).QueueIndex);
+			HeapSiftDown(Overflow, Pool.GetNode(Node).QueueIndex);
+		}
+		else if (BucketOf(Node) != Pool.GetNode(Node).QueueIndex)
+		{
+			UnlinkFromBucket(Node);
+			LinkToBucket(Node);
+		}
+		break;
+
+	default:
+		UpdateSorted(Node);
+		break;
+	}
+}
+
+void FOpenQueue::LinkAfter(int32 Node, int32 PrevNode)
+{
+	FPathNodeLinks& NodeLinks = Pool.GetLinks(Node);
+
+	NodeLinks.Prev = PrevNode;
+
+	if (PrevNode == INDEX_NONE)
+	{
+		NodeLinks.Next = SortedHead;
+		SortedHead = Node;
+	}
+	else
+	{
+		NodeLinks.Next = Pool.GetLinks(PrevNode).Next;
+		Pool.GetLinks(PrevNode).Next = Node;
+	}
+
+	if (NodeLinks.Next != INDEX_NONE)
+	{
+		Pool.GetLinks(NodeLinks.Next).Prev = Node;
+	}
+}
+
+void FOpenQueue::UnlinkSorted(int32 Node)
+{
+	FPathNodeLinks& NodeLinks = Pool.GetLinks(Node);
+
+	if (NodeLinks.Prev == INDEX_NONE)
+	{
+		SortedHead = NodeLinks.Next;
+	}
+	else
+	{
+		Pool.GetLinks(NodeLinks.Prev).Next = NodeLinks.Next;
+	}
+
+	if (NodeLinks.Next != INDEX_NONE)
+	{
+		Pool.GetLinks(NodeLinks.Next).Prev = NodeLinks.Prev;
+	}
 
+	NodeLinks.Next = NodeLinks.Prev = INDEX_NONE;
+}
+
+void FOpenQueue::PushSorted(int32 Node)
+{
+	// Add sorted. Lowest to highest cost path, after the nodes that are as cheap.
+	int32 PrevNode = INDEX_NONE;
+	int32 IterNode = SortedHead;
+
+	while (IterNode != INDEX_NONE && !IsBefore(Node, IterNode))
+	{
+		PrevNode = IterNode;
+		IterNode = Pool.GetLinks(IterNode).Next;
+	}
+
+	LinkAfter(Node, PrevNode);
+}
+
+int32 FOpenQueue::PopSorted()
+{
+	MPASSERT(SortedHead != INDEX_NONE);
+	const int32 Node = SortedHead;
+	UnlinkSorted(Node);
+
+	return Node;
+}
+
+void FOpenQueue::UpdateSorted(int32 Node)
+{
 	// If the node now cost less than the one before it,
 	// move it to the front of the list.
-	if (Node->Prev != SentinelPathNode && Node->TotalCost < Node->Prev->TotalCost)
+	const int32 PrevNode = Pool.GetLinks(Node).Prev;
+
+	if (PrevNode != INDEX_NONE && IsBefore(Node, PrevNode))
 	{
-		Node->Unlink();
-		SentinelPathNode->Next->AddBefore(Node);
+		UnlinkSorted(Node);
+		LinkAfter(Node, INDEX_NONE);
 	}
 
 	// If the node is too high, move to the right.
-	if (Node->TotalCost > Node->Next->TotalCost)
+	int32 IterNode = Pool.GetLinks(Node).Next;
+
+	if (IterNode != INDEX_NONE && IsBefore(IterNode, Node))
 	{
-		FPathNode* IterNode = Node->Next;
-		Node->Unlink();
+		UnlinkSorted(Node);
+
+		int32 LastNode = IterNode;
 
-		while (Node->TotalCost > IterNode->TotalCost)
+		while (IterNode != INDEX_NONE && IsBefore(IterNode, Node))
 		{
-			IterNode = IterNode->Next;
+			LastNode = IterNode;
+			IterNode = Pool.GetLinks(IterNode).Next;
 		}
 
-		IterNode->AddBefore(Node);
-#ifdef DEBUG
-		SentinelPathNode->CheckList();
-#endif
+		LinkAfter(Node, LastNode);
+	}
+}
+
+void FOpenQueue::HeapSiftUp(TArray<int32>& Heap, int32 Index)
+{
+	const int32 Node = Heap[Index];
+	const FPathNode& PathNode = Pool.GetNode(Node);
+
+	while (Index > 0)
+	{
+		const int32 ParentIndex = (Index - 1) / 2;
+		const int32 ParentNode = Heap[ParentIndex];
+
+		if (!IsOpenBefore(PathNode, Pool.GetNode(ParentNode)))
+		{
+			break;
+		}
+
+		Heap[Index] = ParentNode;
+		Pool.GetNode(ParentNode).QueueIndex = Index;
+		Index = ParentIndex;
+	}
+
+	Heap[Index] = Node;
+	Pool.GetNode(Node).QueueIndex = Index;
+}
+
+void FOpenQueue::HeapSiftDown(TArray<int32>& Heap, int32 Index)
+{
+	const int32 Node = Heap[Index];
+	const FPathNode& PathNode = Pool.GetNode(Node);
+	const int32 Num = Heap.Num();
+
+	while (true)
+	{
+		int32 ChildIndex = (Index * 2) + 1;
+		if (ChildIndex >= Num)
+		{
+			break;
+		}
+
+		if (ChildIndex + 1 < Num && IsBefore(Heap[ChildIndex + 1], Heap[ChildIndex]))
+		{
+			++ChildIndex;
+		}
+
+		const int32 ChildNode = Heap[ChildIndex];
+		if (!IsOpenBefore(Pool.GetNode(ChildNode), PathNode))
+		{
+			break;
+		}
+
+		Heap[Index] = ChildNode;
+		Pool.GetNode(ChildNode).QueueIndex = Index;
+		Index = ChildIndex;
+	}
+
+	Heap[Index] = Node;
+	Pool.GetNode(Node).QueueIndex = Index;
+}
+
+int32 FOpenQueue::HeapPop(TArray<int32>& Heap)
+{
+	MPASSERT(Heap.Num() > 0);
+	const int32 Node = Heap[0];
+
+	const int32 LastNode = Heap.Pop(false);
+	if (LastNode != Node)
+	{
+		Heap[0] = LastNode;
+		Pool.GetNode(LastNode).QueueIndex = 0;
+		HeapSiftDown(Heap, 0);
+	}
+
+	return Node;
+}
+
+// Integer costs the buckets cover. Keeps the bucket storage and the scan for the next node small however
+// large the costs get.
+static const int32 NumBucketWindow = 1024;
+
+int32 FOpenQueue::BucketOf(int32 Node) const
+{
+	// INDEX_NONE if the cost is outside the window
+	const float Cost = Pool.GetNode(Node).TotalCost - (float)BucketBase;
+
+	return (Cost >= 0.0f && Cost < NumBucketWindow) ? FMath::FloorToInt(Cost) : INDEX_NONE;
+}
+
+void FOpenQueue::LinkToBucket(int32 Node)
+{
+	FPathNode& PathNode = Pool.GetNode(Node);
+
+	// Empty buckets move to the cost of the search
+	if (NumInBuckets == 0)
+	{
+		BucketBase = FMath::FloorToInt(FMath::Min(PathNode.TotalCost, 1.0e9f));
+		MinBucket = 0;
+	}
+
+	const int32 Bucket = BucketOf(Node);
+
+	if (Bucket == INDEX_NONE)
+	{
+		PathNode.bInOverflow = 1;
+		PathNode.QueueIndex = Overflow.Add(Node);
+		HeapSiftUp(Overflow, PathNode.QueueIndex);
+		return;
+	}
+
+	if (Bucket >= Storage.Num())
+	{
+		const int32 FirstNewBucket = Storage.AddUninitialized(Bucket + 1 - Storage.Num());
+
+		for (int32 i = FirstNewBucket; i < Storage.Num(); ++i)
+		{
+			Storage[i] = INDEX_NONE;
+		}
+	}
+
+	// Inconsistent heuristics can push below the bucket we are popping from.
+	MinBucket = FMath::Min(MinBucket, Bucket);
+
+	// Push front. Bucket heads have no Prev.
+	const int32 Head = Storage[Bucket];
+	if (Head == INDEX_NONE)
+	{
+		UsedBuckets.Add(Bucket);
 	}
+
+	FPathNodeLinks& NodeLinks = Pool.GetLinks(Node);
+	NodeLinks.Prev = INDEX_NONE;
+	NodeLinks.Next = Head;
+	if (Head != INDEX_NONE)
+	{
+		Pool.GetLinks(Head).Prev = Node;
+	}
+	Storage[Bucket] = Node;
+	PathNode.QueueIndex = Bucket;
+	++NumInBuckets;
+}
+
+void FOpenQueue::UnlinkFromBucket(int32 Node)
+{
+	FPathNodeLinks& NodeLinks = Pool.GetLinks(Node);
+
+	if (NodeLinks.Prev != INDEX_NONE)
+	{
+		Pool.GetLinks(NodeLinks.Prev).Next = NodeLinks.Next;
+	}
+	else
+	{
+		Storage[Pool.GetNode(Node).QueueIndex] = NodeLinks.Next;
+	}
+
+	if (NodeLinks.Next != INDEX_NONE)
+	{
+		Pool.GetLinks(NodeLinks.Next).Prev = NodeLinks.Prev;
+	}
+
+	NodeLinks.Next = NodeLinks.Prev = INDEX_NONE;
+	--NumInBuckets;
 }
 
 
 class FClosedSet
 {
 public:
-	FClosedSet(FGraph* InGraph) { this->Graph = InGraph; }
+	FClosedSet(FGraph* InGraph, FPathNodePool& InPool) : Graph(InGraph), Pool(InPool) {}
 
 	FClosedSet(const FClosedSet&) = delete;
 	void operator=(const FClosedSet&) = delete;
 
-	void Add(FPathNode* Node)
+	void Add(int32 Node)
 	{
+		FPathNode& PathNode = Pool.GetNode(Node);
 #ifdef DEBUG_PATH_DEEP
 		printf("Closed add: ");
-		Graph->PrintStateInfo(Node->State);
-		printf(" total=%.1f\n", Node->TotalCost);
+		Graph->PrintStateInfo(Pool.GetState(Node));
+		printf(" total=%.1f\n", PathNode.TotalCost);
 #endif
 #ifdef DEBUG
-		MPASSERT(Node->bInClosed == 0);
-		MPASSERT(Node->bInOpen == 0);
+		MPASSERT(PathNode.bInClosed == 0);
+		MPASSERT(PathNode.bInOpen == 0);
 #endif
-		Node->bInClosed = 1;
+		PathNode.bInClosed = 1;
 	}
 
-	void Remove(FPathNode* Node)
+	void Remove(int32 Node)
 	{
+		FPathNode& PathNode = Pool.GetNode(Node);
 #ifdef DEBUG_PATH_DEEP
 		printf("Closed remove: ");
-		Graph->PrintStateInfo(Node->State);
-		printf(" total=%.1f\n", Node->TotalCost);
+		Graph->PrintStateInfo(Pool.GetState(Node));
+		printf(" total=%.1f\n", PathNode.TotalCost);
 #endif
-		MPASSERT(Node->bInClosed == 1);
-		MPASSERT(Node->bInOpen == 0);
+		MPASSERT(PathNode.bInClosed == 1);
+		MPASSERT(PathNode.bInOpen == 0);
 
-		Node->bInClosed = 0;
+		PathNode.bInClosed = 0;
 	}
 
 private:
 	FGraph* Graph;
+	FPathNodePool& Pool;
 };
 
 
-FPathNodePool::FPathNodePool(unsigned InNumNodesPerBlock, unsigned _typicalAdjacent)
-	: FirstBlock(0)
-	, Blocks(0)
+FPathNodePool::FPathNodePool(uint32 InNumNodesPerBlock, uint32 InNumTypicalAdjacent)
+	: NumDenseNodes(0)
 #if defined( MICROPATHER_STRESS )
 	, NumNodesPerBlock(32)
 #else
 	, NumNodesPerBlock(InNumNodesPerBlock)
 #endif
-	, NumTotalAllocatedNodes(0)
-	, NumAvailableNodesOnLastBlock(0)
+	, NumTypicalAdjacent(InNumTypicalAdjacent)
 {
-	FreeMemSentinel.InitSentinel();
-
-	NeighborCostsCapacity = NumNodesPerBlock * _typicalAdjacent;
+	NeighborCostsCapacity = NumNodesPerBlock * InNumTypicalAdjacent;
 	NeighborCostsCacheSize = 0;
 	NeighborCostsCache = (FNodeCost*)malloc(NeighborCostsCapacity * sizeof(FNodeCost));
+	NeighborCacheGeneration = 1;
 
-	// Want the behavior that if the actual number of states is specified, the cache 
-	// will be at least that big.
+	// Want the behavior that if the actual number of states is specified, the table
+	// will hold them at half load.
 	HashShift = 3;	// 8 (only useful for stress testing) 
 #if !defined( MICROPATHER_STRESS )
-	while (HashSize() < NumNodesPerBlock)
+	while (HashSize() < NumNodesPerBlock * 2)
 		++HashShift;
 #endif
-	HashTable = (FPathNode**)calloc(HashSize(), sizeof(FPathNode*));
-
-	Blocks = FirstBlock = AllocBlock();
-	NumHashCollision = 0;
-
-	//printf( "HashSize=%d allocate=%d\n", HashSize(), allocate );
+	InitialHashShift = HashShift;
+	HashTable.Init(INDEX_NONE, HashSize());
 }
 
 
 FPathNodePool::~FPathNodePool()
 {
-	Clear();
-	free(FirstBlock);
 	free(NeighborCostsCache);
-	free(HashTable);
-#ifdef TRACK_COLLISION
-	printf("Total collide=%d HashSize=%d HashShift=%d\n", NumHashCollision, HashSize(), HashShift);
-#endif
 }
 
 
-bool FPathNodePool::PushCache(const TArray<FNodeCost>& Nodes, int32* OutStartIndex)
+bool FPathNodePool::PushCache(const TArray<FNodeCost>& NodeCosts, int32* OutStartIndex)
 {
 	*OutStartIndex = -1;
 	
-	if (Nodes.Num() + NeighborCostsCacheSize <= NeighborCostsCapacity)
+	if (NodeCosts.Num() + NeighborCostsCacheSize <= NeighborCostsCapacity)
 	{
-		for (int32 i = 0; i < Nodes.Num(); ++i)
-		{
-			NeighborCostsCache[i + NeighborCostsCacheSize] = Nodes[i];
-		}
+		memcpy(&NeighborCostsCache[NeighborCostsCacheSize], NodeCosts.GetData(), sizeof(FNodeCost) * NodeCosts.Num());
 
 		*OutStartIndex = NeighborCostsCacheSize;
-		NeighborCostsCacheSize += Nodes.Num();
+		NeighborCostsCacheSize += NodeCosts.Num();
 
 		return true;
 	}
@@ -292,71 +676,49 @@ void FPathNodePool::GetCache(int32 CacheIndex, int32 NumNodeCosts, TArray<FNodeC
 
 void FPathNodePool::Clear()
 {
-#ifdef TRACK_COLLISION
-	// Collision tracking code.
-	int NumNewCollision = 0;
-	for (unsigned i = 0; i < HashSize(); ++i)
-	{
-		if (HashTable[i] && (HashTable[i]->Child[0] || HashTable[i]->Child[1]))
-		{
-			++NumNewCollision;
-		}
-	}
-	//printf( "PathNodePool %d/%d collision=%d %.1f%%\n", nAllocated, HashSize(), collide, 100.0f*(float)collide/(float)HashSize() );
-	NumHashCollision += NumNewCollision;
-#endif
+	// Hashed nodes are freed, dense ones stay allocated.
+	Nodes.SetNum(NumDenseNodes);
+	Links.SetNum(NumDenseNodes);
+	Neighbors.SetNum(NumDenseNodes);
+	HashedStates.Empty(NumNodesPerBlock);
 
-	FBlock* IterBlock = Blocks;
-	while (IterBlock)
-	{
-		FBlock* NextBlock = IterBlock->NextBlock;
-		if (IterBlock != FirstBlock)
-		{
-			free(IterBlock);
-		}
-		IterBlock = NextBlock;
-	}
+	HashShift = InitialHashShift;
+	HashTable.Init(INDEX_NONE, HashSize());
 
-	// Don't delete the first block (we always need at least that much memory.)
-	Blocks = FirstBlock;	
+	NeighborCostsCacheSize = 0;
+	NeighborCacheGeneration = 1;
 
-	// Set up for new allocations (but don't do work we don't need to. Reset/Clear can be called frequently)
-	if (NumTotalAllocatedNodes > 0)
+	// Frame restarts from 0, so old frames could look current.
+	for (int32 i = 0; i < NumDenseNodes; ++i)
 	{
-		FreeMemSentinel.Next = &FreeMemSentinel;
-		FreeMemSentinel.Prev = &FreeMemSentinel;
-
-		memset(HashTable, 0, sizeof(FPathNode*) * HashSize());
-
-		for (uint32 i = 0; i < NumNodesPerBlock; ++i)
-		{
-			FreeMemSentinel.AddBefore(&FirstBlock->PathNode[i]);
-		}
+		InitPathNode(i, 0, FLT_MAX, FLT_MAX, INDEX_NONE);
+		ForgetNeighbors(i);
 	}
-
-	NumAvailableNodesOnLastBlock = NumNodesPerBlock;
-	NumTotalAllocatedNodes = 0;
-	NeighborCostsCacheSize = 0;
 }
 
 
-FPathNodePool::FBlock* FPathNodePool::AllocBlock()
+void FPathNodePool::SetNumDenseStates(int32 NumStates)
 {
-	FBlock* NewBlock = (FBlock*) calloc(1, sizeof(FBlock) + sizeof(FPathNode)*(NumNodesPerBlock - 1));
-	NewBlock->NextBlock = 0;
-
-	NumAvailableNodesOnLastBlock += NumNodesPerBlock;
-
-	for (uint32 i = 0; i < NumNodesPerBlock; ++i)
+	if (NumStates == NumDenseNodes)
 	{
-		FreeMemSentinel.AddBefore(&NewBlock->PathNode[i]);
+		return;
 	}
 
-	return NewBlock;
+	// Hashed nodes are numbered after the dense ones
+	NumDenseNodes = FMath::Max(NumStates, 0);
+
+	Nodes.Empty(NumDenseNodes);
+	Links.Empty(NumDenseNodes);
+	Neighbors.Empty(NumDenseNodes);
+	Nodes.AddUninitialized(NumDenseNodes);
+	Links.AddUninitialized(NumDenseNodes);
+	Neighbors.AddUninitialized(NumDenseNodes);
+
+	Clear();
 }
 
 
-uint32 FPathNodePool::Hash(void* voidval)
+uint32 FPathNodePool::Hash(void* voidval) const
 {
 	/*
 		Spent quite some time on this, and the result isn't quite satifactory. The
@@ -407,176 +769,120 @@ uint32 FPathNodePool::Hash(void* voidval)
 }
 
 
-FPathNode* FPathNodePool::Alloc()
+uint32 FPathNodePool::FindHashSlot(void* State) const
 {
-	if (FreeMemSentinel.Next == &FreeMemSentinel)
-	{
-		MPASSERT(NumAvailableNodesOnLastBlock == 0);
+	uint32 Slot = Hash(State);
 
-		FBlock* NewBlock = AllocBlock();
-		NewBlock->NextBlock = Blocks;
-		Blocks = NewBlock;
-		MPASSERT(FreeMemSentinel.Next != &FreeMemSentinel);
+	while (HashTable[Slot] != INDEX_NONE && HashedStates[HashTable[Slot] - NumDenseNodes] != State)
+	{
+		Slot = (Slot + 1) & HashMask();
 	}
-	FPathNode* NewNode = FreeMemSentinel.Next;
-	NewNode->Unlink();
 
-	++NumTotalAllocatedNodes;
-	MPASSERT(NumAvailableNodesOnLastBlock > 0);
-	--NumAvailableNodesOnLastBlock;
-
-	return NewNode;
+	return Slot;
 }
 
 
-void FPathNodePool::AddPathNode(uint32 HashKey, FPathNode* RootNode)
+void FPathNodePool::GrowHashTable()
 {
-	if (HashTable[HashKey])
-	{
-		FPathNode* Node = HashTable[HashKey];
+	++HashShift;
+	HashTable.Init(INDEX_NONE, HashSize());
 
-		while (true)
-		{
-			int dir = (RootNode->State < Node->State) ? 0 : 1;
-			if (Node->Child[dir])
-			{
-				Node = Node->Child[dir];
-			}
-			else
-			{
-				Node->Child[dir] = RootNode;
-				break;
-			}
-		}
-	}
-	else
+	for (int32 i = 0; i < HashedStates.Num(); ++i)
 	{
-		HashTable[HashKey] = RootNode;
+		HashTable[FindHashSlot(HashedStates[i])] = NumDenseNodes + i;
 	}
 }
 
 
-FPathNode* FPathNodePool::FetchPathNode(void* State)
+int32 FPathNodePool::AllocNode(void* State)
 {
-	uint32 HashKey = Hash(State);
+	HashedStates.Add(State);
+	Links.AddUninitialized();
+	Neighbors.AddUninitialized();
+
+	const int32 Node = Nodes.AddUninitialized();
+	ForgetNeighbors(Node);
+
+	return Node;
+}
 
-	FPathNode* RootNode = HashTable[HashKey];
-	while (RootNode)
+
+int32 FPathNodePool::FetchPathNode(void* State) const
+{
+	if ((MP_UPTR)State < (MP_UPTR)NumDenseNodes)
 	{
-		if (RootNode->State == State)
-		{
-			break;
-		}
-		RootNode = (State < RootNode->State) ? RootNode->Child[0] : RootNode->Child[1];
+		return (int32)(MP_UPTR)State;
 	}
 
-	MPASSERT(RootNode);
+	const int32 Node = HashTable[FindHashSlot(State)];
+
+	MPASSERT(Node != INDEX_NONE);
 
-	return RootNode;
+	return Node;
 }
 
 
-FPathNode* FPathNodePool::GetPathNode(uint32 Frame, void* State, float CostFromStart, float EstToGoal, FPathNode* ParentNode)
+int32 FPathNodePool::GetPathNode(uint32 Frame, void* State, float CostFromStart, float EstToGoal, int32 Parent)
 {
-	const uint32 HashKey = Hash(State);
+	int32 Node;
 
-	FPathNode* RootNode = HashTable[HashKey];
-	while (RootNode)
+	if ((MP_UPTR)State < (MP_UPTR)NumDenseNodes)
+	{
+		Node = (int32)(MP_UPTR)State;
+	}
+	else
 	{
-		if (RootNode->State == State)
+		uint32 Slot = FindHashSlot(State);
+		Node = HashTable[Slot];
+
+		if (Node == INDEX_NONE)
 		{
-			if (RootNode->Frame == Frame)
+			// Keep the table at most half full, so probe runs stay short
+			if ((uint32)(HashedStates.Num() + 1) * 2 > HashSize())
 			{
-				// This is the correct state and correct frame.
-				break;
+				GrowHashTable();
+				Slot = FindHashSlot(State);
 			}
 
-			// Correct state, wrong frame.
-			RootNode->Init(Frame, State, CostFromStart, EstToGoal, ParentNode);
+			Node = AllocNode(State);
+			HashTable[Slot] = Node;
 
-			break;
-		}
+			InitPathNode(Node, Frame, CostFromStart, EstToGoal, Parent);
 
-		RootNode = (State < RootNode->State) ? RootNode->Child[0] : RootNode->Child[1];
+			return Node;
+		}
 	}
 
-	if (!RootNode)
+	if (Nodes[Node].Frame != Frame)
 	{
-		// allocate new one
-		RootNode = Alloc();
-		RootNode->Clear();
-		RootNode->Init(Frame, State, CostFromStart, EstToGoal, ParentNode);
-		AddPathNode(HashKey, RootNode);
+		// Correct state, wrong frame.
+		InitPathNode(Node, Frame, CostFromStart, EstToGoal, Parent);
 	}
 
-	return RootNode;
-}
-
-
-void FPathNode::Init(
-	uint32 InFrame,
-	void* InState,
-	float InCostFromStart,
-	float InEstToGoal,
-	FPathNode* InParent)
-{
-	State = InState;
-	CostFromStart = InCostFromStart;
-	EstToGoal = InEstToGoal;
-	CalcTotalCost();
-	Parent = InParent;
-	Frame = InFrame;
-	bInOpen = 0;
-	bInClosed = 0;
-}
-
-
-void FPathNode::Clear()
-{
-	memset(this, 0, sizeof(FPathNode));
-	NumAdjacent = -1;
-	CacheIndex = -1;
-	CacheFrame = 0;
-}
-
-void MicroPanther::FPathNode::InitSentinel()
-{
-	Clear();
-	Init(0, 0, FLT_MAX, FLT_MAX, 0);
-	Prev = Next = this;
+	return Node;
 }
 
-void MicroPanther::FPathNode::Unlink()
-{
-	Next->Prev = Prev;
-	Prev->Next = Next;
-	Next = Prev = 0;
-}
 
-void MicroPanther::FPathNode::AddBefore(FPathNode* Node)
+SIZE_T FPathNodePool::GetAllocatedSize() const
 {
-	Node->Next = this;
-	Node->Prev = Prev;
-	Prev->Next = Node;
-	Prev = Node;
+	return Nodes.GetAllocatedSize() + Links.GetAllocatedSize() + Neighbors.GetAllocatedSize()
+		+ HashedStates.GetAllocatedSize() + HashTable.GetAllocatedSize() + NeighborCostsCapacity * sizeof(FNodeCost);
 }
 
-void MicroPanther::FPathNode::CalcTotalCost()
-{
-	if (CostFromStart < FLT_MAX && EstToGoal < FLT_MAX)
-	{
-		TotalCost = CostFromStart + EstToGoal;
-	}
-	else
-	{
-		TotalCost = FLT_MAX;
-	}
-}
 
-FMicroPather::FMicroPather(FGraph* InGraph, uint32 NumStatesAlloc, uint32 NumTypicalAdjacent, bool bUseCache)
+FMicroPather::FMicroPather(FGraph* InGraph, uint32 NumStatesAlloc, uint32 NumTypicalAdjacent, bool bUseCache, EOpenQueueType InOpenQueueType)
 	: PathNodePool(NumStatesAlloc, NumTypicalAdjacent),
 	Graph(InGraph),
-	Frame(0)
+	Frame(0),
+	bVersionedGraph(false),
+	OpenQueueType(InOpenQueueType),
+	Open(nullptr),
+	SearchStartState(nullptr),
+	SearchFrame(0),
+	bSearchRunning(false),
+	SearchClosestNode(INDEX_NONE),
+	SearchClosestEstimate(FLT_MAX),
+	NumExpandedNodes(0)
 {
 	MPASSERT(NumStatesAlloc);
 	MPASSERT(NumTypicalAdjacent);
@@ -591,6 +897,7 @@ FMicroPather::FMicroPather(FGraph* InGraph, uint32 NumStatesAlloc, uint32 NumTyp
 
 FMicroPather::~FMicroPather()
 {
+	delete Open;
 	delete PathCache;
 }
 
@@ -602,9 +909,49 @@ void FMicroPather::Reset()
 		PathCache->Reset();
 	}
 	Frame = 0;
+	bSearchRunning = false;
+}
+
+void FMicroPather::SetGraph(FGraph* InGraph)
+{
+	if (Graph != InGraph)
+	{
+		Graph = InGraph;
+		Reset();
+	}
 }
 
-void FMicroPather::GoalReached(FPathNode* Node, void* Start, void* End, TArray<void*>* InPath)
+int FMicroPather::PartialPathReached(TArray<void*>* Path, float* TotalCost, void** OutGoalState)
+{
+	bSearchRunning = false;
+
+	const int32 EndNode = SearchClosestNode;
+
+	int32 NumNodes = 0;
+
+	for (int32 PathNodeIter = EndNode; PathNodeIter != INDEX_NONE; PathNodeIter = PathNodePool.GetNode(PathNodeIter).Parent)
+	{
+		++NumNodes;
+	}
+
+	Path->SetNum(NumNodes);
+
+	for (int32 PathNodeIter = EndNode; PathNodeIter != INDEX_NONE; PathNodeIter = PathNodePool.GetNode(PathNodeIter).Parent)
+	{
+		(*Path)[--NumNodes] = PathNodePool.GetState(PathNodeIter);
+	}
+
+	*TotalCost = PathNodePool.GetNode(EndNode).CostFromStart;
+
+	if (OutGoalState)
+	{
+		*OutGoalState = PathNodePool.GetState(EndNode);
+	}
+
+	return PARTIAL;
+}
+
+void FMicroPather::GoalReached(int32 Node, void* Start, void* End, TArray<void*>* InPath)
 {
 	TArray<void*>& Path = *InPath;
 	Path.Empty();
@@ -612,11 +959,11 @@ void FMicroPather::GoalReached(FPathNode* Node, void* Start, void* End, TArray<v
 	// We have reached the goal.
 	// How long is the path? Used to allocate the vector which is returned.
 	int NumNodes = 1;
-	FPathNode* PathNodeIter = Node;
-	while (PathNodeIter->Parent)
+	int32 PathNodeIter = Node;
+	while (PathNodePool.GetNode(PathNodeIter).Parent != INDEX_NONE)
 	{
 		++NumNodes;
-		PathNodeIter = PathNodeIter->Parent;
+		PathNodeIter = PathNodePool.GetNode(PathNodeIter).Parent;
 	}
 
 	// Now that the path has a known length, allocate
@@ -635,12 +982,12 @@ void FMicroPather::GoalReached(FPathNode* Node, void* Start, void* End, TArray<v
 		Path[0] = Start;
 		Path[NumNodes - 1] = End;
 		NumNodes -= 2;
-		PathNodeIter = Node->Parent;
+		PathNodeIter = PathNodePool.GetNode(Node).Parent;
 
-		while (PathNodeIter->Parent)
+		while (PathNodePool.GetNode(PathNodeIter).Parent != INDEX_NONE)
 		{
-			Path[NumNodes] = PathNodeIter->State;
-			PathNodeIter = PathNodeIter->Parent;
+			Path[NumNodes] = PathNodePool.GetState(PathNodeIter);
+			PathNodeIter = PathNodePool.GetNode(PathNodeIter).Parent;
 			--NumNodes;
 		}
 
@@ -651,8 +998,8 @@ void FMicroPather::GoalReached(FPathNode* Node, void* Start, void* End, TArray<v
 	{
 		TempCosts.Empty();
 
-		FPathNode* PathNode0 = PathNodePool.FetchPathNode(Path[0]);
-		FPathNode* PathNode1 = nullptr;
+		int32 PathNode0 = PathNodePool.FetchPathNode(Path[0]);
+		int32 PathNode1 = INDEX_NONE;
 
 		for (int32 i = 0; i < Path.Num() - 1; ++i)
 		{
@@ -673,7 +1020,7 @@ void FMicroPather::GoalReached(FPathNode* Node, void* Start, void* End, TArray<v
 			MPASSERT(TempCosts.Num() == i + 1);
 			PathNode0 = PathNode1;
 		}
-		PathCache->Add(Path, TempCosts);
+		PathCache->Add(Path, TempCosts, Graph);
 	}
 
 #ifdef DEBUG_PATH
@@ -694,23 +1041,33 @@ void FMicroPather::GoalReached(FPathNode* Node, void* Start, void* End, TArray<v
 #endif
 	}
 #ifdef DEBUG_PATH
-	printf("Cost=%.1f Checksum %d\n", Node->CostFromStart, checksum);
+	printf("Cost=%.1f Checksum %d\n", PathNodePool.GetNode(Node).CostFromStart, checksum);
 #endif
 }
 
-void FMicroPather::GetNodeNeighbors(FPathNode* Node, TArray<FNodeCost>* OutNodeCosts)
+void FMicroPather::GetNodeNeighbors(int32 Node, TArray<FNodeCost>* OutNodeCosts)
 {
-	if (Node->NumAdjacent == 0)
+	// Neighbors can change between solves. Without graph versions the neighbor cache is cleared
+	// every frame, so what we learn here is only good for this frame. With them it is good until
+	// the state changes.
+	const FPathNodeNeighbors& NodeNeighbors = PathNodePool.GetNeighbors(Node);
+
+	const bool bKnown = NodeNeighbors.CacheGeneration == PathNodePool.GetNeighborCacheGeneration()
+		&& (!bVersionedGraph || Graph->GetStateVersion(PathNodePool.GetState(Node)) <= NodeNeighbors.Version);
+
+	if (bKnown && NodeNeighbors.NumAdjacent == 0)
 	{
 		// it has no neighbors.
 		OutNodeCosts->SetNum(0);
 	}
-	else if (Node->CacheIndex < 0 || Node->CacheFrame != Frame)
+	else if (!bKnown || NodeNeighbors.CacheIndex < 0)
 	{
-		// Not in the cache. Either the first time or just didn't fit. We don't know
+		// Not in the cache. Either the first time, changed or just didn't fit. We don't know
 		// the number of neighbors and need to call back to the client.
+		void* State = PathNodePool.GetState(Node);
+
 		TempStateCosts.SetNum(0);
-		Graph->AdjacentCost(Node->State, &TempStateCosts);
+		Graph->AdjacentCost(State, &TempStateCosts);
 
 #ifdef UE_BUILD_DEBUG
 		{
@@ -719,46 +1076,47 @@ void FMicroPather::GetNodeNeighbors(FPathNode* Node, TArray<FNodeCost>* OutNodeC
 			// bad things will happen.
 			for (int32 i = 0; i < TempStateCosts.Num(); ++i)
 			{
-				MPASSERT(TempStateCosts[i].State != Node->State);
+				MPASSERT(TempStateCosts[i].State != State);
 			}
 		}
 #endif
 
-		OutNodeCosts->SetNum(TempStateCosts.Num());
-		Node->NumAdjacent = TempStateCosts.Num();
+		const int32 NumAdjacent = TempStateCosts.Num();
+		OutNodeCosts->SetNum(NumAdjacent);
 
-		if (Node->NumAdjacent > 0)
+		if (NumAdjacent > 0)
 		{
-			// Now convert to pathNodes.
-			for (int32 i = 0; i < TempStateCosts.Num(); ++i)
+			// Now convert to pathNodes. This can add nodes, which moves the node arrays.
+			for (int32 i = 0; i < NumAdjacent; ++i)
 			{
 				OutNodeCosts->GetData()[i].Cost = TempStateCosts[i].Cost;
-				OutNodeCosts->GetData()[i].Node = PathNodePool.GetPathNode(Frame, TempStateCosts[i].State, FLT_MAX, FLT_MAX, 0);
+				OutNodeCosts->GetData()[i].Node = PathNodePool.GetPathNode(Frame, TempStateCosts[i].State, FLT_MAX, FLT_MAX, INDEX_NONE);
 			}
+		}
 
-			// Can this be cached?
-			int CacheIndex = 0;
-			if (OutNodeCosts->Num() > 0 && PathNodePool.PushCache(*OutNodeCosts, &CacheIndex))
-			{
-				Node->CacheIndex = CacheIndex;
-			}
+		FPathNodeNeighbors& NewNodeNeighbors = PathNodePool.GetNeighbors(Node);
+		NewNodeNeighbors.NumAdjacent = NumAdjacent;
+		NewNodeNeighbors.CacheIndex = -1;
+		NewNodeNeighbors.CacheGeneration = PathNodePool.GetNeighborCacheGeneration();
+		NewNodeNeighbors.Version = bVersionedGraph ? Graph->GetGraphVersion() : 0;
+
+		// Can this be cached?
+		int CacheIndex = 0;
+		if (NumAdjacent > 0 && PathNodePool.PushCache(*OutNodeCosts, &CacheIndex))
+		{
+			NewNodeNeighbors.CacheIndex = CacheIndex;
 		}
 	}
 	else
 	{
 		// In the cache!
-		OutNodeCosts->SetNum(Node->NumAdjacent);
-		PathNodePool.GetCache(Node->CacheIndex, Node->NumAdjacent, *OutNodeCosts);
+		PathNodePool.GetCache(NodeNeighbors.CacheIndex, NodeNeighbors.NumAdjacent, *OutNodeCosts);
 
 		// A node is uninitialized (even if memory is allocated) if it is from a previous frame.
 		// Check for that, and Init() as necessary.
-		for (int i = 0; i < Node->NumAdjacent; ++i)
+		for (int32 i = 0; i < OutNodeCosts->Num(); ++i)
 		{
-			FPathNode* AdjacentNode = OutNodeCosts->GetData()[i].Node;
-			if (AdjacentNode->Frame != Frame)
-			{
-				AdjacentNode->Init(Frame, AdjacentNode->State, FLT_MAX, FLT_MAX, 0);
-			}
+			PathNodePool.RefreshPathNode(OutNodeCosts->GetData()[i].Node, Frame);
 		}
 	}
 }
@@ -792,19 +1150,44 @@ void FMicroPather::Debug_StatesInPool(TArray<void*>* stateVec)
 
 void FPathNodePool::AllStates(uint32 frame, TArray<void*>* stateVec)
 {	
-    for ( FBlock* b=Blocks; b; b=b->NextBlock )
-    {
-    	for( unsigned i=0; i<NumNodesPerBlock; ++i )
-    	{
-    	    if ( b->PathNode[i].Frame == frame )
-	    	    stateVec->Add( b->PathNode[i].State );
-    	}    
-	}           
-}   
+	for (int32 i = 0; i < Nodes.Num(); ++i)
+	{
+		if (Nodes[i].Frame == frame)
+		{
+			stateVec->Add(GetState(i));
+		}
+	}
+}
 
 void MicroPanther::FPathNodePool::ClearNeighborCache()
 {
 	NeighborCostsCacheSize = 0;
+
+	if (++NeighborCacheGeneration == 0)
+	{
+		// Wrapped around. Old generations could look current.
+		for (int32 i = 0; i < Neighbors.Num(); ++i)
+		{
+			ForgetNeighbors(i);
+		}
+
+		NeighborCacheGeneration = 1;
+	}
+}
+
+void MicroPanther::FPathNodePool::ReserveNeighborCache(int32 NumNodes)
+{
+	const int32 NumNodeCosts = NumNodes * NumTypicalAdjacent;
+
+	if (NumNodeCosts > NeighborCostsCapacity)
+	{
+		free(NeighborCostsCache);
+
+		NeighborCostsCapacity = NumNodeCosts;
+		NeighborCostsCache = (FNodeCost*)malloc(NeighborCostsCapacity * sizeof(FNodeCost));
+
+		ClearNeighborCache();
+	}
 }
 
 FPathCache::FPathCache(int NumItemsToAllocate)
@@ -833,13 +1216,22 @@ void FPathCache::Reset()
 	}
 }
 
-void FPathCache::Add(const TArray< void* >& Path, const TArray< float >& Costs)
+void FPathCache::Add(const TArray< void* >& Path, const TArray< float >& Costs, const FGraph* Graph)
 {
+	const bool bVersioned = Graph->HasStateVersions();
+
 	if (NumItems + Path.Num() > NumItemsAllocated * 3 / 4)
 	{
-		return;
+		if (!bVersioned || Path.Num() > NumItemsAllocated * 3 / 4)
+		{
+			return;
+		}
+
+		Reset();
 	}
 
+	const uint32 Version = bVersioned ? Graph->GetGraphVersion() : 0;
+
 	for (int32 i = 0; i < Path.Num() - 1; ++i)
 	{
 		// example: a->b->c->d
@@ -853,18 +1245,28 @@ void FPathCache::Add(const TArray< void* >& Path, const TArray< float >& Costs)
 		item.End = Path[Path.Num() - 1];
 		item.Next = Path[i + 1];
 		item.Cost = Costs[i];
+		item.Version = Version;
 
 		AddItem(item);
 	}
 }
 
-void FPathCache::AddNoSolution(void* End, void* States[], int Count)
+void FPathCache::AddNoSolution(void* End, void* States[], int Count, const FGraph* Graph)
 {
+	const bool bVersioned = Graph->HasStateVersions();
+
 	if (Count + NumItems > NumItemsAllocated * 3 / 4)
 	{
-		return;
+		if (!bVersioned || Count > NumItemsAllocated * 3 / 4)
+		{
+			return;
+		}
+
+		Reset();
 	}
 
+	const uint32 Version = bVersioned ? Graph->GetGraphVersion() : 0;
+
 	for (int i = 0; i < Count; ++i)
 	{
 		FItem item;
@@ -872,35 +1274,57 @@ void FPathCache::AddNoSolution(void* End, void* States[], int Count)
 		item.End = End;
 		item.Next = 0;
 		item.Cost = FLT_MAX;
+		item.Version = Version;
 
 		AddItem(item);
 	}
 }
 
-int FPathCache::Solve(void* Start, void* End, TArray<void*>* Path, float* TotalCosts)
+int FPathCache::Solve(void* Start, void* End, TArray<void*>* Path, float* TotalCosts, const FGraph* Graph)
 {
+	const bool bVersioned = Graph->HasStateVersions();
+
 	const FItem* Item = Find(Start, End);
 
 	if (Item)
 	{
 		if (Item->Cost == FLT_MAX)
 		{
-			++NumHit;
-			return FMicroPather::NO_SOLUTION;
+			// Any change could have connected them
+			if (!bVersioned || Item->Version >= Graph->GetGraphVersion())
+			{
+				++NumHit;
+				return FMicroPather::NO_SOLUTION;
+			}
 		}
+		else
+		{
+			Path->Empty();
+			Path->Add(Start);
+			*TotalCosts = 0;
 
-		Path->Empty();
-		Path->Add(Start);
-		*TotalCosts = 0;
+			for (; Start != End; Start = Item->Next, Item = Find(Start, End))
+			{
+				// The cost of a step only depends on where it leaves from
+				if (!Item || (bVersioned && Graph->GetStateVersion(Item->Start) > Item->Version))
+				{
+					MPASSERT(Item);
+					break;
+				}
 
-		for (; Start != End; Start = Item->Next, Item = Find(Start, End))
-		{
-			MPASSERT(Item);
-			*TotalCosts += Item->Cost;
-			Path->Add(Item->Next);
+				*TotalCosts += Item->Cost;
+				Path->Add(Item->Next);
+			}
+
+			if (Start == End)
+			{
+				++NumHit;
+				return FMicroPather::SOLVED;
+			}
+
+			Path->Empty();
+			*TotalCosts = 0;
 		}
-		++NumHit;
-		return FMicroPather::SOLVED;
 	}
 
 	++NumMiss;
@@ -928,8 +1352,16 @@ void FPathCache::AddItem(const FItem& Item)
 		}
 		else if (Items[Index].KeyEqual(Item))
 		{
-			MPASSERT((Items[Index].Next && Item.Next) || (Items[Index].Next == 0 && Item.Next == 0));
-			// do nothing; in cache
+			// Only a graph with versions finds something else for the same key, after a change
+			if (Item.Version > Items[Index].Version)
+			{
+				Items[Index] = Item;
+			}
+			else
+			{
+				MPASSERT((Items[Index].Next && Item.Next) || (Items[Index].Next == 0 && Item.Next == 0));
+				// do nothing; in cache
+			}
 			break;
 		}
 
@@ -1009,6 +1441,7 @@ int FMicroPather::Solve(void* StartState, void* EndState, TArray<void*>* Path, f
 #endif
 
 	*TotalCost = 0.0f;
+	NumExpandedNodes = 0;
 
 	if (StartState == EndState)
 	{
@@ -1017,7 +1450,7 @@ int FMicroPather::Solve(void* StartState, void* EndState, TArray<void*>* Path, f
 
 	if (PathCache)
 	{
-		const int CacheResult = PathCache->Solve(StartState, EndState, Path, TotalCost);
+		const int CacheResult = PathCache->Solve(StartState, EndState, Path, TotalCost, Graph);
 
 		if (CacheResult == SOLVED || CacheResult == NO_SOLUTION)
 		{
@@ -1031,31 +1464,219 @@ int FMicroPather::Solve(void* StartState, void* EndState, TArray<void*>* Path, f
 #endif
 	}
 
+	const int Result = SolveInternal(StartState, &EndState, 1, Path, TotalCost, nullptr);
+
+	if (Result == NO_SOLUTION && PathCache)
+	{
+		// Could add a bunch more with a little tracking.
+		PathCache->AddNoSolution(EndState, &StartState, 1, Graph);
+	}
+
+	return Result;
+}
+
+int FMicroPather::SolveForAnyGoal(void* StartState, const TArray<void*>& GoalStates, TArray<void*>* Path, float* TotalCost, void** OutGoalState)
+{
+	Path->Empty();
+	*TotalCost = 0.0f;
+	*OutGoalState = nullptr;
+
+	if (GoalStates.Num() == 0)
+	{
+		return NO_SOLUTION;
+	}
+
+	if (GoalStates.Contains(StartState))
+	{
+		*OutGoalState = StartState;
+		return START_END_SAME;
+	}
+
+	if (GoalStates.Num() == 1)
+	{
+		*OutGoalState = GoalStates[0];
+		return Solve(StartState, GoalStates[0], Path, TotalCost);
+	}
+
+	return SolveInternal(StartState, GoalStates.GetData(), GoalStates.Num(), Path, TotalCost, OutGoalState);
+}
+
+float FMicroPather::LeastCostEstimateToGoals(void* State, void* const* GoalStates, int32 NumGoals)
+{
+	float MinCost = Graph->LeastCostEstimate(State, GoalStates[0]);
+
+	for (int32 i = 1; i < NumGoals; ++i)
+	{
+		MinCost = FMath::Min(MinCost, Graph->LeastCostEstimate(State, GoalStates[i]));
+	}
+
+	return MinCost;
+}
+
+int FMicroPather::BeginSolve(void* StartState, void* EndState)
+{
+	if (StartState == EndState)
+	{
+		CancelSolve();
+		return START_END_SAME;
+	}
+
+	BeginSearch(StartState, &EndState, 1);
+
+	return SOLVING;
+}
+
+int FMicroPather::BeginSolveForAnyGoal(void* StartState, const TArray<void*>& GoalStates)
+{
+	if (GoalStates.Num() == 0)
+	{
+		CancelSolve();
+		return NO_SOLUTION;
+	}
+
+	if (GoalStates.Contains(StartState))
+	{
+		CancelSolve();
+		return START_END_SAME;
+	}
+
+	BeginSearch(StartState, GoalStates.GetData(), GoalStates.Num());
+
+	return SOLVING;
+}
+
+int FMicroPather::StepSolve(int32 MaxExpansions, TArray<void*>* Path, float* TotalCost, void** OutGoalState)
+{
+	Path->Empty();
+	*TotalCost = 0.0f;
+
+	if (OutGoalState)
+	{
+		*OutGoalState = nullptr;
+	}
+
+	// Any other solve since BeginSolve reused the nodes of the search
+	if (!MPASSERT(bSearchRunning && SearchFrame == Frame))
+	{
+		bSearchRunning = false;
+		return NO_SOLUTION;
+	}
+
+	return StepSearch(MaxExpansions, Path, TotalCost, OutGoalState);
+}
+
+void FMicroPather::CancelSolve()
+{
+	bSearchRunning = false;
+}
+
+int FMicroPather::SolveInternal(void* StartState, void* const* GoalStates, int32 NumGoals, TArray<void*>* Path, float* TotalCost, void** OutGoalState)
+{
+	BeginSearch(StartState, GoalStates, NumGoals);
+
+	return StepSearch(MAX_int32, Path, TotalCost, OutGoalState);
+}
+
+void FMicroPather::BeginSearch(void* StartState, void* const* GoalStates, int32 NumGoals)
+{
+	PathNodePool.SetNumDenseStates(Graph->GetNumStates());
+
 	IncreaseFrame();
 
-	FOpenQueue Open(Graph);
-	FClosedSet Closed(Graph);
+	if (!Open)
+	{
+		Open = new FOpenQueue(Graph, PathNodePool, OpenQueueType, OpenQueueStorage, OpenQueueUsedBuckets, OpenQueueOverflow);
+	}
+	else
+	{
+		Open->Reset(Graph);
+	}
+
+	SearchStartState = StartState;
+	SearchGoalStates.Reset();
+	SearchGoalStates.Append(GoalStates, NumGoals);
+	SearchFrame = Frame;
+	bSearchRunning = true;
+
+	RunningSearchLimits = SearchLimits;
 
-	FPathNode* NewPathNode = PathNodePool.GetPathNode(
+	const int32 NewPathNode = PathNodePool.GetPathNode(
 		Frame,
 		StartState,
 		0,
-		Graph->LeastCostEstimate(StartState, EndState),
-		0);
+		LeastCostEstimateToGoals(StartState, GoalStates, NumGoals),
+		INDEX_NONE);
 
-	Open.Push(NewPathNode);
+	Open->Push(NewPathNode);
+
+	SearchClosestNode = NewPathNode;
+	SearchClosestEstimate = FLT_MAX;
 
 	TempStateCosts.Empty();
 	TempNodeCosts.Empty(0);
 
-	while (!Open.IsEmpty())
+	NumExpandedNodes = 0;
+}
+
+int FMicroPather::StepSearch(int32 MaxExpansions, TArray<void*>* Path, float* TotalCost, void** OutGoalState)
+{
+	FClosedSet Closed(Graph, PathNodePool);
+
+	void* const* GoalStates = SearchGoalStates.GetData();
+	const int32 NumGoals = SearchGoalStates.Num();
+
+	int32 NumStepExpansions = 0;
+
+	while (!Open->IsEmpty())
 	{
-		FPathNode* Node = Open.Pop();
-		
-		if (Node->State == EndState)
+		if (NumStepExpansions == MaxExpansions)
+		{
+			return SOLVING;
+		}
+
+		if (RunningSearchLimits.MaxExpansions > 0 && NumExpandedNodes >= RunningSearchLimits.MaxExpansions)
+		{
+			return PartialPathReached(Path, TotalCost, OutGoalState);
+		}
+
+		const int32 Node = Open->Pop();
+		const FPathNode& PathNode = PathNodePool.GetNode(Node);
+
+		// The open set is ordered by total cost, so no path left is cheap enough
+		if (RunningSearchLimits.MaxCost > 0 && PathNode.TotalCost > RunningSearchLimits.MaxCost)
+		{
+			return PartialPathReached(Path, TotalCost, OutGoalState);
+		}
+
+		const float EstimateToGoals = PathNode.TotalCost - PathNode.CostFromStart;
+
+		if (EstimateToGoals < SearchClosestEstimate)
+		{
+			SearchClosestNode = Node;
+			SearchClosestEstimate = EstimateToGoals;
+		}
+
+		void* NodeState = PathNodePool.GetState(Node);
+		++NumExpandedNodes;
+		++NumStepExpansions;
+
+		int32 GoalIndex = 0;
+		while (GoalIndex < NumGoals && NodeState != GoalStates[GoalIndex])
+		{
+			++GoalIndex;
+		}
+
+		if (GoalIndex < NumGoals)
 		{
-			GoalReached(Node, StartState, EndState, Path);
-			*TotalCost = Node->CostFromStart;
+			bSearchRunning = false;
+
+			GoalReached(Node, SearchStartState, NodeState, Path);
+			*TotalCost = PathNodePool.GetNode(Node).CostFromStart;
+
+			if (OutGoalState)
+			{
+				*OutGoalState = NodeState;
+			}
 
 #ifdef DEBUG_PATH
 			DumpStats();
@@ -1069,7 +1690,10 @@ int FMicroPather::Solve(void* StartState, void* EndState, TArray<void*>* Path, f
 			// We have not reached the goal - add the neighbors.
 			GetNodeNeighbors(Node, &TempNodeCosts);
 
-			for (int i = 0; i < Node->NumAdjacent; ++i)
+			// Neighbors are all in the pool now, so node references stay valid in this loop
+			const float NodeCostFromStart = PathNodePool.GetNode(Node).CostFromStart;
+
+			for (int32 i = 0; i < TempNodeCosts.Num(); ++i)
 			{
 				// Not actually a neighbor, but useful. Filter out infinite cost.
 				if (TempNodeCosts[i].Cost == FLT_MAX)
@@ -1077,39 +1701,34 @@ int FMicroPather::Solve(void* StartState, void* EndState, TArray<void*>* Path, f
 					continue;
 				}
 
-				FPathNode* ChildNode = TempNodeCosts[i].Node;
-				FPathNode* inOpen   = ChildNode->bInOpen ? ChildNode : 0;
-				FPathNode* inClosed = ChildNode->bInClosed ? ChildNode : 0;
-				FPathNode* inEither = (FPathNode*)(((MP_UPTR)inOpen) | ((MP_UPTR)inClosed));
+				const int32 ChildNode = TempNodeCosts[i].Node;
+				FPathNode& ChildPathNode = PathNodePool.GetNode(ChildNode);
+				const bool bInOpen = ChildPathNode.bInOpen;
+				const bool bInClosed = ChildPathNode.bInClosed;
 
-				const float NewCost = Node->CostFromStart + TempNodeCosts[i].Cost;
+				const float NewCost = NodeCostFromStart + TempNodeCosts[i].Cost;
 
-				MPASSERT(inEither != Node);
-				MPASSERT(!(inOpen && inClosed));
+				MPASSERT(ChildNode != Node);
+				MPASSERT(!(bInOpen && bInClosed));
 
-				if (inEither)
+				if (bInOpen || bInClosed)
 				{
-					if (NewCost < ChildNode->CostFromStart)
+					if (NewCost < ChildPathNode.CostFromStart)
 					{
-						ChildNode->Parent = Node;
-						ChildNode->CostFromStart = NewCost;
-						ChildNode->EstToGoal = Graph->LeastCostEstimate(ChildNode->State, EndState);
-						ChildNode->CalcTotalCost();
-						if (inOpen)
+						ChildPathNode.Parent = Node;
+						ChildPathNode.SetCost(NewCost, LeastCostEstimateToGoals(PathNodePool.GetState(ChildNode), GoalStates, NumGoals));
+						if (bInOpen)
 						{
-							Open.Update(ChildNode);
+							Open->Update(ChildNode);
 						}
 					}
 				}
 				else
 				{
-					ChildNode->Parent = Node;
-					ChildNode->CostFromStart = NewCost;
-					ChildNode->EstToGoal = Graph->LeastCostEstimate(ChildNode->State, EndState),
-						ChildNode->CalcTotalCost();
+					ChildPathNode.Parent = Node;
+					ChildPathNode.SetCost(NewCost, LeastCostEstimateToGoals(PathNodePool.GetState(ChildNode), GoalStates, NumGoals));
 
-					MPASSERT(!ChildNode->bInOpen && !ChildNode->bInClosed);
-					Open.Push(ChildNode);
+					Open->Push(ChildNode);
 				}
 			}
 		}					
@@ -1117,12 +1736,8 @@ int FMicroPather::Solve(void* StartState, void* EndState, TArray<void*>* Path, f
 #ifdef DEBUG_PATH
 	DumpStats();
 #endif
-	
-	if (PathCache)
-	{
-		// Could add a bunch more with a little tracking.
-		PathCache->AddNoSolution(EndState, &StartState, 1);
-	}
+
+	bSearchRunning = false;
 
 	return NO_SOLUTION;
 }	
@@ -1152,58 +1767,59 @@ int FMicroPather::SolveForNearStates( void* startState, TArray< FStateCost >* ne
 		17      return dist[]
 	*/
 
+	PathNodePool.SetNumDenseStates( Graph->GetNumStates() );
+
 	++Frame;
 
-	FOpenQueue open( Graph );			// nodes to look at
-	FClosedSet closed( Graph );
+	FOpenQueue open( Graph, PathNodePool, OpenQueueType, OpenQueueStorage, OpenQueueUsedBuckets, OpenQueueOverflow );			// nodes to look at
+	FClosedSet closed( Graph, PathNodePool );
 
 	TempNodeCosts.Empty();
 	TempStateCosts.Empty();
 
-	FPathNode closedSentinel;
-	closedSentinel.Clear();
-	closedSentinel.Init( Frame, 0, FLT_MAX, FLT_MAX, 0 );
-	closedSentinel.Next = closedSentinel.Prev = &closedSentinel;
+	// Every node that got closed, in order
+	TArray<int32> closedNodes;
 
-	FPathNode* newPathNode = PathNodePool.GetPathNode( Frame, startState, 0, 0, 0 );
+	const int32 newPathNode = PathNodePool.GetPathNode( Frame, startState, 0, 0, INDEX_NONE );
 	open.Push( newPathNode );
 	
 	while ( !open.IsEmpty() )
 	{
-		FPathNode* node = open.Pop();	// smallest dist
+		const int32 node = open.Pop();	// smallest dist
 		closed.Add( node );				// add to the things we've looked at
-		closedSentinel.AddBefore( node );
+		closedNodes.Add( node );
 			
-		if ( node->TotalCost > maxCost )
+		if ( PathNodePool.GetNode( node ).TotalCost > maxCost )
 			continue;		// Too far away to ever get here.
 
 		GetNodeNeighbors( node, &TempNodeCosts );
 
-		for( int i=0; i<node->NumAdjacent; ++i )
+		const float nodeCostFromStart = PathNodePool.GetNode( node ).CostFromStart;
+
+		for( int32 i=0; i<TempNodeCosts.Num(); ++i )
 		{
-			MPASSERT( node->CostFromStart < FLT_MAX );
-			float newCost = node->CostFromStart + TempNodeCosts[i].Cost;
+			MPASSERT( nodeCostFromStart < FLT_MAX );
+			float newCost = nodeCostFromStart + TempNodeCosts[i].Cost;
+
+			const int32 child = TempNodeCosts[i].Node;
+			FPathNode& childPathNode = PathNodePool.GetNode( child );
 
-			FPathNode* inOpen   = TempNodeCosts[i].Node->bInOpen ? TempNodeCosts[i].Node : 0;
-			FPathNode* inClosed = TempNodeCosts[i].Node->bInClosed ? TempNodeCosts[i].Node : 0;
+			const bool inOpen = childPathNode.bInOpen;
+			const bool inClosed = childPathNode.bInClosed;
 			MPASSERT( !( inOpen && inClosed ) );
-			FPathNode* inEither = inOpen ? inOpen : inClosed;
-			MPASSERT( inEither != node );
+			MPASSERT( child != node );
 
-			if ( inEither && inEither->CostFromStart <= newCost ) {
+			if ( ( inOpen || inClosed ) && childPathNode.CostFromStart <= newCost ) {
 				continue;	// Do nothing. This path is not better than existing.
 			}
 			// Groovy. We have new information or improved information.
-			FPathNode* child = TempNodeCosts[i].Node;
-			MPASSERT( child->State != newPathNode->State );	// should never re-process the parent.
+			MPASSERT( child != newPathNode );	// should never re-process the parent.
 
-			child->Parent = node;
-			child->CostFromStart = newCost;
-			child->EstToGoal = 0;
-			child->TotalCost = child->CostFromStart;
+			childPathNode.Parent = node;
+			childPathNode.SetCost( newCost, 0 );
 
 			if ( inOpen ) {
-				open.Update( inOpen );
+				open.Update( child );
 			}
 			else if ( !inClosed ) {
 				open.Push( child );
@@ -1212,11 +1828,12 @@ int FMicroPather::SolveForNearStates( void* startState, TArray< FStateCost >* ne
 	}	
 	near->Empty();
 
-	for( FPathNode* pNode=closedSentinel.Next; pNode != &closedSentinel; pNode=pNode->Next ) {
-		if ( pNode->TotalCost <= maxCost ) {
+	for( int32 closedNode : closedNodes ) {
+		const FPathNode& pNode = PathNodePool.GetNode( closedNode );
+		if ( pNode.TotalCost <= maxCost ) {
 			FStateCost sc;
-			sc.Cost = pNode->TotalCost;
-			sc.State = pNode->State;
+			sc.Cost = pNode.TotalCost;
+			sc.State = PathNodePool.GetState( closedNode );
 
 			near->Add( sc );
 		}
@@ -1236,7 +1853,22 @@ void MicroPanther::FMicroPather::IncreaseFrame()
 {
 	++Frame;
 
-	PathNodePool.ClearNeighborCache();
+	bVersionedGraph = Graph->HasStateVersions();
+
+	if (bVersionedGraph)
+	{
+		// Neighbors stay good across solves, until their state changes. Room for all of a dense graph.
+		PathNodePool.ReserveNeighborCache(Graph->GetNumStates());
+
+		if (PathNodePool.IsNeighborCacheMostlyFull())
+		{
+			PathNodePool.ClearNeighborCache();
+		}
+	}
+	else
+	{
+		PathNodePool.ClearNeighborCache();
+	}
 }
 
 
@@ -62,6 +62,9 @@ Modified to fit in Unreal Engine4 by hck509@gmail.com
 	typedef unsigned MP_UPTR;
 #endif
 
+// Open set of a solve, defined in Micropather.cpp
+class FOpenQueue;
+
 namespace MicroPanther
 {
 	/**
@@ -76,6 +79,31 @@ namespace MicroPanther
 		float Cost;				///< The cost to the state. Use FLT_MAX for infinite cost.
 	};
 
+	/**
+		Caps on the work of a solve. A search stopped by a cap returns PARTIAL, with the path to
+		the explored state closest to the goals by LeastCostEstimate(), so the caller can still
+		make progress toward a goal that is too far away to solve for.
+	*/
+	struct FSearchLimits
+	{
+		int32 MaxExpansions;	///< The most nodes a solve expands, over all its steps. 0 for no limit.
+		float MaxCost;			///< The search stops once every path left to try costs more. 0 for no limit.
+
+		FSearchLimits()
+			: MaxExpansions(0)
+			, MaxCost(0)
+		{
+		}
+
+		FSearchLimits(int32 InMaxExpansions, float InMaxCost)
+			: MaxExpansions(InMaxExpansions)
+			, MaxCost(InMaxCost)
+		{
+		}
+
+		bool IsLimited() const { return MaxExpansions > 0 || MaxCost > 0; }
+	};
+
 
 	/**
 		A pure abstract class used to define a set of callbacks. 
@@ -112,6 +140,34 @@ namespace MicroPanther
 		*/	
 		virtual void AdjacentCost(void* State, TArray< MicroPanther::FStateCost >* Adjacent) = 0;
 
+		/**
+			If every state is an integer in [0, GetNumStates()) cast to void*, return the number
+			of states. MicroPather then keeps one path node per state in a flat array and addresses
+			it directly, instead of hashing the state. Return 0 (the default) for any other states.
+		*/
+		virtual int32 GetNumStates() const { return 0; }
+
+		/**
+			Return true if the graph stamps its states with versions. MicroPather then keeps neighbors
+			and cached paths across solves, and drops only the ones whose states changed, instead of
+			needing Reset() after every change. Without versions (the default) neighbors are only kept
+			for one solve.
+		*/
+		virtual bool HasStateVersions() const { return false; }
+
+		/**
+			Version of the whole graph. Must grow with every change, and be at least the version of
+			every state.
+		*/
+		virtual uint32 GetGraphVersion() const { return 0; }
+
+		/**
+			Version of a state. Must be raised to the new graph version whenever AdjacentCost() of
+			the state could return something else. Several states may share one version, such as
+			the states of a map region.
+		*/
+		virtual uint32 GetStateVersion(void* State) const { return 0; }
+
 		/**
 			This function is only used in DEBUG mode - it dumps output to stdout. Since void* 
 			aren't really human readable, normally you print out some concise info (like "(1,2)") 
@@ -121,68 +177,78 @@ namespace MicroPanther
 	};
 
 
-	class FPathNode;
-
-	struct FNodeCost
+	/**
+		How FMicroPather orders its open set. All three find paths of the same cost for integer
+		costs, but break ties differently, so they may pick different paths among equally cheap
+		ones. They differ in how expensive it is to push, pop and re-sort a node.
+	*/
+	enum class EOpenQueueType : uint8
 	{
-		FPathNode* Node;
-		float Cost;
+		SortedList,		///< Sorted doubly linked list. O(n) push and update. The original MicroPather queue.
+		BinaryHeap,		///< Indexed binary min-heap with decrease-key. O(log n) push, pop and update.
+		BucketQueue,	///< One bucket per integer total cost, over a window of costs. O(1) push and update. Costs outside
+						///< the window fall back to a binary heap. Only exact if costs are integers.
 	};
 
 
 	/*
-		Every state (void*) is represented by a PathNode in MicroPather. There
-		can only be one PathNode for a given state.
+		Every state (void*) is represented by a path node in MicroPather, addressed by a 32 bit
+		index into FPathNodePool. There can only be one node for a given state. Only what the search
+		reads for every neighbor is kept here, so a node is 24 bytes. Open list links and the neighbor
+		cache are kept in side arrays of the pool with the same index.
 	*/
-	class FPathNode
+	struct FPathNode
 	{
-	  public:
-		  void Init(
-			  uint32 InFrame,
-			  void* InState,
-			  float InCostFromStart,
-			  float InEstToGoal,
-			  FPathNode* InParent);
+		void Init(uint32 InFrame, float InCostFromStart, float InEstToGoal, int32 InParent)
+		{
+			SetCost(InCostFromStart, InEstToGoal);
+			Parent = InParent;
+			Frame = InFrame;
+			QueueIndex = INDEX_NONE;
+			bInOpen = 0;
+			bInClosed = 0;
+			bInOverflow = 0;
+		}
 
-		void Clear();
-		void InitSentinel();	
+		void SetCost(float InCostFromStart, float EstToGoal)
+		{
+			CostFromStart = InCostFromStart;
+			TotalCost = (InCostFromStart < FLT_MAX && EstToGoal < FLT_MAX) ? InCostFromStart + EstToGoal : FLT_MAX;
+		}
 
-		void* State;			// the client state
 		float CostFromStart;	// exact
-		float EstToGoal;		// estimated
-		float TotalCost;		// could be a function, but save some math.
-		FPathNode* Parent;		// the parent is used to reconstruct the path
-		unsigned Frame;			// unique id for this path, so the solver can distinguish
+		float TotalCost;		// cost from start + estimated cost to goal
+		int32 Parent;			// the parent is used to reconstruct the path. INDEX_NONE at the start.
+		uint32 Frame;			// unique id for this path, so the solver can distinguish
 								// correct from stale values
+		int32 QueueIndex;		// position in the open heap, or bucket of the open bucket queue, or position in
+								// its overflow heap
 
-		int NumAdjacent;		// -1  is unknown & needs to be queried
-		int CacheIndex;			// position in cache
-		uint32 CacheFrame;
-
-		FPathNode* Child[2];		// Binary search in the hash table. [left, right]
-		FPathNode* Next, *Prev;	// used by open queue
-
-		bool bInOpen;
-		bool bInClosed;
-
-		void Unlink();
-		void AddBefore(FPathNode* Node);
+		uint8 bInOpen : 1;
+		uint8 bInClosed : 1;
+		uint8 bInOverflow : 1;	// in the overflow heap of the bucket queue
+	};
 
-#ifdef DEBUG
-		void CheckList()
-		{
-			MPASSERT( TotalCost == FLT_MAX );
-			for( FPathNode* it = Next; it != this; it=it->Next ) {
-				MPASSERT( it->Prev == this || it->TotalCost >= it->Prev->TotalCost );
-				MPASSERT( it->TotalCost <= it->Next->TotalCost );
-			}
-		}
-#endif
+	struct FNodeCost
+	{
+		int32 Node;
+		float Cost;
+	};
 
-		void CalcTotalCost();
+	// Doubly linked list of the sorted and bucket open queues. INDEX_NONE ends the list.
+	struct FPathNodeLinks
+	{
+		int32 Next;
+		int32 Prev;
+	};
 
-	private:
-		void operator=(const FPathNode&);
+	// Neighbors of a node, as learnt at Version of the graph. Stale if the neighbor cache was cleared since.
+	struct FPathNodeNeighbors
+	{
+		int32 NumAdjacent;		// -1 is unknown & needs to be queried
+		int32 CacheIndex;		// position in the neighbor cache, -1 if it didn't fit
+		uint32 CacheGeneration;	// neighbor cache generation it was learnt in
+		uint32 Version;			// graph version it was learnt at
 	};
 
 
@@ -190,38 +256,63 @@ namespace MicroPanther
 	class FPathNodePool
 	{
 	public:
-		FPathNodePool(unsigned InNumNodesPerBlock, unsigned _typicalAdjacent);
+		FPathNodePool(uint32 InNumNodesPerBlock, uint32 InNumTypicalAdjacent);
 		~FPathNodePool();
 
-		// Free all the memory except the first block. Resets all memory.
+		// Forgets every node and frees the memory of hashed ones.
 		void Clear();
 
+		// Switch to (or resize) the dense store for states 0..NumStates-1. 0 turns it off.
+		// States out of that range still go to the hash table.
+		void SetNumDenseStates(int32 NumStates);
+
+		// Forgets the neighbors of every node
 		void ClearNeighborCache();
 
+		// Grows the neighbor cache to hold the typical neighbors of NumNodes nodes. Clears it if it grows.
+		void ReserveNeighborCache(int32 NumNodes);
+
+		bool IsNeighborCacheMostlyFull() const { return NeighborCostsCacheSize * 4 > NeighborCostsCapacity * 3; }
+
+		uint32 GetNeighborCacheGeneration() const { return NeighborCacheGeneration; }
+
 		// Essentially:
-		// pNode = Find();
-		// if ( !pNode )
-		//		pNode = New();
+		// Node = Find();
+		// if ( Node == INDEX_NONE )
+		//		Node = New();
 		//
-		// Get the PathNode associated with this state. If the PathNode already
-		// exists (allocated and is on the current frame), it will be returned. 
-		// Else a new PathNode is allocated and returned. The returned object
-		// is always fully initialized.
+		// Get the node associated with this state. If the node already exists and is
+		// on the current frame, it will be returned. Else it is initialized for the frame.
 		//
-		// NOTE: if the pathNode exists (and is current) all the initialization
+		// NOTE: if the node exists (and is current) all the initialization
 		//       parameters are ignored.
-		FPathNode* GetPathNode(
-			unsigned frame,
-			void* _state,
-			float _costFromStart,
-			float _estToGoal,
-			FPathNode* _parent);
+		int32 GetPathNode(uint32 Frame, void* State, float CostFromStart, float EstToGoal, int32 Parent);
+
+		// Get a node that is already in the pool.
+		int32 FetchPathNode(void* State) const;
+
+		// Reinitializes a node that is in the pool, if it is from an older frame
+		void RefreshPathNode(int32 Node, uint32 Frame)
+		{
+			if (Nodes[Node].Frame != Frame)
+			{
+				InitPathNode(Node, Frame, FLT_MAX, FLT_MAX, INDEX_NONE);
+			}
+		}
+
+		FPathNode& GetNode(int32 Node) { return Nodes[Node]; }
+		const FPathNode& GetNode(int32 Node) const { return Nodes[Node]; }
 
-		// Get a pathnode that is already in the pool.
-		FPathNode* FetchPathNode(void* state);
+		FPathNodeLinks& GetLinks(int32 Node) { return Links[Node]; }
+		FPathNodeNeighbors& GetNeighbors(int32 Node) { return Neighbors[Node]; }
+
+		void* GetState(int32 Node) const
+		{
+			return (Node < NumDenseNodes) ? (void*)(MP_UPTR)Node : HashedStates[Node - NumDenseNodes];
+		}
 
 		// Store stuff in cache
-		bool PushCache(const TArray<FNodeCost>& Nodes, int32* OutStartIndex);
+		bool PushCache(const TArray<FNodeCost>& NodeCosts, int32* OutStartIndex);
 
 		// Get neighbors from the cache
 		// Note - always access this with an offset. Can get re-allocated.
@@ -231,43 +322,62 @@ namespace MicroPanther
 		// the pather is doing.
 		void AllStates(uint32 frame, TArray<void*>* stateVec);
 
+		int32 GetNumNodes() const { return Nodes.Num(); }
+
+		// Node arrays, hash table and neighbor cache
+		SIZE_T GetAllocatedSize() const;
+
 	private:
-		struct FBlock
+		// Neighbors are kept, they are checked against the cache generation and graph version
+		void InitPathNode(int32 Node, uint32 Frame, float CostFromStart, float EstToGoal, int32 Parent)
 		{
-			FBlock* NextBlock;
-			FPathNode PathNode[1];
-		};
+			Nodes[Node].Init(Frame, CostFromStart, EstToGoal, Parent);
+		}
+
+		void ForgetNeighbors(int32 Node)
+		{
+			Neighbors[Node].NumAdjacent = -1;
+			Neighbors[Node].CacheIndex = -1;
+			Neighbors[Node].CacheGeneration = 0;
+			Neighbors[Node].Version = 0;
+		}
+
+		uint32 Hash(void* voidval) const;
+		uint32 HashSize() const { return 1 << HashShift; }
+		uint32 HashMask() const { return ((1 << HashShift) - 1); }
 
-		unsigned Hash(void* voidval);
-		unsigned HashSize() const { return 1 << HashShift; }
-		unsigned HashMask()	const { return ((1 << HashShift) - 1); }
-		void AddPathNode(uint32 HashKey, FPathNode* RootNode);
-		FBlock* AllocBlock();
-		FPathNode* Alloc();
+		// Hash slot of State, or the empty slot it would go to
+		uint32 FindHashSlot(void* State) const;
+		void GrowHashTable();
 
-		FPathNode** HashTable;
-		FBlock* FirstBlock;
-		FBlock* Blocks;
+		int32 AllocNode(void* State);
+
+		// index = node. Dense states come first, node index = state. Then hashed states in the order they were added.
+		TArray<FPathNode> Nodes;
+		TArray<FPathNodeLinks> Links;
+		TArray<FPathNodeNeighbors> Neighbors;
+
+		// State of each hashed node. index = node - NumDenseNodes
+		TArray<void*> HashedStates;
+
+		// Open addressing, linear probing. Node of each slot, INDEX_NONE if empty.
+		TArray<int32> HashTable;
+		uint32 HashShift;
+		uint32 InitialHashShift;
+
+		int32 NumDenseNodes;
 
 		FNodeCost* NeighborCostsCache;
 		int32 NeighborCostsCapacity;
 		int32 NeighborCostsCacheSize;
 
-		FPathNode FreeMemSentinel;
+		// Starts at 1, so forgotten neighbors (generation 0) never look current
+		uint32 NeighborCacheGeneration;
 
-		// how big a block of path nodes to allocate at once
+		// how many hashed nodes to reserve at once
 		uint32 NumNodesPerBlock;
 
-		// number of pathnodes allocated (from Alloc())
-		uint32 NumTotalAllocatedNodes;
-
-		// number available for allocation
-		uint32 NumAvailableNodesOnLastBlock;
-				 
-		uint32 HashShift;
-
-		// Debug purpose
-		int32 NumHashCollision;
+		uint32 NumTypicalAdjacent;
 	};
 
 
@@ -290,6 +400,7 @@ namespace MicroPanther
 			// Data:
 			void* Next;
 			float Cost;	// from 'start' to 'next'. FLT_MAX if unsolveable.
+			uint32 Version;	// graph version it was found at. 0 if the graph has no versions.
 
 			unsigned Hash() const
 			{
@@ -312,9 +423,14 @@ namespace MicroPanther
 		FPathCache& operator = (const FPathCache&) = delete;
 		
 		void Reset();
-		void Add(const TArray<void*>& path, const TArray<float>& cost);
-		void AddNoSolution(void* end, void* states[], int count);
-		int Solve(void* startState, void* endState, TArray<void*>* path, float* totalCost);
+
+		// Graph is used for its versions. Items found at an older version replace nothing unless the
+		// graph has versions, and then they are dropped as soon as a state they leave from changes.
+		// No solution is dropped after any change at all. A graph with versions also starts the
+		// cache over when it is full, since old items may be stale.
+		void Add(const TArray<void*>& path, const TArray<float>& cost, const FGraph* Graph);
+		void AddNoSolution(void* end, void* states[], int count, const FGraph* Graph);
+		int Solve(void* startState, void* endState, TArray<void*>* path, float* totalCost, const FGraph* Graph);
 
 		int AllocatedBytes() const { return NumItemsAllocated * sizeof(FItem); }
 		int UsedBytes() const { return NumItems * sizeof(FItem); }
@@ -350,14 +466,14 @@ namespace MicroPanther
 	*/
 	class FMicroPather
 	{
-		friend class MicroPanther::FPathNode;
-
 	  public:
 		enum
 		{
 			SOLVED,
 			NO_SOLUTION,
 			START_END_SAME,
+			SOLVING,
+			PARTIAL,
 
 			// internal
 			NOT_CACHED
@@ -385,8 +501,11 @@ namespace MicroPanther
 			@param bUseCache	Turn on path caching. Uses more memory (yet again) but at a huge speed
 								advantage if you may call the pather with the same path or sub-path, which
 								is common for pathing over maps in games.
+			@param InOpenQueueType	How the open set is ordered. BucketQueue is the fastest, but only
+									keeps an exact order when the graph reports integer costs.
 		*/
-		FMicroPather(FGraph* InGraph, uint32 NumStatesAlloc = 250, uint32 NumTypicalAdjacent = 6, bool bUseCache = true);
+		FMicroPather(FGraph* InGraph, uint32 NumStatesAlloc = 250, uint32 NumTypicalAdjacent = 6, bool bUseCache = true,
+			EOpenQueueType InOpenQueueType = EOpenQueueType::SortedList);
 		~FMicroPather();
 
 		/**
@@ -397,9 +516,64 @@ namespace MicroPanther
 			@param path			Output, a vector of states that define the path. Empty if not found.
 			@param totalCost	Output, the cost of the path, if found.
 			@return				Success or failure, expressed as SOLVED, NO_SOLUTION, or START_END_SAME.
+								PARTIAL if the search limits stopped it.
 		*/
 		int Solve(void* StartState, void* EndState, TArray<void*>* Path, float* TotalCost);
 
+		/**
+			Solve for the cheapest path from start to any one of several goals, in one search.
+
+			@param StartState	Input, the starting state for the path.
+			@param GoalStates	Input, the states that count as reaching the goal.
+			@param Path			Output, a vector of states that define the path. Empty if not found.
+			@param TotalCost	Output, the cost of the path, if found.
+			@param OutGoalState	Output, the goal the path ends at, or the state a PARTIAL path ends at.
+			@return				SOLVED, NO_SOLUTION, or START_END_SAME if start is one of the goals.
+								PARTIAL if the search limits stopped it.
+		*/
+		int SolveForAnyGoal(void* StartState, const TArray<void*>& GoalStates, TArray<void*>* Path, float* TotalCost, void** OutGoalState);
+
+		/**
+			Start a search that is run a few nodes at a time with StepSolve, so a long path can be
+			spread over several frames. The path cache isn't used. Any other solve, Reset() or
+			SetGraph() while the search runs cancels it.
+
+			@return				SOLVING if StepSolve should be called, otherwise START_END_SAME.
+		*/
+		int BeginSolve(void* StartState, void* EndState);
+
+		/**
+			Same as BeginSolve, for the cheapest path to any one of the goals.
+
+			@return				SOLVING if StepSolve should be called, otherwise NO_SOLUTION or START_END_SAME.
+		*/
+		int BeginSolveForAnyGoal(void* StartState, const TArray<void*>& GoalStates);
+
+		/**
+			Continue the search started by BeginSolve. The open and closed sets are kept between calls,
+			and the graph must not change until the search is done.
+
+			@param MaxExpansions	Input, the most nodes expanded by this call.
+			@param Path				Output, a vector of states that define the path. Empty until solved.
+			@param TotalCost		Output, the cost of the path, if found.
+			@param OutGoalState		Output, optional, the goal the path ends at, or the state a PARTIAL path ends at.
+			@return					SOLVING while the search isn't done, then SOLVED, NO_SOLUTION or PARTIAL.
+		*/
+		int StepSolve(int32 MaxExpansions, TArray<void*>* Path, float* TotalCost, void** OutGoalState = nullptr);
+
+		/** Drops the search started by BeginSolve. */
+		void CancelSolve();
+
+		/**
+			Caps the searches started from now on. A capped search that gives up returns PARTIAL
+			and the path to the explored state closest to the goals, which may be the start alone.
+			Paths found in the path cache are returned as they are.
+		*/
+		void SetSearchLimits(const FSearchLimits& InSearchLimits) { SearchLimits = InSearchLimits; }
+		const FSearchLimits& GetSearchLimits() const { return SearchLimits; }
+
+		bool IsSolving() const { return bSearchRunning; }
+
 		/**
 			Find all the states within a given cost from startState.
 
@@ -416,16 +590,38 @@ namespace MicroPanther
 		*/
 		void Reset();
 
+		/** Points the pather at another graph, such as a newer snapshot of the same map. Resets the pather
+			if the graph is different.
+		*/
+		void SetGraph(FGraph* InGraph);
+
+		FGraph* GetGraph() const { return Graph; }
+
 		// Debugging function to return all states that were used by the last "solve" 
 		void Debug_StatesInPool(TArray<void*>* stateVec);
 		void Debug_GetCacheData(FCacheData* data);
 
+		// Number of nodes popped from the open set by the last solve, every step of a BeginSolve search included.
+		int32 GetNumExpandedNodes() const { return NumExpandedNodes; }
+
+		EOpenQueueType GetOpenQueueType() const { return OpenQueueType; }
+
+		// Path nodes in the pool, and the bytes they take. Dense graphs have one node per state.
+		int32 Debug_GetNumPathNodes() const { return PathNodePool.GetNumNodes(); }
+		SIZE_T Debug_GetPathNodeBytes() const { return PathNodePool.GetAllocatedSize(); }
+
 	  private:
 		  FMicroPather(const FMicroPather&);	// undefined and unsupported
 		  void operator=(const FMicroPather); // undefined and unsupported
 
-		  void GoalReached(FPathNode* node, void* start, void* end, TArray<void*> *path);
-		  void GetNodeNeighbors(FPathNode* node, TArray<FNodeCost>* neighborNode);
+		  int SolveInternal(void* StartState, void* const* GoalStates, int32 NumGoals, TArray<void*>* Path, float* TotalCost, void** OutGoalState);
+		  void BeginSearch(void* StartState, void* const* GoalStates, int32 NumGoals);
+		  int StepSearch(int32 MaxExpansions, TArray<void*>* Path, float* TotalCost, void** OutGoalState);
+		  float LeastCostEstimateToGoals(void* State, void* const* GoalStates, int32 NumGoals);
+
+		  void GoalReached(int32 Node, void* Start, void* End, TArray<void*>* InPath);
+		  int PartialPathReached(TArray<void*>* Path, float* TotalCost, void** OutGoalState);
+		  void GetNodeNeighbors(int32 Node, TArray<FNodeCost>* OutNodeCosts);
 
 		  void IncreaseFrame();
 
@@ -446,7 +642,37 @@ namespace MicroPanther
 
 		  // incremented with every solve, used to determine if cached data needs to be refreshed
 		  uint32 Frame;
+
+		  // Graph has state versions, as of the last frame
+		  bool bVersionedGraph;
 		  FPathCache* PathCache;
+
+		  EOpenQueueType OpenQueueType;
+
+		  // Heap or buckets of the open queue, and the overflow heap of the buckets. Local to Solve, but
+		  // put here to reduce memory allocation
+		  TArray<int32> OpenQueueStorage;
+		  TArray<int32> OpenQueueUsedBuckets;
+		  TArray<int32> OpenQueueOverflow;
+
+		  // Open set of the running search. Lives as long as the pather so a search can be stepped.
+		  FOpenQueue* Open;
+
+		  void* SearchStartState;
+		  TArray<void*> SearchGoalStates;
+
+		  // Frame the running search started in. Nodes of older frames are stale.
+		  uint32 SearchFrame;
+		  bool bSearchRunning;
+
+		  FSearchLimits SearchLimits;
+		  FSearchLimits RunningSearchLimits;
+
+		  // Explored node of the running search with the lowest estimate to the goals, the end of a PARTIAL path
+		  int32 SearchClosestNode;
+		  float SearchClosestEstimate;
+
+		  int32 NumExpandedNodes;
 	};
 
 };	// MicroPanther
@@ -1,21 +1,146 @@
 #include "Navigation.h"
 #include "BlockActor.h"
 #include "DrawDebugHelpers.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/Engine.h"
+
+static TAutoConsoleVariable<int32> CVarNavSolver(
+	TEXT("Starfound.Nav.Solver"),
+	(int32)ENavSolver::Hierarchical,
+	TEXT("Path finding solver of ANavigation::FindPath.\n")
+	TEXT(" 0: flat A* over every cell\n")
+	TEXT(" 1: hierarchical A* over 16x16 clusters\n")
+	TEXT(" 2: jump point search, optimal paths\n")
+	TEXT(" 3: A* over floor spans, optimal paths"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarNavFrameBudgetMs(
+	TEXT("Starfound.Nav.FrameBudgetMs"),
+	2.0f,
+	TEXT("Estimated worker milliseconds of async path requests dispatched per frame. At least one request is dispatched every frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarNavMaxExpansionsPerSlice(
+	TEXT("Starfound.Nav.MaxExpansionsPerSlice"),
+	2048,
+	TEXT("Nodes an async path request expands per dispatch. Longer searches go back in the queue and continue in a later frame.\n")
+	TEXT("0: no limit"),
+	ECVF_Default);
+
+// The rules of UpdateGraphCell for 64 cells at once. Rows are block rows relative to the classified one,
+// null outside the grid. Shifting a row by one lines up each cell with its left or right neighbor.
+static void ClassifyNavRow(const uint64* Below2, const uint64* Below1, const uint64* Row, const uint64* Above, int32 NumWords, int32 NumCells,
+	uint64* OutWalkable, uint64* OutClimb)
+{
+	for (int32 Word = 0; Word < NumWords; ++Word)
+	{
+		const uint64 Floor1 = Below1 ? Below1[Word] : 0;
+		const uint64 Floor2 = Below2 ? Below2[Word] : 0;
+		const uint64 Block = Row ? Row[Word] : 0;
+		const uint64 Upper = Above ? Above[Word] : 0;
+
+		// Blocks at X - 1 and X + 1 of the row below, carried over word boundaries
+		const uint64 LeftWall = (Floor1 << 1) | ((Below1 && Word > 0) ? (Below1[Word - 1] >> 63) : 0);
+		const uint64 RightWall = (Floor1 >> 1) | ((Below1 && Word + 1 < NumWords) ? (Below1[Word + 1] << 63) : 0);
+
+		const uint64 HasFloor = Floor1 | (Floor2 & (LeftWall | RightWall));
+
+		uint64 Walkable = ~Block & HasFloor & ~Upper;
+
+		if (Word == NumWords - 1 && NumCells % 64 != 0)
+		{
+			Walkable &= (1ull << (NumCells % 64)) - 1;
+		}
+
+		OutWalkable[Word] = Walkable;
+		OutClimb[Word] = Walkable & ~Floor1;
+	}
+}
 
 ANavigation::ANavigation()
 {
 	PrimaryActorTick.bCanEverTick = true;
 
 	Graph.Reset(new FSideScrollGraph);
-	MicroPather.Reset(new MicroPanther::FMicroPather(Graph.Get(), 250, 6, false));
+	MicroPather.Reset(new TMicroPather<FSideScrollGraph>(Graph.Get()));
+	HierarchicalGraph.Reset(new FHierarchicalGraph(*Graph));
+	JumpPointGraph.Reset(new FJumpPointGraph(*Graph));
+	SpanGraph.Reset(new FSpanGraph(*Graph));
+	AsyncPathFinder.Reset(new FAsyncPathFinder);
+
+	bGraphRebuildNeeded = true;
+	ConnectivityVersion = 0;
+	LastPathRequestId = 0;
+	LastFlowFieldId = 0;
+
+	FMemory::Memzero(RequestStats);
+	// Until we've measured a solve
+	RequestStats.AverageSolveMilliseconds = 0.5f;
+}
+
+void ANavigation::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+	if (BlockScene)
+	{
+		BlockScene->OnBlockCellChanged().AddUObject(this, &ANavigation::OnBlockCellChanged);
+	}
+
+	// Blocks registered before we started listening
+	bGraphRebuildNeeded = true;
+}
+
+void ANavigation::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+	if (BlockScene)
+	{
+		BlockScene->OnBlockCellChanged().RemoveAll(this);
+	}
+
+	// Solves in flight finish on their own, nobody listens anymore
+	PendingPathRequests.Empty();
+
+	for (TArray<FQueuedPathRequest>& Queue : QueuedPathRequests)
+	{
+		Queue.Empty();
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ANavigation::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
 
-	UpdateGraph();
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+	if (BlockScene)
+	{
+		if (Graph->GetGridCountX() != BlockScene->GetNumGridX() ||
+			Graph->GetGridCountY() != BlockScene->GetNumGridY())
+		{
+			bGraphRebuildNeeded = true;
+		}
+	}
+
+	if (bGraphRebuildNeeded)
+	{
+		UpdateGraph();
+	}
+	else if (DirtyBlockCells.Num() > 0)
+	{
+		UpdateDirtyCells();
+	}
+
+	DispatchPathRequests();
+	DeliverPathResults();
+}
 
+void ANavigation::OnBlockCellChanged(const FIntPoint& Cell)
+{
+	DirtyBlockCells.Add(Cell);
 }
 
 void ANavigation::UpdateGraph()
@@ -31,43 +156,137 @@ void ANavigation::UpdateGraph()
 
 		const int32 NumX = Graph->GetGridCountX();
 		const int32 NumY = Graph->GetGridCountY();
+		const int32 NumRowWords = Graph->GetNumRowWords();
 
-		for (int32 X = 0; X < NumX; ++X)
+		if (ensure(BlockScene->GetNumRowWords() == NumRowWords))
 		{
+			WalkableBits.SetNumUninitialized(NumRowWords * NumY);
+			ClimbBits.SetNumUninitialized(NumRowWords * NumY);
+
 			for (int32 Y = 0; Y < NumY; ++Y)
 			{
-				ABlockActor* BlockActor = BlockScene->GetBlock(X, Y);
+				ClassifyNavRow(BlockScene->GetOccupiedRow(Y - 2), BlockScene->GetOccupiedRow(Y - 1), BlockScene->GetOccupiedRow(Y),
+					BlockScene->GetOccupiedRow(Y + 1), NumRowWords, NumX, &WalkableBits[Y * NumRowWords], &ClimbBits[Y * NumRowWords]);
+			}
 
-				// Have to have floor to move
-				const ABlockActor* FloorBlockActor1 = BlockScene->GetBlock(X, Y - 1);
-				const ABlockActor* FloorBlockActor2 = BlockScene->GetBlock(X, Y - 2);
-				const ABlockActor* LeftWallBlockActor = BlockScene->GetBlock(X - 1, Y - 1);
-				const ABlockActor* RightWallBlockActor = BlockScene->GetBlock(X + 1, Y - 1);
+			Graph->SetCells(WalkableBits, ClimbBits);
+		}
 
-				const bool bHasFloor = (FloorBlockActor1) 
-					|| (FloorBlockActor2 && (LeftWallBlockActor || RightWallBlockActor));
+		Graph->RebuildComponents();
+		Graph->RebuildLandmarks();
+		HierarchicalGraph->Rebuild();
+		SpanGraph->Rebuild();
+		GraphSnapshot.Reset();
 
-				// A pawn is 2 block tall
-				const ABlockActor* UpperBlockActor = BlockScene->GetBlock(X, Y + 1);
+		for (TPair<uint32, FSharedFlowField>& FlowField : FlowFields)
+		{
+			FlowField.Value.Field->Rebuild();
+		}
 
-				if (BlockActor || !bHasFloor || UpperBlockActor)
-				{
-					Graph->SetHeight(X, Y, -1);
-				}
-				else
+		++ConnectivityVersion;
+
+		bGraphRebuildNeeded = false;
+		DirtyBlockCells.Reset();
+	}
+}
+
+void ANavigation::UpdateDirtyCells()
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+	if (!BlockScene)
+	{
+		return;
+	}
+
+	// Every nav cell that reads the block cell in UpdateGraphCell.
+	// The cell itself, the two cells above it (floor), the cells diagonally above it (wall) and the cell below it (head)
+	const FIntPoint AffectedOffsets[] = { {0, 0}, {0, 1}, {0, 2}, {-1, 1}, {1, 1}, {0, -1} };
+
+	ChangedGraphCells.Reset();
+
+	bool bConnectivityChanged = false;
+
+	for (const FIntPoint& BlockCell : DirtyBlockCells)
+	{
+		for (const FIntPoint& Offset : AffectedOffsets)
+		{
+			const FIntPoint Cell = BlockCell + Offset;
+
+			if (Cell.X >= 0 && Cell.X < Graph->GetGridCountX() && Cell.Y >= 0 && Cell.Y < Graph->GetGridCountY())
+			{
+				const bool bWasBlocked = Graph->GetHeight(Cell.X, Cell.Y) == -1;
+
+				if (UpdateGraphCell(*BlockScene, Cell.X, Cell.Y))
 				{
-					int32 Cost = 0;
-					
-					if (!FloorBlockActor1)
+					ChangedGraphCells.Add(Cell);
+
+					// Blocking a cell only ever splits components
+					if (bWasBlocked || IsValidGridLocation(Cell))
 					{
-						Cost = 1;
+						bConnectivityChanged = true;
 					}
-
-					Graph->SetHeight(X, Y, Cost);
 				}
 			}
 		}
 	}
+
+	if (ChangedGraphCells.Num() > 0)
+	{
+		Graph->UpdateComponents(ChangedGraphCells);
+		Graph->UpdateLandmarks(ChangedGraphCells);
+		HierarchicalGraph->MarkCellsDirty(ChangedGraphCells);
+		SpanGraph->MarkCellsDirty(ChangedGraphCells);
+		GraphSnapshot.Reset();
+
+		for (TPair<uint32, FSharedFlowField>& FlowField : FlowFields)
+		{
+			FlowField.Value.Field->UpdateCells(ChangedGraphCells);
+		}
+	}
+
+	if (bConnectivityChanged)
+	{
+		++ConnectivityVersion;
+	}
+
+	DirtyBlockCells.Reset();
+}
+
+bool ANavigation::UpdateGraphCell(const UBlockActorScene& BlockScene, int32 X, int32 Y)
+{
+	const bool bBlock = BlockScene.HasBlock(X, Y);
+
+	// Have to have floor to move. ClassifyNavRow has the same rules for whole rows.
+	const bool bFloor1 = BlockScene.HasBlock(X, Y - 1);
+	const bool bFloor2 = BlockScene.HasBlock(X, Y - 2);
+	const bool bLeftWall = BlockScene.HasBlock(X - 1, Y - 1);
+	const bool bRightWall = BlockScene.HasBlock(X + 1, Y - 1);
+
+	const bool bHasFloor = bFloor1 || (bFloor2 && (bLeftWall || bRightWall));
+
+	// A pawn is 2 block tall
+	const bool bUpperBlock = BlockScene.HasBlock(X, Y + 1);
+
+	int32 Cost = -1;
+
+	if (!bBlock && bHasFloor && !bUpperBlock)
+	{
+		Cost = 0;
+		
+		if (!bFloor1)
+		{
+			Cost = 1;
+		}
+	}
+
+	if (Graph->GetHeight(X, Y) == Cost)
+	{
+		return false;
+	}
+
+	Graph->SetHeight(X, Y, Cost);
+
+	return true;
 }
 
 bool ANavigation::FindPath(const FVector& StartLocation, const FVector& TargetLocation, TArray<FVector2D>& OutPath)
@@ -80,28 +299,109 @@ bool ANavigation::FindPath(const FVector& StartLocation, const FVector& TargetLo
 	}
 
 	const int32 StartX = BlockScene->WorldSpaceToOriginSpaceGridX(StartLocation.Y);
-	const int32 StartY = BlockScene->WorldSpaceToOriginSpaceGridX(StartLocation.Z);
+	const int32 StartY = BlockScene->WorldSpaceToOriginSpaceGridY(StartLocation.Z);
 	const int32 TargetX = BlockScene->WorldSpaceToOriginSpaceGridX(TargetLocation.Y);
-	const int32 TargetY = BlockScene->WorldSpaceToOriginSpaceGridX(TargetLocation.Z);
+	const int32 TargetY = BlockScene->WorldSpaceToOriginSpaceGridY(TargetLocation.Z);
 
 
-	void* StartState = Graph->Vec2ToState(FIntPoint(StartX, StartY));
-	void* EndState = Graph->Vec2ToState(FIntPoint(TargetX, TargetY));
+	// Don't search the whole component just to find out
+	if (!Graph->AreConnected(FIntPoint(StartX, StartY), FIntPoint(TargetX, TargetY)))
+	{
+		return false;
+	}
 
-	TArray<void*> Path;
 	float TotalCost;
+	const int32 Solver = CVarNavSolver.GetValueOnGameThread();
+
+	if (Solver != (int32)ENavSolver::Hierarchical && Solver != (int32)ENavSolver::JumpPoint && Solver != (int32)ENavSolver::Span)
+	{
+		const int32 StartState = StartX + (StartY * Graph->GetGridCountX());
+		const int32 EndState = TargetX + (TargetY * Graph->GetGridCountX());
 
-	const int32 Result = MicroPather->Solve(StartState, EndState, &Path, &TotalCost);
+		if (MicroPather->Solve(StartState, EndState, TypedPath, TotalCost) == MicroPanther::FMicroPather::SOLVED)
+		{
+			StatesToWorldPath(*BlockScene, TypedPath, OutPath);
+
+			return true;
+		}
+
+		return false;
+	}
+
+	TArray<void*> Path;
+	int32 Result;
+
+	if (Solver == (int32)ENavSolver::Hierarchical)
+	{
+		Result = HierarchicalGraph->FindPath(FIntPoint(StartX, StartY), FIntPoint(TargetX, TargetY), Path, TotalCost);
+	}
+	else if (Solver == (int32)ENavSolver::JumpPoint)
+	{
+		Result = JumpPointGraph->FindPath(FIntPoint(StartX, StartY), FIntPoint(TargetX, TargetY), Path, TotalCost);
+	}
+	else
+	{
+		Result = SpanGraph->FindPath(FIntPoint(StartX, StartY), FIntPoint(TargetX, TargetY), Path, TotalCost);
+	}
 
 	if (Result == MicroPanther::FMicroPather::SOLVED)
 	{
-		for (int32 i = 0; i < Path.Num(); ++i)
-		{
-			FIntPoint Point = Graph->StateToVec2(Path[i]);
-			FVector2D WorldSpaceLocation = BlockScene->OriginSpaceGridToWorldSpace2D(Point);
+		StatesToWorldPath(*BlockScene, Path, OutPath);
+
+		return true;
+	}
+
+	return false;
+}
 
-			OutPath.Add(WorldSpaceLocation);
+bool ANavigation::FindPathToAny(const FVector& StartLocation, const TArray<FIntPoint>& Goals, FIntPoint& OutGoal, TArray<FVector2D>& OutPath)
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!ensure(BlockScene))
+	{
+		return false;
+	}
+
+	const FIntPoint Start = BlockScene->WorldSpaceToOriginSpaceGrid(StartLocation);
+
+	const int32 GridCountX = Graph->GetGridCountX();
+
+	TArray<int32> GoalStates;
+	GoalStates.Reserve(Goals.Num());
+
+	for (const FIntPoint& Goal : Goals)
+	{
+		// Blocked, out of grid and disconnected cells can't be reached
+		if (Goal == Start || Graph->AreConnected(Start, Goal))
+		{
+			GoalStates.Add(Goal.X + (Goal.Y * GridCountX));
 		}
+	}
+
+	if (GoalStates.Num() == 0)
+	{
+		return false;
+	}
+
+	float TotalCost;
+	int32 GoalState = INDEX_NONE;
+
+	const int32 Result = MicroPather->SolveForAnyGoal(Start.X + (Start.Y * GridCountX), GoalStates, TypedPath, TotalCost, GoalState);
+
+	if (Result == MicroPanther::FMicroPather::START_END_SAME)
+	{
+		// Already there
+		OutGoal = Start;
+		OutPath.Add(BlockScene->OriginSpaceGridToWorldSpace2D(Start));
+
+		return true;
+	}
+
+	if (Result == MicroPanther::FMicroPather::SOLVED)
+	{
+		OutGoal = FIntPoint(GoalState % GridCountX, GoalState / GridCountX);
+		StatesToWorldPath(*BlockScene, TypedPath, OutPath);
 
 		return true;
 	}
@@ -109,6 +409,319 @@ bool ANavigation::FindPath(const FVector& StartLocation, const FVector& TargetLo
 	return false;
 }
 
+uint32 ANavigation::RequestPath(const FVector& StartLocation, const FVector& TargetLocation, const FNavPathDelegate& OnComplete,
+	ENavRequestPriority Priority, const MicroPanther::FSearchLimits& Limits)
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!ensure(BlockScene))
+	{
+		return 0;
+	}
+
+	TArray<FIntPoint> Goals;
+	Goals.Add(BlockScene->WorldSpaceToOriginSpaceGrid(TargetLocation));
+
+	return RequestPathInternal(BlockScene->WorldSpaceToOriginSpaceGrid(StartLocation), Goals, OnComplete, Priority, Limits);
+}
+
+uint32 ANavigation::RequestPathToAny(const FVector& StartLocation, const TArray<FIntPoint>& Goals, const FNavPathDelegate& OnComplete,
+	ENavRequestPriority Priority, const MicroPanther::FSearchLimits& Limits)
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!ensure(BlockScene))
+	{
+		return 0;
+	}
+
+	return RequestPathInternal(BlockScene->WorldSpaceToOriginSpaceGrid(StartLocation), Goals, OnComplete, Priority, Limits);
+}
+
+uint32 ANavigation::RequestPathInternal(const FIntPoint& Start, const TArray<FIntPoint>& Goals, const FNavPathDelegate& OnComplete,
+	ENavRequestPriority Priority, const MicroPanther::FSearchLimits& Limits)
+{
+	// Never hand out 0
+	LastPathRequestId = FMath::Max(LastPathRequestId + 1, 1u);
+
+	FAsyncPathRequest Request;
+	Request.RequestId = LastPathRequestId;
+	Request.Start = Start;
+	Request.Limits = Limits;
+
+	for (const FIntPoint& Goal : Goals)
+	{
+		// Blocked, out of grid and disconnected cells can't be reached
+		if (Goal == Start || Graph->AreConnected(Start, Goal))
+		{
+			Request.Goals.Add(Goal);
+		}
+	}
+
+	FPendingPathRequest& PendingRequest = PendingPathRequests.Add(Request.RequestId);
+	PendingRequest.OnComplete = OnComplete;
+	PendingRequest.Priority = Priority;
+
+	if (Request.Goals.Num() == 0)
+	{
+		// Still answered from Tick, so callers see one order of events
+		FAsyncPathResult Result;
+		Result.RequestId = Request.RequestId;
+		Result.bSuccess = false;
+		Result.bPartial = false;
+		Result.Goal = Start;
+		Result.SolveMilliseconds = 0;
+
+		AsyncPathFinder->AddResult(MoveTemp(Result));
+	}
+	else
+	{
+		FQueuedPathRequest QueuedRequest;
+		QueuedRequest.Request = MoveTemp(Request);
+		QueuedRequest.QueuedTime = FPlatformTime::Seconds();
+
+		QueuedPathRequests[(int32)Priority].Add(MoveTemp(QueuedRequest));
+	}
+
+	return LastPathRequestId;
+}
+
+void ANavigation::DispatchPathRequests()
+{
+	const float BudgetMilliseconds = CVarNavFrameBudgetMs.GetValueOnGameThread();
+	const int32 MaxExpansions = CVarNavMaxExpansionsPerSlice.GetValueOnGameThread();
+	const double Now = FPlatformTime::Seconds();
+
+	float SpentMilliseconds = 0;
+	int32 NumDispatched = 0;
+	int32 QueueDepth = 0;
+
+	for (TArray<FQueuedPathRequest>& Queue : QueuedPathRequests)
+	{
+		int32 NumRemoved = 0;
+
+		for (; NumRemoved < Queue.Num(); ++NumRemoved)
+		{
+			// Always make progress, however slow solves have been
+			if (NumDispatched > 0 && SpentMilliseconds + RequestStats.AverageSolveMilliseconds > BudgetMilliseconds)
+			{
+				break;
+			}
+
+			FQueuedPathRequest& QueuedRequest = Queue[NumRemoved];
+
+			if (!PendingPathRequests.Contains(QueuedRequest.Request.RequestId))
+			{
+				// Canceled while queued
+				continue;
+			}
+
+			if (QueuedRequest.Search.IsValid())
+			{
+				// Keeps the snapshot it started with
+				AsyncPathFinder->Continue(QueuedRequest.Search, MaxExpansions);
+				QueuedRequest.Search.Reset();
+			}
+			else
+			{
+				const float WaitMilliseconds = (Now - QueuedRequest.QueuedTime) * 1000.0;
+
+				RequestStats.AverageWaitMilliseconds = FMath::Lerp(RequestStats.AverageWaitMilliseconds, WaitMilliseconds, 0.1f);
+				RequestStats.MaxWaitMilliseconds = FMath::Max(RequestStats.MaxWaitMilliseconds, WaitMilliseconds);
+
+				AsyncPathFinder->Dispatch(GetGraphSnapshot(), MoveTemp(QueuedRequest.Request), MaxExpansions);
+			}
+
+			SpentMilliseconds += RequestStats.AverageSolveMilliseconds;
+			++NumDispatched;
+		}
+
+		Queue.RemoveAt(0, NumRemoved, false);
+
+		QueueDepth += Queue.Num();
+	}
+
+	RequestStats.QueueDepth = QueueDepth;
+	RequestStats.MaxQueueDepth = FMath::Max(RequestStats.MaxQueueDepth, QueueDepth);
+	RequestStats.NumInFlight = AsyncPathFinder->GetNumInFlight();
+	RequestStats.NumDispatchedLastFrame = NumDispatched;
+}
+
+void ANavigation::CancelPathRequest(uint32 RequestId)
+{
+	PendingPathRequests.Remove(RequestId);
+}
+
+void ANavigation::DeliverPathResults()
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	FAsyncPathResult Result;
+
+	while (AsyncPathFinder->PopResult(Result))
+	{
+		if (Result.SolveMilliseconds > 0)
+		{
+			RequestStats.AverageSolveMilliseconds = FMath::Lerp(RequestStats.AverageSolveMilliseconds, Result.SolveMilliseconds, 0.1f);
+		}
+
+		if (Result.Search.IsValid())
+		{
+			// Out of expansions. The rest of the search waits its turn behind requests of the same priority.
+			const FPendingPathRequest* PendingRequest = PendingPathRequests.Find(Result.RequestId);
+
+			if (PendingRequest)
+			{
+				FQueuedPathRequest QueuedRequest;
+				QueuedRequest.Request.RequestId = Result.RequestId;
+				QueuedRequest.Search = MoveTemp(Result.Search);
+				QueuedRequest.QueuedTime = FPlatformTime::Seconds();
+
+				QueuedPathRequests[(int32)PendingRequest->Priority].Add(MoveTemp(QueuedRequest));
+			}
+
+			Result.Search.Reset();
+			continue;
+		}
+
+		FPendingPathRequest PendingRequest;
+
+		if (!PendingPathRequests.RemoveAndCopyValue(Result.RequestId, PendingRequest))
+		{
+			// Canceled
+			continue;
+		}
+
+		// No scene to place the path in. The request is still done with.
+		if (!BlockScene)
+		{
+			continue;
+		}
+
+		FNavPathResult NavResult;
+		NavResult.RequestId = Result.RequestId;
+		NavResult.bSuccess = Result.bSuccess;
+		NavResult.bPartial = Result.bPartial;
+		NavResult.Goal = Result.Goal;
+		NavResult.Path.Reserve(Result.Path.Num());
+
+		for (const FIntPoint& Cell : Result.Path)
+		{
+			NavResult.Path.Add(BlockScene->OriginSpaceGridToWorldSpace2D(Cell));
+		}
+
+		PendingRequest.OnComplete.ExecuteIfBound(NavResult);
+	}
+}
+
+const FSideScrollGraphSnapshotPtr& ANavigation::GetGraphSnapshot()
+{
+	if (!GraphSnapshot.IsValid())
+	{
+		GraphSnapshot = MakeShareable(new FSideScrollGraph(*Graph));
+	}
+
+	return GraphSnapshot;
+}
+
+uint32 ANavigation::AcquireFlowField(const TArray<FIntPoint>& Goals)
+{
+	if (Goals.Num() == 0)
+	{
+		return 0;
+	}
+
+	for (TPair<uint32, FSharedFlowField>& FlowField : FlowFields)
+	{
+		if (FlowField.Value.Field->GetGoals() == Goals)
+		{
+			++FlowField.Value.NumReferences;
+			return FlowField.Key;
+		}
+	}
+
+	// Skip 0 when wrapping
+	if (++LastFlowFieldId == 0)
+	{
+		++LastFlowFieldId;
+	}
+
+	FSharedFlowField& FlowField = FlowFields.Add(LastFlowFieldId);
+	FlowField.Field = MakeShareable(new FFlowField(*Graph, Goals));
+	FlowField.NumReferences = 1;
+
+	return LastFlowFieldId;
+}
+
+void ANavigation::ReleaseFlowField(uint32 FieldId)
+{
+	FSharedFlowField* FlowField = FlowFields.Find(FieldId);
+
+	if (!ensure(FlowField))
+	{
+		return;
+	}
+
+	if (--FlowField->NumReferences == 0)
+	{
+		FlowFields.Remove(FieldId);
+	}
+}
+
+const FFlowField* ANavigation::GetFlowField(uint32 FieldId) const
+{
+	const FSharedFlowField* FlowField = FlowFields.Find(FieldId);
+
+	return FlowField ? FlowField->Field.Get() : nullptr;
+}
+
+bool ANavigation::FindFlowFieldPath(uint32 FieldId, const FVector& StartLocation, FIntPoint& OutGoal, TArray<FVector2D>& OutPath) const
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+	const FFlowField* FlowField = GetFlowField(FieldId);
+
+	if (!ensure(BlockScene) || !ensure(FlowField))
+	{
+		return false;
+	}
+
+	TArray<int32> Path;
+
+	if (!FlowField->GetPath(BlockScene->WorldSpaceToOriginSpaceGrid(StartLocation), Path))
+	{
+		return false;
+	}
+
+	OutGoal = FIntPoint(Path.Last() % Graph->GetGridCountX(), Path.Last() / Graph->GetGridCountX());
+	StatesToWorldPath(*BlockScene, Path, OutPath);
+
+	return true;
+}
+
+void ANavigation::StatesToWorldPath(const UBlockActorScene& BlockScene, const TArray<void*>& Path, TArray<FVector2D>& OutPath) const
+{
+	for (int32 i = 0; i < Path.Num(); ++i)
+	{
+		FIntPoint Point = Graph->StateToVec2(Path[i]);
+		FVector2D WorldSpaceLocation = BlockScene.OriginSpaceGridToWorldSpace2D(Point);
+
+		OutPath.Add(WorldSpaceLocation);
+	}
+}
+
+void ANavigation::StatesToWorldPath(const UBlockActorScene& BlockScene, const TArray<int32>& Path, TArray<FVector2D>& OutPath) const
+{
+	const int32 GridCountX = Graph->GetGridCountX();
+
+	for (int32 i = 0; i < Path.Num(); ++i)
+	{
+		FIntPoint Point(Path[i] % GridCountX, Path[i] / GridCountX);
+		FVector2D WorldSpaceLocation = BlockScene.OriginSpaceGridToWorldSpace2D(Point);
+
+		OutPath.Add(WorldSpaceLocation);
+	}
+}
+
 bool ANavigation::IsValidLocation(const FVector& Location) const
 {
 	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
@@ -130,6 +743,47 @@ bool ANavigation::IsValidGridLocation(const FIntPoint& GridLocation) const
 	return (GraphValue == 0);
 }
 
+void ANavigation::GetCellsNextToGridLocation(const FIntPoint& TargetLocation, TArray<FIntPoint>& OutCells) const
+{
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!BlockScene)
+	{
+		return;
+	}
+
+	for (int32 X = -1; X <= 1; ++X)
+	{
+		for (int32 Y = -3; Y <= 1; ++Y)
+		{
+			if (X == 0 && Y == 0)
+			{
+				continue;
+			}
+
+			const FIntPoint Location = TargetLocation + FIntPoint(X, Y);
+
+			const bool bFoundValidNeighbor = IsValidGridLocation(Location);
+			const bool bHasFloor = BlockScene->HasBlock(Location.X, Location.Y - 1);
+
+			if (bFoundValidNeighbor && bHasFloor)
+			{
+				OutCells.Add(Location);
+			}
+		}
+	}
+}
+
+bool ANavigation::AreConnected(const FIntPoint& A, const FIntPoint& B) const
+{
+	return Graph->AreConnected(A, B);
+}
+
+int32 ANavigation::GetGridComponent(const FIntPoint& GridLocation) const
+{
+	return Graph->GetComponent(GridLocation.X, GridLocation.Y);
+}
+
 void ANavigation::DebugDraw() const
 {
 	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
@@ -148,7 +802,7 @@ void ANavigation::DebugDraw() const
 			const int32 Height = Graph->GetHeight(X, Y);
 
 			const int32 WorldGridX = BlockScene->OriginSpaceGridToWorldSpaceGridX(X);
-			const int32 WorldGridY = BlockScene->OriginSpaceGridToWorldSpaceGridX(Y);
+			const int32 WorldGridY = BlockScene->OriginSpaceGridToWorldSpaceGridY(Y);
 
 			const FVector WorldPosition(55, WorldGridX * BlockScene->GetGridCellSize(), WorldGridY * BlockScene->GetGridCellSize());
 
@@ -158,4 +812,11 @@ void ANavigation::DebugDraw() const
 			}
 		}
 	}
+
+	GEngine->AddOnScreenDebugMessage((uint64)(this + 0), 0, FColor::White,
+		FString::Printf(TEXT("Path Requests: %3d queued (max %3d), %3d in flight, %2d dispatched, wait %.1f ms (max %.1f ms), solve %.2f ms"),
+			RequestStats.QueueDepth, RequestStats.MaxQueueDepth, RequestStats.NumInFlight, RequestStats.NumDispatchedLastFrame,
+			RequestStats.AverageWaitMilliseconds, RequestStats.MaxWaitMilliseconds, RequestStats.AverageSolveMilliseconds));
+
+	GEngine->AddOnScreenDebugMessage((uint64)(this + 1), 0, FColor::White, FString::Printf(TEXT("Flow Fields: %d"), FlowFields.Num()));
 }
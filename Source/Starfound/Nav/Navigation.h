@@ -4,8 +4,72 @@
 #include "GameFramework/Actor.h"
 #include "SideScrollGraph.h"
 #include "Micropather.h"
+#include "TypedMicroPather.h"
+#include "HierarchicalGraph.h"
+#include "JumpPointGraph.h"
+#include "SpanGraph.h"
+#include "FlowField.h"
+#include "AsyncPathFinder.h"
 #include "Navigation.generated.h"
 
+// Selected with Starfound.Nav.Solver
+enum class ENavSolver : int32
+{
+	// A* over every cell
+	Flat,
+	// A* over cluster entrances, refined inside each cluster
+	Hierarchical,
+	// A* over jump points, optimal
+	JumpPoint,
+	// A* over the climb and drop cells of floor spans, optimal
+	Span,
+};
+
+struct FNavPathResult
+{
+	uint32 RequestId;
+	bool bSuccess;
+
+	// The search limits of the request stopped the solve before a goal. Path leads to the explored cell closest to the
+	// goals, and may be the start alone.
+	bool bPartial;
+
+	// Goal reached, or the end of a partial path. Origin space.
+	FIntPoint Goal;
+
+	// World space
+	TArray<FVector2D> Path;
+};
+
+DECLARE_DELEGATE_OneParam(FNavPathDelegate, const FNavPathResult&);
+
+// Queued async requests are dispatched in this order, oldest first within a priority
+enum class ENavRequestPriority : uint8
+{
+	// Player orders
+	High,
+	Normal,
+	// Job searches and other background work
+	Low,
+
+	Num
+};
+
+struct FNavRequestStats
+{
+	int32 QueueDepth;
+	int32 MaxQueueDepth;
+	int32 NumInFlight;
+	int32 NumDispatchedLastFrame;
+
+	// Time from request to dispatch
+	float AverageWaitMilliseconds;
+	float MaxWaitMilliseconds;
+
+	// Worker time per dispatch, a whole solve or one slice of it. The frame budget is spent in these.
+	float AverageSolveMilliseconds;
+};
+
 UCLASS()
 class ANavigation : public AActor
 {
@@ -14,18 +78,136 @@ class ANavigation : public AActor
 public:
 	ANavigation();
 
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Tick(float DeltaSeconds) override;
 
 	bool FindPath(const FVector& StartLocation, const FVector& TargetLocation, TArray<FVector2D>& OutPath);
 
+	// Cheapest path to whichever of the goal cells (origin space) is closest by path cost, from one search.
+	bool FindPathToAny(const FVector& StartLocation, const TArray<FIntPoint>& Goals, FIntPoint& OutGoal, TArray<FVector2D>& OutPath);
+
+	// Async versions of FindPath and FindPathToAny. Requests are queued by priority, and every frame Tick dispatches
+	// as many as fit in Starfound.Nav.FrameBudgetMs of estimated solve time. The solve runs on a worker thread against
+	// a snapshot of the graph and OnComplete is called on the game thread, from Tick. A dispatch expands at most
+	// Starfound.Nav.MaxExpansionsPerSlice nodes, so a long search is spread over several frames.
+	// Limits caps the whole search. A capped search that gives up answers with a partial path.
+	// Returns the request id, or 0 if the request wasn't made.
+	uint32 RequestPath(const FVector& StartLocation, const FVector& TargetLocation, const FNavPathDelegate& OnComplete,
+		ENavRequestPriority Priority = ENavRequestPriority::Normal, const MicroPanther::FSearchLimits& Limits = MicroPanther::FSearchLimits());
+	uint32 RequestPathToAny(const FVector& StartLocation, const TArray<FIntPoint>& Goals, const FNavPathDelegate& OnComplete,
+		ENavRequestPriority Priority = ENavRequestPriority::Normal, const MicroPanther::FSearchLimits& Limits = MicroPanther::FSearchLimits());
+
+	// OnComplete of the request won't be called
+	void CancelPathRequest(uint32 RequestId);
+
+	// Flow field to the goal cells (origin space), shared by everyone heading to the same goals. The field is computed
+	// once, kept up to date as blocks change, and freed when the last reference is released. Acquiring the goals of a
+	// live field adds a reference to it. Returns the field id, or 0 if there are no goals.
+	uint32 AcquireFlowField(const TArray<FIntPoint>& Goals);
+	void ReleaseFlowField(uint32 FieldId);
+
+	// Null once released by every holder
+	const FFlowField* GetFlowField(uint32 FieldId) const;
+
+	// Path from StartLocation to the nearest goal of the field, read off the field. False if no goal can be reached.
+	bool FindFlowFieldPath(uint32 FieldId, const FVector& StartLocation, FIntPoint& OutGoal, TArray<FVector2D>& OutPath) const;
+
 	bool IsValidLocation(const FVector& Location) const;
 	bool IsValidGridLocation(const FIntPoint& GridLocation) const;
 
+	// Cells a pawn can work on TargetLocation from. Origin space.
+	void GetCellsNextToGridLocation(const FIntPoint& TargetLocation, TArray<FIntPoint>& OutCells) const;
+
+	// False if no path can exist between the two grid locations (origin space). Constant time.
+	bool AreConnected(const FIntPoint& A, const FIntPoint& B) const;
+
+	// Connected component of a grid location (origin space), INDEX_NONE if blocked. Ids are never reused
+	// within a connectivity version.
+	int32 GetGridComponent(const FIntPoint& GridLocation) const;
+
+	// Bumped by every graph change that can make an unreachable cell reachable: a rebuild, a cell becoming
+	// walkable or getting floor right below it. A target found unreachable from a component stays unreachable
+	// from it until then.
+	uint32 GetConnectivityVersion() const { return ConnectivityVersion; }
+
+	const FNavRequestStats& GetRequestStats() const { return RequestStats; }
+
 	void DebugDraw() const;
 
 private:
 	void UpdateGraph();
+	void UpdateDirtyCells();
+	// Returns true if the height of the cell changed
+	bool UpdateGraphCell(const class UBlockActorScene& BlockScene, int32 X, int32 Y);
+
+	void OnBlockCellChanged(const FIntPoint& Cell);
+
+	void StatesToWorldPath(const class UBlockActorScene& BlockScene, const TArray<void*>& Path, TArray<FVector2D>& OutPath) const;
+	void StatesToWorldPath(const class UBlockActorScene& BlockScene, const TArray<int32>& Path, TArray<FVector2D>& OutPath) const;
+
+	// Start and goals in origin space
+	uint32 RequestPathInternal(const FIntPoint& Start, const TArray<FIntPoint>& Goals, const FNavPathDelegate& OnComplete, ENavRequestPriority Priority,
+		const MicroPanther::FSearchLimits& Limits);
+	void DispatchPathRequests();
+	void DeliverPathResults();
+	const FSideScrollGraphSnapshotPtr& GetGraphSnapshot();
+
+	// Block cells changed since the last update. Origin space.
+	TArray<FIntPoint> DirtyBlockCells;
+	bool bGraphRebuildNeeded;
+
+	// Nav cells whose height changed in UpdateDirtyCells, kept to reduce memory allocation
+	TArray<FIntPoint> ChangedGraphCells;
+
+	// Cell bit rows classified by UpdateGraph, kept to reduce memory allocation
+	TArray<uint64> WalkableBits;
+	TArray<uint64> ClimbBits;
+
+	uint32 ConnectivityVersion;
 
 	TUniquePtr<FSideScrollGraph> Graph;
-	TUniquePtr<MicroPanther::FMicroPather> MicroPather;
+	TUniquePtr<TMicroPather<FSideScrollGraph>> MicroPather;
+	// Path of the last MicroPather solve, kept to reduce memory allocation
+	TArray<int32> TypedPath;
+	TUniquePtr<FHierarchicalGraph> HierarchicalGraph;
+	TUniquePtr<FJumpPointGraph> JumpPointGraph;
+	TUniquePtr<FSpanGraph> SpanGraph;
+
+	// Copy of Graph for async requests. Shares the table pages that Graph hasn't written since. Made on demand,
+	// dropped when Graph changes.
+	FSideScrollGraphSnapshotPtr GraphSnapshot;
+
+	TUniquePtr<FAsyncPathFinder> AsyncPathFinder;
+	struct FPendingPathRequest
+	{
+		FNavPathDelegate OnComplete;
+		ENavRequestPriority Priority;
+	};
+
+	TMap<uint32, FPendingPathRequest> PendingPathRequests;
+	uint32 LastPathRequestId;
+
+	struct FQueuedPathRequest
+	{
+		FAsyncPathRequest Request;
+
+		// Set for the rest of a search that ran out of expansions. Only Request.RequestId is used then.
+		FAsyncPathSearchPtr Search;
+
+		double QueuedTime;
+	};
+
+	TArray<FQueuedPathRequest> QueuedPathRequests[(int32)ENavRequestPriority::Num];
+
+	FNavRequestStats RequestStats;
+
+	struct FSharedFlowField
+	{
+		TSharedPtr<FFlowField> Field;
+		int32 NumReferences;
+	};
+
+	TMap<uint32, FSharedFlowField> FlowFields;
+	uint32 LastFlowFieldId;
 };
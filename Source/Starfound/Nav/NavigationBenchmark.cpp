@@ -0,0 +1,442 @@
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "SideScrollGraph.h"
+#include "Micropather.h"
+#include "TypedMicroPather.h"
+#include "HierarchicalGraph.h"
+#include "JumpPointGraph.h"
+#include "SpanGraph.h"
+#include "Navigation.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStarfoundNavBenchmark, Log, All);
+
+/**
+ * Navigation benchmarks. They run on generated grids, so they don't need a world.
+ *
+ * Starfound.Nav.Benchmark [GridSize] [CavePercentage] [NumQueries] [Seed]
+ */
+namespace StarfoundNavBenchmark
+{
+	struct FBenchmarkMap
+	{
+		int32 GridSize;
+		TArray<bool> Blocks;
+		TArray<FIntPoint> WalkableCells;
+
+		bool IsBlock(int32 X, int32 Y) const
+		{
+			if (X < 0 || X >= GridSize || Y < 0 || Y >= GridSize)
+			{
+				return false;
+			}
+
+			return Blocks[X + (Y * GridSize)];
+		}
+	};
+
+	// Rolling terrain with caves (CavePercentage of the underground is dug out), classified with the
+	// same floor, headroom and wall rules as ANavigation::UpdateGraph
+	static void GenerateMap(FSideScrollGraph& Graph, FBenchmarkMap& Map, int32 GridSize, int32 CavePercentage, FRandomStream& Random)
+	{
+		Map.GridSize = GridSize;
+		Map.Blocks.SetNumZeroed(GridSize * GridSize);
+		Map.WalkableCells.Reset();
+
+		int32 Surface = GridSize / 2;
+
+		for (int32 X = 0; X < GridSize; ++X)
+		{
+			Surface = FMath::Clamp(Surface + Random.RandRange(-1, 1), GridSize / 4, (GridSize * 3) / 4);
+
+			for (int32 Y = 0; Y <= Surface; ++Y)
+			{
+				const bool bCave = (Y < Surface - 1) && (Random.RandRange(0, 99) < CavePercentage);
+
+				Map.Blocks[X + (Y * GridSize)] = !bCave;
+			}
+		}
+
+		Graph.InitializeGrid(GridSize, GridSize);
+
+		for (int32 X = 0; X < GridSize; ++X)
+		{
+			for (int32 Y = 0; Y < GridSize; ++Y)
+			{
+				const bool bFloor1 = Map.IsBlock(X, Y - 1);
+				const bool bHasFloor = bFloor1
+					|| (Map.IsBlock(X, Y - 2) && (Map.IsBlock(X - 1, Y - 1) || Map.IsBlock(X + 1, Y - 1)));
+
+				if (Map.IsBlock(X, Y) || !bHasFloor || Map.IsBlock(X, Y + 1))
+				{
+					Graph.SetHeight(X, Y, -1);
+				}
+				else
+				{
+					Graph.SetHeight(X, Y, bFloor1 ? 0 : 1);
+					Map.WalkableCells.Add(FIntPoint(X, Y));
+				}
+			}
+		}
+
+		Graph.RebuildComponents();
+		Graph.RebuildLandmarks();
+	}
+
+	// Every cell walkable. Worst case for the open set size.
+	static void GenerateOpenMap(FSideScrollGraph& Graph, FBenchmarkMap& Map, int32 GridSize)
+	{
+		Map.GridSize = GridSize;
+		Map.Blocks.SetNumZeroed(GridSize * GridSize);
+		Map.WalkableCells.Reset();
+
+		Graph.InitializeGrid(GridSize, GridSize);
+
+		for (int32 Y = 0; Y < GridSize; ++Y)
+		{
+			for (int32 X = 0; X < GridSize; ++X)
+			{
+				Map.WalkableCells.Add(FIntPoint(X, Y));
+			}
+		}
+	}
+
+	static void RunOpenQueueBenchmark(FSideScrollGraph& Graph, const FBenchmarkMap& Map, int32 NumQueries, int32 Seed)
+	{
+		const TCHAR* QueueNames[] = { TEXT("SortedList"), TEXT("BinaryHeap"), TEXT("BucketQueue") };
+		const MicroPanther::EOpenQueueType QueueTypes[] = {
+			MicroPanther::EOpenQueueType::SortedList,
+			MicroPanther::EOpenQueueType::BinaryHeap,
+			MicroPanther::EOpenQueueType::BucketQueue };
+
+		for (int32 QueueIndex = 0; QueueIndex < ARRAY_COUNT(QueueTypes); ++QueueIndex)
+		{
+			MicroPanther::FMicroPather Pather(&Graph, FMath::Max(250, Map.WalkableCells.Num() / 4), 4, false, QueueTypes[QueueIndex]);
+
+			// Same queries for every queue
+			FRandomStream QueryRandom(Seed);
+
+			TArray<void*> Path;
+			int64 NumExpanded = 0;
+			int32 NumSolved = 0;
+			double TotalCost = 0;
+
+			const double StartTime = FPlatformTime::Seconds();
+
+			for (int32 Query = 0; Query < NumQueries; ++Query)
+			{
+				const FIntPoint Start = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+				const FIntPoint End = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+
+				float Cost = 0;
+				const int32 Result = Pather.Solve(Graph.Vec2ToState(Start), Graph.Vec2ToState(End), &Path, &Cost);
+
+				NumExpanded += Pather.GetNumExpandedNodes();
+
+				if (Result == MicroPanther::FMicroPather::SOLVED)
+				{
+					++NumSolved;
+					TotalCost += Cost;
+				}
+			}
+
+			const double Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime, 1e-9);
+
+			// Node arrays of the pool. Dense graphs have a node per state, so this is what a search can touch.
+			const SIZE_T NodeBytes = Pather.Debug_GetPathNodeBytes();
+			const int32 NumNodes = FMath::Max(Pather.Debug_GetNumPathNodes(), 1);
+
+			UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("  %-12s %8.2f ms  %10lld expansions  %12.0f expansions/s  solved %d/%d  cost sum %.0f  nodes %.1f MB, %d bytes/node"),
+				QueueNames[QueueIndex], Seconds * 1000.0, NumExpanded, NumExpanded / Seconds, NumSolved, NumQueries, TotalCost,
+				NodeBytes / (1024.0 * 1024.0), (int32)(NodeBytes / NumNodes));
+		}
+
+		// Binary heap A* specialised on FSideScrollGraph
+		{
+			TMicroPather<FSideScrollGraph> Pather(&Graph);
+
+			FRandomStream QueryRandom(Seed);
+
+			TArray<int32> Path;
+			int64 NumExpanded = 0;
+			int32 NumSolved = 0;
+			double TotalCost = 0;
+
+			const double StartTime = FPlatformTime::Seconds();
+
+			for (int32 Query = 0; Query < NumQueries; ++Query)
+			{
+				const FIntPoint Start = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+				const FIntPoint End = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+
+				float Cost = 0;
+				const int32 Result = Pather.Solve(Start.X + (Start.Y * Map.GridSize), End.X + (End.Y * Map.GridSize), Path, Cost);
+
+				NumExpanded += Pather.GetNumExpandedNodes();
+
+				if (Result == MicroPanther::FMicroPather::SOLVED)
+				{
+					++NumSolved;
+					TotalCost += Cost;
+				}
+			}
+
+			const double Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime, 1e-9);
+
+			UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("  %-12s %8.2f ms  %10lld expansions  %12.0f expansions/s  solved %d/%d  cost sum %.0f"),
+				TEXT("Typed"), Seconds * 1000.0, NumExpanded, NumExpanded / Seconds, NumSolved, NumQueries, TotalCost);
+		}
+	}
+
+	// Flat A* against HPA*, JPS and spans on connected pairs. Cost sums show how far HPA* is from optimal.
+	// JPS and spans are optimal, so every one of their costs must match flat A*, and a query that doesn't is logged.
+	static void RunSolverBenchmark(FSideScrollGraph& Graph, const FBenchmarkMap& Map, int32 NumQueries, int32 Seed)
+	{
+		MicroPanther::FMicroPather Pather(&Graph, FMath::Max(250, Map.WalkableCells.Num() / 4), 4, false, MicroPanther::EOpenQueueType::BinaryHeap);
+
+		const double BuildStartTime = FPlatformTime::Seconds();
+
+		FHierarchicalGraph HierarchicalGraph(Graph);
+		HierarchicalGraph.Rebuild();
+
+		UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("  Hierarchical build %.2f ms, %d nodes"),
+			(FPlatformTime::Seconds() - BuildStartTime) * 1000.0, HierarchicalGraph.GetNumNodes());
+
+		FJumpPointGraph JumpPointGraph(Graph);
+
+		const double SpanBuildStartTime = FPlatformTime::Seconds();
+
+		FSpanGraph SpanGraph(Graph);
+		SpanGraph.Rebuild();
+
+		UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("  Span build %.2f ms, %d spans, %d nodes"),
+			(FPlatformTime::Seconds() - SpanBuildStartTime) * 1000.0, SpanGraph.GetNumSpans(), SpanGraph.GetNumNodes());
+
+		const TCHAR* SolverNames[] = { TEXT("Flat"), TEXT("Hierarchical"), TEXT("JumpPoint"), TEXT("Span") };
+
+		// Cost of each query by flat A*, FLT_MAX if it wasn't solved. Flat runs first.
+		TArray<float> FlatCosts;
+		FlatCosts.Init(FLT_MAX, NumQueries);
+
+		for (int32 SolverIndex = 0; SolverIndex < ARRAY_COUNT(SolverNames); ++SolverIndex)
+		{
+			FRandomStream QueryRandom(Seed);
+
+			TArray<void*> Path;
+			int64 NumExpanded = 0;
+			int32 NumSolved = 0;
+			int32 NumConnected = 0;
+			int32 NumCostMismatches = 0;
+			double TotalCost = 0;
+			double Seconds = 0;
+
+			const bool bOptimalSolver = SolverIndex == (int32)ENavSolver::JumpPoint || SolverIndex == (int32)ENavSolver::Span;
+
+			for (int32 Query = 0; Query < NumQueries; ++Query)
+			{
+				const FIntPoint Start = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+				const FIntPoint End = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+
+				if (!Graph.AreConnected(Start, End))
+				{
+					continue;
+				}
+
+				++NumConnected;
+
+				float Cost = 0;
+				int32 Result;
+
+				const double StartTime = FPlatformTime::Seconds();
+
+				if (SolverIndex == (int32)ENavSolver::Hierarchical)
+				{
+					Result = HierarchicalGraph.FindPath(Start, End, Path, Cost);
+					NumExpanded += HierarchicalGraph.GetNumExpandedNodes();
+				}
+				else if (SolverIndex == (int32)ENavSolver::JumpPoint)
+				{
+					Result = JumpPointGraph.FindPath(Start, End, Path, Cost);
+					NumExpanded += JumpPointGraph.GetNumExpandedNodes();
+				}
+				else if (SolverIndex == (int32)ENavSolver::Span)
+				{
+					Result = SpanGraph.FindPath(Start, End, Path, Cost);
+					NumExpanded += SpanGraph.GetNumExpandedNodes();
+				}
+				else
+				{
+					Result = Pather.Solve(Graph.Vec2ToState(Start), Graph.Vec2ToState(End), &Path, &Cost);
+					NumExpanded += Pather.GetNumExpandedNodes();
+				}
+
+				Seconds += FPlatformTime::Seconds() - StartTime;
+
+				if (Result == MicroPanther::FMicroPather::SOLVED)
+				{
+					++NumSolved;
+					TotalCost += Cost;
+				}
+
+				const float SolvedCost = (Result == MicroPanther::FMicroPather::SOLVED) ? Cost : FLT_MAX;
+
+				if (SolverIndex == (int32)ENavSolver::Flat)
+				{
+					FlatCosts[Query] = SolvedCost;
+				}
+				else if (bOptimalSolver && SolvedCost != FlatCosts[Query])
+				{
+					++NumCostMismatches;
+
+					UE_LOG(LogStarfoundNavBenchmark, Warning, TEXT("  %s cost %.0f, flat A* %.0f, from (%d,%d) to (%d,%d)"),
+						SolverNames[SolverIndex], SolvedCost, FlatCosts[Query], Start.X, Start.Y, End.X, End.Y);
+				}
+			}
+
+			UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("  %-12s %8.2f ms  %10lld expansions  solved %d/%d  cost sum %.0f"),
+				SolverNames[SolverIndex], Seconds * 1000.0, NumExpanded, NumSolved, NumConnected, TotalCost);
+
+			if (NumCostMismatches > 0)
+			{
+				UE_LOG(LogStarfoundNavBenchmark, Warning, TEXT("  %s costs differ from flat A* on %d of %d queries"),
+					SolverNames[SolverIndex], NumCostMismatches, NumConnected);
+			}
+		}
+
+		// Pawns ask for the same cells again, after a move failed or on their next think. Unconnected pairs too,
+		// so cached no solutions count. Only the abstract search of HPA* has a path cache.
+		{
+			FRandomStream QueryRandom(Seed);
+
+			MicroPanther::FCacheData CacheBefore;
+			HierarchicalGraph.GetCacheData(&CacheBefore);
+
+			TArray<void*> Path;
+			double Seconds = 0;
+
+			for (int32 Query = 0; Query < NumQueries; ++Query)
+			{
+				const FIntPoint Start = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+				const FIntPoint End = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+
+				for (int32 Repeat = 0; Repeat < 2; ++Repeat)
+				{
+					float Cost = 0;
+
+					const double StartTime = FPlatformTime::Seconds();
+					HierarchicalGraph.FindPath(Start, End, Path, Cost);
+					Seconds += FPlatformTime::Seconds() - StartTime;
+				}
+			}
+
+			MicroPanther::FCacheData CacheAfter;
+			HierarchicalGraph.GetCacheData(&CacheAfter);
+
+			const int32 NumHit = CacheAfter.NumHit - CacheBefore.NumHit;
+			const int32 NumLookups = NumHit + CacheAfter.NumMiss - CacheBefore.NumMiss;
+
+			UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("  %-12s %8.2f ms  every query twice, path cache hit %d/%d (%.1f%%)"),
+				TEXT("Hierarchical"), Seconds * 1000.0, NumHit, NumLookups, NumLookups > 0 ? (NumHit * 100.0) / NumLookups : 0.0);
+		}
+	}
+
+	// Flat A* with Manhattan distance against landmark estimates, on the same connected pairs
+	static void RunHeuristicBenchmark(FSideScrollGraph& Graph, const FBenchmarkMap& Map, int32 NumQueries, int32 Seed)
+	{
+		const double BuildStartTime = FPlatformTime::Seconds();
+
+		Graph.RebuildLandmarks();
+
+		UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("  Landmark build %.2f ms, %d landmarks"),
+			(FPlatformTime::Seconds() - BuildStartTime) * 1000.0, Graph.GetNumLandmarks());
+
+		const TCHAR* HeuristicNames[] = { TEXT("Manhattan"), TEXT("Landmarks") };
+
+		for (int32 HeuristicIndex = 0; HeuristicIndex < ARRAY_COUNT(HeuristicNames); ++HeuristicIndex)
+		{
+			Graph.SetUseLandmarks(HeuristicIndex == 1);
+
+			MicroPanther::FMicroPather Pather(&Graph, FMath::Max(250, Map.WalkableCells.Num() / 4), 4, false, MicroPanther::EOpenQueueType::BinaryHeap);
+
+			FRandomStream QueryRandom(Seed);
+
+			TArray<void*> Path;
+			int64 NumExpanded = 0;
+			int32 NumConnected = 0;
+			double TotalCost = 0;
+			double Seconds = 0;
+
+			for (int32 Query = 0; Query < NumQueries; ++Query)
+			{
+				const FIntPoint Start = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+				const FIntPoint End = Map.WalkableCells[QueryRandom.RandRange(0, Map.WalkableCells.Num() - 1)];
+
+				if (!Graph.AreConnected(Start, End))
+				{
+					continue;
+				}
+
+				++NumConnected;
+
+				float Cost = 0;
+				const double StartTime = FPlatformTime::Seconds();
+
+				if (Pather.Solve(Graph.Vec2ToState(Start), Graph.Vec2ToState(End), &Path, &Cost) == MicroPanther::FMicroPather::SOLVED)
+				{
+					TotalCost += Cost;
+				}
+
+				Seconds += FPlatformTime::Seconds() - StartTime;
+				NumExpanded += Pather.GetNumExpandedNodes();
+			}
+
+			UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("  %-12s %8.2f ms  %10lld expansions  %8.1f expansions/query  cost sum %.0f"),
+				HeuristicNames[HeuristicIndex], Seconds * 1000.0, NumExpanded, NumExpanded / (double)FMath::Max(NumConnected, 1), TotalCost);
+		}
+
+		Graph.SetUseLandmarks(true);
+	}
+
+	static void RunBenchmark(const TArray<FString>& Args)
+	{
+		const int32 GridSize = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 201;
+		const int32 CavePercentage = (Args.Num() > 1) ? FCString::Atoi(*Args[1]) : 30;
+		const int32 NumQueries = (Args.Num() > 2) ? FCString::Atoi(*Args[2]) : 200;
+		const int32 Seed = (Args.Num() > 3) ? FCString::Atoi(*Args[3]) : 1234;
+
+		FRandomStream MapRandom(Seed);
+		FSideScrollGraph Graph;
+		FBenchmarkMap Map;
+
+		GenerateMap(Graph, Map, GridSize, CavePercentage, MapRandom);
+
+		UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("Navigation benchmark. %dx%d grid, %d%% caves, %d walkable cells, %d queries"),
+			GridSize, GridSize, CavePercentage, Map.WalkableCells.Num(), NumQueries);
+
+		if (Map.WalkableCells.Num() == 0)
+		{
+			return;
+		}
+
+		UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("Open queue, generated map:"));
+		RunOpenQueueBenchmark(Graph, Map, NumQueries, Seed);
+
+		UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("Solver, generated map:"));
+		RunSolverBenchmark(Graph, Map, NumQueries, Seed);
+
+		UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("Heuristic, generated map:"));
+		RunHeuristicBenchmark(Graph, Map, NumQueries, Seed);
+
+		FSideScrollGraph OpenGraph;
+		FBenchmarkMap OpenMap;
+		GenerateOpenMap(OpenGraph, OpenMap, GridSize);
+
+		UE_LOG(LogStarfoundNavBenchmark, Display, TEXT("Open queue, open map:"));
+		RunOpenQueueBenchmark(OpenGraph, OpenMap, NumQueries, Seed);
+	}
+}
+
+static FAutoConsoleCommand NavBenchmarkCommand(
+	TEXT("Starfound.Nav.Benchmark"),
+	TEXT("Runs path finding benchmarks on a generated grid. Args: [GridSize=201] [CavePercentage=30] [NumQueries=200] [Seed=1234]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&StarfoundNavBenchmark::RunBenchmark));
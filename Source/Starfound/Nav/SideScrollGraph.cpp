@@ -1,70 +1,191 @@
 #include "SideScrollGraph.h"
 
+// Landmark cells. Each costs 2 bytes per cell and a few reads per estimate.
+static const int32 NumLandmarksToPlace = 8;
+
+// UpdateLandmarks rebuilds after this many changed cells, since blocked cells leave the distances looser
+static const int32 LandmarkRebuildChanges = 1024;
+
+// Cells per side of a version region
+static const int32 RegionShift = 4;
+static const int32 RegionSize = 1 << RegionShift;
+
+const uint16 FSideScrollGraph::UnreachedLandmarkDistance;
+const uint16 FSideScrollGraph::MaxLandmarkDistance;
+
 FSideScrollGraph::FSideScrollGraph()
 {
 	GridCountX = 0;
 	GridCountY = 0;
+	NumRowWords = 0;
+	NumRegionsX = 0;
+	GraphVersion = 0;
+	NextComponent = 0;
+	NumLandmarkChanges = 0;
+	bUseLandmarks = true;
 }
 
 void FSideScrollGraph::InitializeGrid(int32 InGridCountX, int32 InGridCountY)
 {
 	GridCountX = InGridCountX;
 	GridCountY = InGridCountY;
+	NumRowWords = (GridCountX + 63) / 64;
+
+	// Every cell starts at height 0
+	WalkableBits.Init(MAX_uint64, NumRowWords * GridCountY);
+	ClimbBits.Init(0, NumRowWords * GridCountY);
+
+	if (GridCountX % 64 != 0)
+	{
+		for (int32 Y = 0; Y < GridCountY; ++Y)
+		{
+			WalkableBits[(Y * NumRowWords) + NumRowWords - 1] = (1ull << (GridCountX % 64)) - 1;
+		}
+	}
+
+	const FEdge NoEdge = { INDEX_NONE, 0.0f };
+
+	Edges.Init(NoEdge, GridCountX * GridCountY * MaxEdges);
+	NumEdges.Init(0, GridCountX * GridCountY);
+
+	NumRegionsX = (GridCountX + RegionSize - 1) / RegionSize;
+	RegionVersions.SetNumUninitialized(NumRegionsX * ((GridCountY + RegionSize - 1) / RegionSize));
 
-	Heights.Init(0, GridCountX * GridCountY);
+	UpdateAllCells();
+
+	// Everything walkable is one big component
+	Components.Init(0, GridCountX * GridCountY);
+	NextComponent = 1;
+
+	Landmarks.Reset();
+	LandmarkDistances.Reset();
+	NumLandmarkChanges = 0;
 }
 
 void FSideScrollGraph::SetHeight(int32 X, int32 Y, int32 NewHeight)
 {
-	if (X < 0 || X > GridCountX || Y < 0 || Y > GridCountY)
+	if (X < 0 || X >= GridCountX || Y < 0 || Y >= GridCountY)
 	{
 		ensure(0);
 		return;
 	}
 
-	Heights[X + (Y * GridCountX)] = NewHeight;
+	const int32 Word = (Y * NumRowWords) + (X >> 6);
+	const uint64 Bit = 1ull << (X & 63);
+
+	const bool bWasBlocked = !(WalkableBits[Word] & Bit);
+
+	WalkableBits[Word] = (NewHeight != -1) ? (WalkableBits[Word] | Bit) : (WalkableBits[Word] & ~Bit);
+	ClimbBits[Word] = (NewHeight > 0) ? (ClimbBits[Word] | Bit) : (ClimbBits[Word] & ~Bit);
+
+	// Neighbors only care whether the cell is blocked
+	if (bWasBlocked == (NewHeight == -1))
+	{
+		return;
+	}
+
+	++GraphVersion;
+
+	const FIntPoint Cells[] = { {X, Y}, {X + 1, Y}, {X - 1, Y}, {X, Y + 1}, {X, Y - 1} };
+
+	for (const FIntPoint& Cell : Cells)
+	{
+		if (Cell.X >= 0 && Cell.X < GridCountX && Cell.Y >= 0 && Cell.Y < GridCountY)
+		{
+			RegionVersions[(Cell.X >> RegionShift) + ((Cell.Y >> RegionShift) * NumRegionsX)] = GraphVersion;
+
+			if (Cell != FIntPoint(X, Y))
+			{
+				UpdateEdges(Cell.X, Cell.Y);
+			}
+		}
+	}
 }
 
-float FSideScrollGraph::LeastCostEstimate(void* StartState, void* EndState)
+void FSideScrollGraph::SetCells(const TArray<uint64>& InWalkableBits, const TArray<uint64>& InClimbBits)
 {
-	FIntPoint StartPosition = StateToVec2(StartState);
-	FIntPoint EndPosition = StateToVec2(EndState);
+	if (!ensure(InWalkableBits.Num() == NumRowWords * GridCountY && InClimbBits.Num() == NumRowWords * GridCountY))
+	{
+		return;
+	}
 
-	// TODO : need square root here, but we are trying not to use floating point. so...
-	// WARN : without square root, comparison can be wrong. (a + b)^2 != a^2 + b^2
-	int32 Cost = (StartPosition - EndPosition).SizeSquared();
+	WalkableBits = InWalkableBits;
+	ClimbBits = InClimbBits;
 
-	return Cost;
+	UpdateAllCells();
 }
 
-void FSideScrollGraph::AdjacentCost(void* State, TArray<MicroPanther::FStateCost>* AdjacentCosts)
+void FSideScrollGraph::UpdateAllCells()
 {
-	//const int32 AdjacentX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
-	//const int32 AdjacentY[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
-	//const int32 Costs[8] = { 1, 2, 1, 2, 1, 2, 1, 2 };
-
-	const int32 AdjacentX[]		= { 1, 0, -1, 0 };
-	const int32 AdjacentY[]		= { 0, 1, 0, -1 };
-	const int32 Costs[]			= { 1, 1, 1, 1 };
+	for (int32 Y = 0; Y < GridCountY; ++Y)
+	{
+		for (int32 X = 0; X < GridCountX; ++X)
+		{
+			UpdateEdges(X, Y);
+		}
+	}
 
-	FIntPoint Position = StateToVec2(State);
+	// Every state changed
+	++GraphVersion;
 
-	for (int i = 0; i < ARRAY_COUNT(Costs); ++i)
+	for (uint32& RegionVersion : RegionVersions)
 	{
-		FIntPoint AdjacentPosition(Position.X + AdjacentX[i], Position.Y + AdjacentY[i]);
+		RegionVersion = GraphVersion;
+	}
+}
 
-		int Height = GetHeight(AdjacentPosition.X, AdjacentPosition.Y);
+void FSideScrollGraph::UpdateEdges(int32 X, int32 Y)
+{
+	const int32 State = X + (Y * GridCountX);
 
-		if (Height != -1)
-		{
-			// Not Blocked
-			void* AdjacentState = Vec2ToState(AdjacentPosition);
+	// +X, +Y, -X, -Y
+	const bool bWalkable[MaxEdges] =
+	{
+		X + 1 < GridCountX && IsWalkable(X + 1, Y),
+		Y + 1 < GridCountY && IsWalkable(X, Y + 1),
+		X > 0 && IsWalkable(X - 1, Y),
+		Y > 0 && IsWalkable(X, Y - 1)
+	};
+	const int32 Offsets[MaxEdges] = { 1, GridCountX, -1, -GridCountX };
+
+	static_assert(TCopyOnWriteArray<FEdge>::PageSize % MaxEdges == 0, "Edge rows must not cross a page");
 
-			MicroPanther::FStateCost Cost = { AdjacentState, Costs[i] };
+	FEdge* Row = &Edges.GetMutable(State * MaxEdges);
+	int32 NumRowEdges = 0;
 
-			AdjacentCosts->Add(Cost);
+	for (int32 i = 0; i < MaxEdges; ++i)
+	{
+		if (bWalkable[i])
+		{
+			// Every move costs 1, climbing to a height 1 cell too. Cluster searches and landmarks count moves.
+			Row[NumRowEdges].State = State + Offsets[i];
+			Row[NumRowEdges].Cost = 1.0f;
+			++NumRowEdges;
 		}
 	}
+
+	NumEdges.GetMutable(State) = (uint8)NumRowEdges;
+}
+
+uint32 FSideScrollGraph::GetStateVersion(void* State) const
+{
+	const int32 Index = (int32)(intptr_t)State;
+
+	return RegionVersions[((Index % GridCountX) >> RegionShift) + (((Index / GridCountX) >> RegionShift) * NumRegionsX)];
+}
+
+float FSideScrollGraph::LeastCostEstimate(void* StartState, void* EndState)
+{
+	return EstimateCost((int32)(intptr_t)StartState, (int32)(intptr_t)EndState);
+}
+
+void FSideScrollGraph::AdjacentCost(void* State, TArray<MicroPanther::FStateCost>* AdjacentCosts)
+{
+	ForEachAdjacent((int32)(intptr_t)State, [AdjacentCosts](int32 AdjacentState, float Cost)
+	{
+		MicroPanther::FStateCost StateCost = { (void*)(intptr_t)AdjacentState, Cost };
+		AdjacentCosts->Add(StateCost);
+	});
 }
 
 void FSideScrollGraph::PrintStateInfo(void* /*State*/)
@@ -104,5 +225,338 @@ int32 FSideScrollGraph::GetHeight(int32 X, int32 Y) const
 		return -1;
 	}
 
-	return Heights[X + (Y * GridCountX)];
+	const int32 Word = (Y * NumRowWords) + (X >> 6);
+
+	if (!((WalkableBits[Word] >> (X & 63)) & 1))
+	{
+		return -1;
+	}
+
+	return (ClimbBits[Word] >> (X & 63)) & 1;
+}
+
+int32 FSideScrollGraph::GetComponent(int32 X, int32 Y) const
+{
+	if (X < 0 || X >= GridCountX || Y < 0 || Y >= GridCountY)
+	{
+		return INDEX_NONE;
+	}
+
+	return Components[X + (Y * GridCountX)];
+}
+
+bool FSideScrollGraph::AreConnected(const FIntPoint& Start, const FIntPoint& End) const
+{
+	const int32 EndComponent = GetComponent(End.X, End.Y);
+
+	if (EndComponent == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const int32 StartComponent = GetComponent(Start.X, Start.Y);
+
+	if (StartComponent != INDEX_NONE)
+	{
+		return StartComponent == EndComponent;
+	}
+
+	if (Start.X < 0 || Start.X >= GridCountX || Start.Y < 0 || Start.Y >= GridCountY)
+	{
+		return false;
+	}
+
+	// Standing in a blocked cell. Every walkable neighbor is one step away.
+	return GetComponent(Start.X + 1, Start.Y) == EndComponent
+		|| GetComponent(Start.X - 1, Start.Y) == EndComponent
+		|| GetComponent(Start.X, Start.Y + 1) == EndComponent
+		|| GetComponent(Start.X, Start.Y - 1) == EndComponent;
+}
+
+void FSideScrollGraph::RebuildComponents()
+{
+	Components.Init(INDEX_NONE, GridCountX * GridCountY);
+
+	NextComponent = 0;
+
+	for (int32 Y = 0; Y < GridCountY; ++Y)
+	{
+		for (int32 X = 0; X < GridCountX; ++X)
+		{
+			const int32 Index = X + (Y * GridCountX);
+
+			if (IsWalkable(X, Y) && Components[Index] == INDEX_NONE)
+			{
+				FloodComponent(FIntPoint(X, Y), NextComponent++);
+			}
+		}
+	}
+}
+
+void FSideScrollGraph::UpdateComponents(const TArray<FIntPoint>& ChangedCells)
+{
+	// Every piece of a component that was split or merged touches a changed cell, so
+	// flooding from the changed cells and their neighbors relabels all of them.
+	// Components that don't touch a changed cell keep their id.
+	const FIntPoint SeedOffsets[] = { {0, 0}, {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+
+	for (const FIntPoint& Cell : ChangedCells)
+	{
+		for (const FIntPoint& Offset : SeedOffsets)
+		{
+			const FIntPoint Seed = Cell + Offset;
+
+			if (Seed.X >= 0 && Seed.X < GridCountX && Seed.Y >= 0 && Seed.Y < GridCountY)
+			{
+				Components.GetMutable(Seed.X + (Seed.Y * GridCountX)) = INDEX_NONE;
+			}
+		}
+	}
+
+	for (const FIntPoint& Cell : ChangedCells)
+	{
+		for (const FIntPoint& Offset : SeedOffsets)
+		{
+			const FIntPoint Seed = Cell + Offset;
+
+			if (GetHeight(Seed.X, Seed.Y) != -1 && GetComponent(Seed.X, Seed.Y) == INDEX_NONE)
+			{
+				FloodComponent(Seed, NextComponent++);
+			}
+		}
+	}
+}
+
+void FSideScrollGraph::FloodComponent(const FIntPoint& Seed, int32 Component)
+{
+	const int32 AdjacentX[] = { 1, 0, -1, 0 };
+	const int32 AdjacentY[] = { 0, 1, 0, -1 };
+
+	// Relabel everything reachable, whatever its old id was
+	TArray<FIntPoint>& FloodStack = Scratch.FloodStack;
+
+	FloodStack.Reset();
+	FloodStack.Add(Seed);
+	Components.GetMutable(Seed.X + (Seed.Y * GridCountX)) = Component;
+
+	while (FloodStack.Num() > 0)
+	{
+		const FIntPoint Cell = FloodStack.Pop(false);
+
+		for (int32 i = 0; i < ARRAY_COUNT(AdjacentX); ++i)
+		{
+			const FIntPoint AdjacentCell(Cell.X + AdjacentX[i], Cell.Y + AdjacentY[i]);
+
+			if (GetHeight(AdjacentCell.X, AdjacentCell.Y) == -1)
+			{
+				continue;
+			}
+
+			const int32 AdjacentIndex = AdjacentCell.X + (AdjacentCell.Y * GridCountX);
+
+			if (Components[AdjacentIndex] != Component)
+			{
+				Components.GetMutable(AdjacentIndex) = Component;
+				FloodStack.Add(AdjacentCell);
+			}
+		}
+	}
+}
+
+void FSideScrollGraph::RebuildLandmarks()
+{
+	const int32 NumCells = GridCountX * GridCountY;
+
+	Landmarks.Reset();
+	LandmarkDistances.Reset();
+	NumLandmarkChanges = 0;
+
+	// Landmarks only help inside their component, so they all go to the largest one
+	TMap<int32, int32> ComponentSizes;
+	int32 LargestComponent = INDEX_NONE;
+	int32 LargestComponentSize = 0;
+	int32 FirstCell = INDEX_NONE;
+
+	for (int32 Index = 0; Index < NumCells; ++Index)
+	{
+		if (!IsWalkable(Index % GridCountX, Index / GridCountX))
+		{
+			continue;
+		}
+
+		const int32 Size = ++ComponentSizes.FindOrAdd(Components[Index]);
+
+		if (Size > LargestComponentSize)
+		{
+			LargestComponent = Components[Index];
+			LargestComponentSize = Size;
+			FirstCell = Index;
+		}
+	}
+
+	if (LargestComponent == INDEX_NONE)
+	{
+		return;
+	}
+
+	// Farthest point placement. The first landmark is the cell farthest from an arbitrary one,
+	// every next one the cell farthest from all landmarks placed so far.
+	TCopyOnWriteArray<uint16> ClosestLandmarkDistances;
+	ClosestLandmarkDistances.Init(UnreachedLandmarkDistance, NumCells);
+	ClosestLandmarkDistances.GetMutable(FirstCell) = 0;
+
+	Scratch.LandmarkQueue.Reset();
+	Scratch.LandmarkQueue.Add(FirstCell);
+	RelaxLandmarkDistances(ClosestLandmarkDistances, 0);
+
+	LandmarkDistances.Init(UnreachedLandmarkDistance, NumLandmarksToPlace * NumCells);
+
+	for (int32 Landmark = 0; Landmark < NumLandmarksToPlace; ++Landmark)
+	{
+		int32 FarthestCell = INDEX_NONE;
+
+		for (int32 Index = 0; Index < NumCells; ++Index)
+		{
+			if (ClosestLandmarkDistances[Index] != UnreachedLandmarkDistance
+				&& (FarthestCell == INDEX_NONE || ClosestLandmarkDistances[Index] > ClosestLandmarkDistances[FarthestCell]))
+			{
+				FarthestCell = Index;
+			}
+		}
+
+		if (Landmark > 0 && ClosestLandmarkDistances[FarthestCell] == 0)
+		{
+			// Every cell of the component is a landmark already
+			break;
+		}
+
+		Landmarks.Add(FIntPoint(FarthestCell % GridCountX, FarthestCell / GridCountX));
+
+		const int32 FirstIndex = Landmark * NumCells;
+
+		LandmarkDistances.GetMutable(FirstIndex + FarthestCell) = 0;
+
+		Scratch.LandmarkQueue.Reset();
+		Scratch.LandmarkQueue.Add(FarthestCell);
+		RelaxLandmarkDistances(LandmarkDistances, FirstIndex);
+
+		for (int32 Index = 0; Index < NumCells; ++Index)
+		{
+			// Cells outside the component stay unreached
+			const uint16 Distance = LandmarkDistances[FirstIndex + Index];
+
+			if (Landmark == 0 || Distance < ClosestLandmarkDistances[Index])
+			{
+				ClosestLandmarkDistances.GetMutable(Index) = Distance;
+			}
+		}
+	}
+}
+
+void FSideScrollGraph::UpdateLandmarks(const TArray<FIntPoint>& ChangedCells)
+{
+	if (Landmarks.Num() == 0)
+	{
+		return;
+	}
+
+	NumLandmarkChanges += ChangedCells.Num();
+
+	if (NumLandmarkChanges >= LandmarkRebuildChanges)
+	{
+		RebuildLandmarks();
+		return;
+	}
+
+	const int32 AdjacentX[] = { 1, 0, -1, 0 };
+	const int32 AdjacentY[] = { 0, 1, 0, -1 };
+
+	const int32 NumCells = GridCountX * GridCountY;
+
+	for (int32 Landmark = 0; Landmark < Landmarks.Num(); ++Landmark)
+	{
+		const int32 FirstIndex = Landmark * NumCells;
+
+		// Blocked cells first, so the walkable ones don't take a distance from them
+		for (const FIntPoint& Cell : ChangedCells)
+		{
+			if (GetHeight(Cell.X, Cell.Y) == -1)
+			{
+				LandmarkDistances.GetMutable(FirstIndex + Cell.X + (Cell.Y * GridCountX)) = UnreachedLandmarkDistance;
+			}
+		}
+
+		TArray<int32>& LandmarkQueue = Scratch.LandmarkQueue;
+		LandmarkQueue.Reset();
+
+		// A walkable changed cell may have opened new moves. Its distance is taken from its neighbors, which
+		// keeps it within 1 of each of them, and the relax below lowers whatever is now more than 1 further.
+		// Distances never grow otherwise, so blocked cells leave the estimate admissible but looser.
+		for (const FIntPoint& Cell : ChangedCells)
+		{
+			if (GetHeight(Cell.X, Cell.Y) == -1)
+			{
+				continue;
+			}
+
+			uint16 Distance = UnreachedLandmarkDistance;
+
+			for (int32 i = 0; i < ARRAY_COUNT(AdjacentX); ++i)
+			{
+				const FIntPoint AdjacentCell(Cell.X + AdjacentX[i], Cell.Y + AdjacentY[i]);
+
+				if (GetHeight(AdjacentCell.X, AdjacentCell.Y) == -1)
+				{
+					continue;
+				}
+
+				const uint16 AdjacentDistance = LandmarkDistances[FirstIndex + AdjacentCell.X + (AdjacentCell.Y * GridCountX)];
+
+				if (AdjacentDistance != UnreachedLandmarkDistance)
+				{
+					Distance = FMath::Min<uint16>(Distance, FMath::Min<int32>(AdjacentDistance + 1, MaxLandmarkDistance));
+				}
+			}
+
+			const int32 Index = Cell.X + (Cell.Y * GridCountX);
+			LandmarkDistances.GetMutable(FirstIndex + Index) = Distance;
+
+			if (Distance != UnreachedLandmarkDistance)
+			{
+				LandmarkQueue.Add(Index);
+			}
+		}
+
+		RelaxLandmarkDistances(LandmarkDistances, FirstIndex);
+	}
+}
+
+void FSideScrollGraph::RelaxLandmarkDistances(TCopyOnWriteArray<uint16>& Distances, int32 FirstIndex)
+{
+	TArray<int32>& LandmarkQueue = Scratch.LandmarkQueue;
+
+	const int32 AdjacentX[] = { 1, 0, -1, 0 };
+	const int32 AdjacentY[] = { 0, 1, 0, -1 };
+
+	// Breadth first from a single cell. Cells queued more than once are fine, it still ends where no neighbor can be lowered.
+	for (int32 QueueIndex = 0; QueueIndex < LandmarkQueue.Num(); ++QueueIndex)
+	{
+		const int32 Index = LandmarkQueue[QueueIndex];
+		const int32 X = Index % GridCountX;
+		const int32 Y = Index / GridCountX;
+
+		// Saturating keeps neighbors within 1 of each other
+		const uint16 AdjacentDistance = FMath::Min<int32>(Distances[FirstIndex + Index] + 1, MaxLandmarkDistance);
+
+		for (int32 i = 0; i < ARRAY_COUNT(AdjacentX); ++i)
+		{
+			const int32 AdjacentIndex = (X + AdjacentX[i]) + ((Y + AdjacentY[i]) * GridCountX);
+
+			if (GetHeight(X + AdjacentX[i], Y + AdjacentY[i]) != -1 && AdjacentDistance < Distances[FirstIndex + AdjacentIndex])
+			{
+				Distances.GetMutable(FirstIndex + AdjacentIndex) = AdjacentDistance;
+				LandmarkQueue.Add(AdjacentIndex);
+			}
+		}
+	}
 }
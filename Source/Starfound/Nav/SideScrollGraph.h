@@ -1,8 +1,11 @@
 #pragma once
 
 #include "Micropather.h"
+#include "CopyOnWriteArray.h"
 
 // void* state is defined as x + (y * Column Count)
+// Copies share the large per-cell tables and only copy the pages of them written since, so a copy for worker
+// threads costs little more than the pages that changed.
 class FSideScrollGraph : public MicroPanther::FGraph
 {
 public:
@@ -10,24 +13,183 @@ public:
 
 	void InitializeGrid(int32 InGridCountX, int32 InGridCountY);
 
+	// Height is -1 for blocked, 0 for standing on a floor, 1 for climbing
 	void SetHeight(int32 X, int32 Y, int32 NewHeight);
 
+	// Replaces every cell at once. Bit X % 64 of word (Y * GetNumRowWords()) + (X / 64) is cell (X, Y).
+	// Climb cells are walkable too, and bits past the end of a row must be 0.
+	void SetCells(const TArray<uint64>& InWalkableBits, const TArray<uint64>& InClimbBits);
+
 	int32 GetGridCountX() const { return GridCountX; }
 	int32 GetGridCountY() const { return GridCountY; }
+	int32 GetNumRowWords() const { return NumRowWords; }
 	int32 GetHeight(int32 X, int32 Y) const;
 
 	virtual float LeastCostEstimate(void* StartState, void* EndState) override;
 	virtual void AdjacentCost(void* State, TArray<MicroPanther::FStateCost>* AdjacentCosts) override;
 	virtual void PrintStateInfo(void* State) override;
+	virtual int32 GetNumStates() const override { return GridCountX * GridCountY; }
+
+	// Versioned per region of cells, so MicroPather's caches only forget what is around a change
+	virtual bool HasStateVersions() const override { return true; }
+	virtual uint32 GetGraphVersion() const override { return GraphVersion; }
+	virtual uint32 GetStateVersion(void* State) const override;
+
+	// Typed graph interface for TMicroPather. States are the same cell indices as the void* ones.
+	FORCEINLINE float EstimateCost(int32 FromState, int32 ToState) const;
+
+	template<typename FuncT>
+	FORCEINLINE void ForEachAdjacent(int32 State, FuncT&& Func) const;
 
 	FIntPoint StateToVec2(void* State) const;
 	void* Vec2ToState(const FIntPoint& Position) const;
 
+	// Connected component of a walkable cell. INDEX_NONE if blocked or out of grid.
+	int32 GetComponent(int32 X, int32 Y) const;
+
+	// False if there is no path from Start to End. A blocked start can still step into its neighbors.
+	bool AreConnected(const FIntPoint& Start, const FIntPoint& End) const;
+
+	// Labels every cell from scratch.
+	void RebuildComponents();
+
+	// Relabels only the components around cells whose height changed.
+	void UpdateComponents(const TArray<FIntPoint>& ChangedCells);
+
+	// Spreads landmark cells over the largest component and measures exact distances from them.
+	// LeastCostEstimate uses them as a tighter bound than Manhattan distance. Call after RebuildComponents.
+	void RebuildLandmarks();
+
+	// Keeps the landmark distances admissible around cells whose height changed. They only get looser,
+	// so after enough changes the landmarks are rebuilt.
+	void UpdateLandmarks(const TArray<FIntPoint>& ChangedCells);
+
+	// Without landmarks LeastCostEstimate is Manhattan distance
+	void SetUseLandmarks(bool bInUseLandmarks) { bUseLandmarks = bInUseLandmarks; }
+
+	int32 GetNumLandmarks() const { return Landmarks.Num(); }
+
 private:
+	// Walkable neighbor of a cell
+	struct FEdge
+	{
+		int32 State;
+		float Cost;
+	};
+
+	// Up, down, left, right
+	static const int32 MaxEdges = 4;
+
+	static const uint16 UnreachedLandmarkDistance = MAX_uint16;
+	static const uint16 MaxLandmarkDistance = MAX_uint16 - 1;
+
+	FORCEINLINE bool IsWalkable(int32 X, int32 Y) const
+	{
+		return (WalkableBits[(Y * NumRowWords) + (X >> 6)] >> (X & 63)) & 1;
+	}
+
+	// Rebuilds every edge row and raises every region to a new version
+	void UpdateAllCells();
+
+	// Rebuilds the edges of a cell from the heights of its neighbors
+	void UpdateEdges(int32 X, int32 Y);
+
+	// Labels every unlabeled walkable cell connected to Seed with Component
+	void FloodComponent(const FIntPoint& Seed, int32 Component);
+
+	// Lowers distances from the cells in LandmarkQueue outwards until neighbors differ by at most 1.
+	// Cell distances start at FirstIndex of Distances.
+	void RelaxLandmarkDistances(TCopyOnWriteArray<uint16>& Distances, int32 FirstIndex);
 
 	int32 GridCountX;
 	int32 GridCountY;
 
-	// Heights of each grid cell. index = X + (Y * GridCountX). -1 means blocked.
-	TArray<int32> Heights;
+	// Heights of each grid cell as two bit planes: walkable, and climb among the walkable ones.
+	// Rows of NumRowWords words. index = (Y * NumRowWords) + (X / 64), bit X % 64.
+	TArray<uint64> WalkableBits;
+	TArray<uint64> ClimbBits;
+	int32 NumRowWords;
+
+	// Edges of each cell in +X, +Y, -X, -Y order, so searches read one contiguous row instead of four heights.
+	// Rows are MaxEdges long so a change rewrites them in place, and never cross a page. index = (Cell * MaxEdges) + Edge
+	TCopyOnWriteArray<FEdge> Edges;
+
+	// Edges used in each row. index = X + (Y * GridCountX)
+	TCopyOnWriteArray<uint8> NumEdges;
+
+	// Version of each region of RegionSize x RegionSize cells. index = RegionX + (RegionY * NumRegionsX).
+	// Blocking or unblocking a cell raises its region, and the regions of its neighbors, to the new GraphVersion.
+	TArray<uint32> RegionVersions;
+	int32 NumRegionsX;
+	uint32 GraphVersion;
+
+	// Connected component id of each grid cell. Same indexing as NumEdges.
+	TCopyOnWriteArray<int32> Components;
+	int32 NextComponent;
+
+	// |Distance(A) - Distance(B)| of a landmark never exceeds the path cost from A to B, as long as
+	// distances of walkable neighbors differ by at most 1. That holds for exact distances, and
+	// UpdateLandmarks keeps it true, so the estimate stays admissible between rebuilds.
+	TArray<FIntPoint> Landmarks;
+
+	// Saturated distance from each landmark. index = (Landmark * cell count) + X + (Y * GridCountX)
+	TCopyOnWriteArray<uint16> LandmarkDistances;
+
+	// Changed cells since the last RebuildLandmarks
+	int32 NumLandmarkChanges;
+
+	bool bUseLandmarks;
+
+	// Work arrays of the updates, kept to reduce memory allocation. Copies of the graph start without them.
+	struct FScratch
+	{
+		FScratch() {}
+		FScratch(const FScratch&) {}
+		FScratch& operator=(const FScratch&) { return *this; }
+
+		// Flood fill stack
+		TArray<FIntPoint> FloodStack;
+
+		// Relax queue
+		TArray<int32> LandmarkQueue;
+	};
+
+	FScratch Scratch;
 };
+
+FORCEINLINE float FSideScrollGraph::EstimateCost(int32 FromState, int32 ToState) const
+{
+	// Every move costs 1
+	int32 Cost = FMath::Abs((FromState % GridCountX) - (ToState % GridCountX)) + FMath::Abs((FromState / GridCountX) - (ToState / GridCountX));
+
+	if (bUseLandmarks)
+	{
+		const int32 NumCells = GridCountX * GridCountY;
+
+		for (int32 Landmark = 0; Landmark < Landmarks.Num(); ++Landmark)
+		{
+			const uint16 FromDistance = LandmarkDistances[(Landmark * NumCells) + FromState];
+			const uint16 ToDistance = LandmarkDistances[(Landmark * NumCells) + ToState];
+
+			// Unreached on either side means the landmark says nothing about this pair
+			if (FromDistance != UnreachedLandmarkDistance && ToDistance != UnreachedLandmarkDistance)
+			{
+				Cost = FMath::Max(Cost, FMath::Abs((int32)FromDistance - (int32)ToDistance));
+			}
+		}
+	}
+
+	return Cost;
+}
+
+template<typename FuncT>
+FORCEINLINE void FSideScrollGraph::ForEachAdjacent(int32 State, FuncT&& Func) const
+{
+	const FEdge* Edge = &Edges[State * MaxEdges];
+	const FEdge* EdgeEnd = Edge + NumEdges[State];
+
+	for (; Edge != EdgeEnd; ++Edge)
+	{
+		Func(Edge->State, Edge->Cost);
+	}
+}
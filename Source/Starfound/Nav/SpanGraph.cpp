@@ -0,0 +1,413 @@
+#include "SpanGraph.h"
+#include "SideScrollGraph.h"
+
+FSpanGraph::FSpanGraph(const FSideScrollGraph& InGraph)
+	: Graph(InGraph)
+	, EndLeft(INDEX_NONE)
+	, EndRight(INDEX_NONE)
+	, Pather(this)
+{
+}
+
+void FSpanGraph::Rebuild()
+{
+	Nodes.Reset();
+	FreeNodes.Reset();
+
+	Rows.Reset();
+	Rows.SetNum(Graph.GetGridCountY());
+
+	DirtyRows.Reset();
+
+	for (int32 Y = 0; Y < Rows.Num(); ++Y)
+	{
+		DirtyRows.Add(Y);
+	}
+
+	UpdateDirtyRows();
+}
+
+void FSpanGraph::MarkCellsDirty(const TArray<FIntPoint>& ChangedCells)
+{
+	for (const FIntPoint& Cell : ChangedCells)
+	{
+		// A cell splits or joins the spans of its row, and decides whether the cells above and below are nodes
+		for (int32 Y = Cell.Y - 1; Y <= Cell.Y + 1; ++Y)
+		{
+			if (Y >= 0 && Y < Rows.Num())
+			{
+				DirtyRows.AddUnique(Y);
+			}
+		}
+	}
+}
+
+int32 FSpanGraph::GetNumSpans() const
+{
+	int32 NumSpans = 0;
+
+	for (const FRow& Row : Rows)
+	{
+		NumSpans += Row.Spans.Num();
+	}
+
+	return NumSpans;
+}
+
+bool FSpanGraph::IsWalkable(int32 X, int32 Y) const
+{
+	return Graph.GetHeight(X, Y) != -1;
+}
+
+void FSpanGraph::UpdateDirtyRows()
+{
+	if (DirtyRows.Num() == 0)
+	{
+		return;
+	}
+
+	for (int32 Y : DirtyRows)
+	{
+		BuildRow(Y);
+	}
+
+	// Nodes of the rows next to a rebuilt one may point at its old nodes
+	TArray<int32> RowsToLink;
+
+	for (int32 Y : DirtyRows)
+	{
+		for (int32 LinkY = Y - 1; LinkY <= Y + 1; ++LinkY)
+		{
+			if (LinkY >= 0 && LinkY < Rows.Num())
+			{
+				RowsToLink.AddUnique(LinkY);
+			}
+		}
+	}
+
+	for (int32 Y : RowsToLink)
+	{
+		LinkRow(Y);
+	}
+
+	DirtyRows.Reset();
+}
+
+void FSpanGraph::BuildRow(int32 Y)
+{
+	FRow& Row = Rows[Y];
+
+	for (int32 Node : Row.Nodes)
+	{
+		Nodes[Node].Cell = FIntPoint(INDEX_NONE, INDEX_NONE);
+		FreeNodes.Add(Node);
+	}
+
+	Row.Spans.Reset();
+	Row.Nodes.Reset();
+
+	const int32 GridCountX = Graph.GetGridCountX();
+
+	int32 SpanStart = INDEX_NONE;
+	int32 LastNode = INDEX_NONE;
+
+	for (int32 X = 0; X <= GridCountX; ++X)
+	{
+		if (X == GridCountX || !IsWalkable(X, Y))
+		{
+			if (SpanStart != INDEX_NONE)
+			{
+				Row.Spans.Add(FIntPoint(SpanStart, X - 1));
+				SpanStart = INDEX_NONE;
+				LastNode = INDEX_NONE;
+			}
+			continue;
+		}
+
+		if (SpanStart == INDEX_NONE)
+		{
+			SpanStart = X;
+		}
+
+		// Climbs and drops only start from cells with somewhere to go
+		if (!IsWalkable(X, Y + 1) && !IsWalkable(X, Y - 1))
+		{
+			continue;
+		}
+
+		int32 Node;
+
+		if (FreeNodes.Num() > 0)
+		{
+			Node = FreeNodes.Pop(false);
+		}
+		else
+		{
+			Node = Nodes.AddUninitialized();
+		}
+
+		FNode& NewNode = Nodes[Node];
+		NewNode.Cell = FIntPoint(X, Y);
+		NewNode.Left = LastNode;
+		NewNode.Right = INDEX_NONE;
+		NewNode.Up = INDEX_NONE;
+		NewNode.Down = INDEX_NONE;
+
+		if (LastNode != INDEX_NONE)
+		{
+			Nodes[LastNode].Right = Node;
+		}
+
+		Row.Nodes.Add(Node);
+		LastNode = Node;
+	}
+}
+
+void FSpanGraph::LinkRow(int32 Y)
+{
+	for (int32 Node : Rows[Y].Nodes)
+	{
+		FNode& LinkedNode = Nodes[Node];
+
+		LinkedNode.Up = FindNode(LinkedNode.Cell.X, Y + 1);
+		LinkedNode.Down = FindNode(LinkedNode.Cell.X, Y - 1);
+	}
+}
+
+int32 FSpanGraph::FindNode(int32 X, int32 Y) const
+{
+	if (Y < 0 || Y >= Rows.Num())
+	{
+		return INDEX_NONE;
+	}
+
+	const TArray<int32>& RowNodes = Rows[Y].Nodes;
+
+	int32 Min = 0;
+	int32 Max = RowNodes.Num();
+
+	while (Min < Max)
+	{
+		const int32 Middle = (Min + Max) / 2;
+
+		if (Nodes[RowNodes[Middle]].Cell.X < X)
+		{
+			Min = Middle + 1;
+		}
+		else
+		{
+			Max = Middle;
+		}
+	}
+
+	return (Min < RowNodes.Num() && Nodes[RowNodes[Min]].Cell.X == X) ? RowNodes[Min] : INDEX_NONE;
+}
+
+int32 FSpanGraph::FindSpan(int32 X, int32 Y) const
+{
+	if (Y < 0 || Y >= Rows.Num())
+	{
+		return INDEX_NONE;
+	}
+
+	const TArray<FIntPoint>& Spans = Rows[Y].Spans;
+
+	// Last span starting at or before X
+	int32 Min = 0;
+	int32 Max = Spans.Num();
+
+	while (Min < Max)
+	{
+		const int32 Middle = (Min + Max) / 2;
+
+		if (Spans[Middle].X <= X)
+		{
+			Min = Middle + 1;
+		}
+		else
+		{
+			Max = Middle;
+		}
+	}
+
+	return (Min > 0 && X <= Spans[Min - 1].Y) ? Min - 1 : INDEX_NONE;
+}
+
+void FSpanGraph::FindSpanNodes(const FIntPoint& Cell, int32& OutLeft, int32& OutRight) const
+{
+	OutLeft = INDEX_NONE;
+	OutRight = INDEX_NONE;
+
+	const int32 Span = FindSpan(Cell.X, Cell.Y);
+
+	if (Span == INDEX_NONE)
+	{
+		return;
+	}
+
+	const FIntPoint& SpanCells = Rows[Cell.Y].Spans[Span];
+	const TArray<int32>& RowNodes = Rows[Cell.Y].Nodes;
+
+	// First node at or after the cell
+	int32 Min = 0;
+	int32 Max = RowNodes.Num();
+
+	while (Min < Max)
+	{
+		const int32 Middle = (Min + Max) / 2;
+
+		if (Nodes[RowNodes[Middle]].Cell.X < Cell.X)
+		{
+			Min = Middle + 1;
+		}
+		else
+		{
+			Max = Middle;
+		}
+	}
+
+	if (Min < RowNodes.Num() && Nodes[RowNodes[Min]].Cell.X <= SpanCells.Y)
+	{
+		OutRight = RowNodes[Min];
+	}
+
+	if (Min > 0 && Nodes[RowNodes[Min - 1]].Cell.X >= SpanCells.X)
+	{
+		OutLeft = RowNodes[Min - 1];
+	}
+}
+
+void FSpanGraph::AddStartEdges(const FIntPoint& Cell, float BaseCost, int32 EndState)
+{
+	const FIntPoint& End = QueryCells[EndQuery];
+
+	// Straight along the span is as short as it gets
+	if (Cell.Y == End.Y && FindSpan(Cell.X, Cell.Y) == FindSpan(End.X, End.Y))
+	{
+		FQueryEdge Edge = { EndState, BaseCost + FMath::Abs(End.X - Cell.X), Cell };
+		StartEdges.Add(Edge);
+		return;
+	}
+
+	int32 Left;
+	int32 Right;
+	FindSpanNodes(Cell, Left, Right);
+
+	if (Left != INDEX_NONE)
+	{
+		FQueryEdge Edge = { Left, BaseCost + (Cell.X - Nodes[Left].Cell.X), Cell };
+		StartEdges.Add(Edge);
+	}
+
+	if (Right != INDEX_NONE && Right != Left)
+	{
+		FQueryEdge Edge = { Right, BaseCost + (Nodes[Right].Cell.X - Cell.X), Cell };
+		StartEdges.Add(Edge);
+	}
+}
+
+int32 FSpanGraph::FindPath(const FIntPoint& Start, const FIntPoint& End, TArray<void*>& OutPath, float& OutCost)
+{
+	OutPath.Reset();
+	OutCost = 0;
+
+	UpdateDirtyRows();
+
+	if (Start == End)
+	{
+		return MicroPanther::FMicroPather::START_END_SAME;
+	}
+
+	if (!IsWalkable(End.X, End.Y) || Start.X < 0 || Start.X >= Graph.GetGridCountX() || Start.Y < 0 || Start.Y >= Graph.GetGridCountY())
+	{
+		return MicroPanther::FMicroPather::NO_SOLUTION;
+	}
+
+	QueryCells[StartQuery] = Start;
+	QueryCells[EndQuery] = End;
+
+	// The end is reached through the nodes next to it, unless it is one
+	int32 EndState = FindNode(End.X, End.Y);
+	EndLeft = INDEX_NONE;
+	EndRight = INDEX_NONE;
+
+	if (EndState == INDEX_NONE)
+	{
+		EndState = Nodes.Num() + EndQuery;
+		FindSpanNodes(End, EndLeft, EndRight);
+	}
+
+	StartEdges.Reset();
+
+	if (IsWalkable(Start.X, Start.Y))
+	{
+		AddStartEdges(Start, 0.0f, EndState);
+	}
+	else
+	{
+		// Standing in a blocked cell. Every walkable neighbor is one step away.
+		const FIntPoint Neighbors[] = { {Start.X + 1, Start.Y}, {Start.X, Start.Y + 1}, {Start.X - 1, Start.Y}, {Start.X, Start.Y - 1} };
+
+		for (const FIntPoint& Neighbor : Neighbors)
+		{
+			if (IsWalkable(Neighbor.X, Neighbor.Y))
+			{
+				AddStartEdges(Neighbor, 1.0f, EndState);
+			}
+		}
+	}
+
+	const int32 Result = Pather.Solve(Nodes.Num() + StartQuery, EndState, StatePath, OutCost);
+
+	EndLeft = INDEX_NONE;
+	EndRight = INDEX_NONE;
+
+	if (Result != MicroPanther::FMicroPather::SOLVED)
+	{
+		return Result;
+	}
+
+	// The cheapest edge to the first state is the one the search took
+	const FQueryEdge* FirstEdge = nullptr;
+
+	for (const FQueryEdge& Edge : StartEdges)
+	{
+		if (Edge.State == StatePath[1] && (!FirstEdge || Edge.Cost < FirstEdge->Cost))
+		{
+			FirstEdge = &Edge;
+		}
+	}
+
+	OutPath.Reserve((int32)OutCost + 1);
+	OutPath.Add(Graph.Vec2ToState(Start));
+
+	if (FirstEdge->Via != Start)
+	{
+		OutPath.Add(Graph.Vec2ToState(FirstEdge->Via));
+	}
+
+	AppendCells(FirstEdge->Via, GetStateCell(StatePath[1]), OutPath);
+
+	for (int32 i = 2; i < StatePath.Num(); ++i)
+	{
+		AppendCells(GetStateCell(StatePath[i - 1]), GetStateCell(StatePath[i]), OutPath);
+	}
+
+	return Result;
+}
+
+void FSpanGraph::AppendCells(const FIntPoint& From, const FIntPoint& To, TArray<void*>& OutPath) const
+{
+	if (From.Y != To.Y)
+	{
+		OutPath.Add(Graph.Vec2ToState(To));
+		return;
+	}
+
+	const int32 Step = FMath::Sign(To.X - From.X);
+
+	for (int32 X = From.X + Step; X != To.X + Step; X += Step)
+	{
+		OutPath.Add(Graph.Vec2ToState(FIntPoint(X, To.Y)));
+	}
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TypedMicroPather.h"
+
+class FSideScrollGraph;
+
+// Graph of floor spans over FSideScrollGraph. Walkable cells next to each other in a row are a span, and
+// walking along it costs one per cell. Only the cells where a path can climb or drop, the ones with a
+// walkable cell above or below, are nodes. Nodes are linked to the next node either way along their span
+// and to the nodes above and below, so paths cost the same as A* over every cell.
+// States are node indices, followed by the start and end of the running query.
+class FSpanGraph
+{
+public:
+	FSpanGraph(const FSideScrollGraph& InGraph);
+
+	// Rebuilds every row. Call after the grid is resized.
+	void Rebuild();
+
+	// Rows around the changed cells are rebuilt on the next FindPath
+	void MarkCellsDirty(const TArray<FIntPoint>& ChangedCells);
+
+	// Returns FMicroPather::SOLVED, NO_SOLUTION or START_END_SAME. OutPath holds FSideScrollGraph states of every cell.
+	// A blocked start can still step into its neighbors.
+	int32 FindPath(const FIntPoint& Start, const FIntPoint& End, TArray<void*>& OutPath, float& OutCost);
+
+	// Nodes expanded by the last FindPath
+	int32 GetNumExpandedNodes() const { return Pather.GetNumExpandedNodes(); }
+
+	int32 GetNumNodes() const { return Nodes.Num() - FreeNodes.Num(); }
+	int32 GetNumSpans() const;
+
+	// Typed graph interface for TMicroPather
+	int32 GetNumStates() const { return Nodes.Num() + NumQueryNodes; }
+	FORCEINLINE float EstimateCost(int32 FromState, int32 ToState) const;
+
+	template<typename FuncT>
+	FORCEINLINE void ForEachAdjacent(int32 State, FuncT&& Func) const;
+
+private:
+	struct FNode
+	{
+		FIntPoint Cell;
+
+		// Next node along the span on each side. INDEX_NONE past the last one.
+		int32 Left;
+		int32 Right;
+
+		// Nodes of the cells above and below. INDEX_NONE if not walkable.
+		int32 Up;
+		int32 Down;
+	};
+
+	struct FRow
+	{
+		// First and last cell of each span, sorted by X
+		TArray<FIntPoint> Spans;
+
+		// Nodes of the row, sorted by X
+		TArray<int32> Nodes;
+	};
+
+	struct FQueryEdge
+	{
+		int32 State;
+		float Cost;
+
+		// Walkable cell the start steps into first. The start itself unless it is blocked.
+		FIntPoint Via;
+	};
+
+	// Query states, after the nodes
+	enum
+	{
+		StartQuery = 0,
+		EndQuery = 1,
+		NumQueryNodes = 2
+	};
+
+	bool IsWalkable(int32 X, int32 Y) const;
+
+	void UpdateDirtyRows();
+
+	// Finds the spans and nodes of a row. Links along spans, but not up and down.
+	void BuildRow(int32 Y);
+	void LinkRow(int32 Y);
+
+	// INDEX_NONE if the cell isn't a node
+	int32 FindNode(int32 X, int32 Y) const;
+
+	// Index of the span holding the cell in its row. INDEX_NONE if blocked.
+	int32 FindSpan(int32 X, int32 Y) const;
+
+	// Nearest nodes on each side of a walkable cell along its span, the cell itself included
+	void FindSpanNodes(const FIntPoint& Cell, int32& OutLeft, int32& OutRight) const;
+
+	// Query states are the start or the end of a query when it isn't a node
+	FORCEINLINE const FIntPoint& GetStateCell(int32 State) const
+	{
+		return State < Nodes.Num() ? Nodes[State].Cell : QueryCells[State - Nodes.Num()];
+	}
+
+	void AddStartEdges(const FIntPoint& Cell, float BaseCost, int32 EndState);
+
+	// Appends the cells after From up to To, along a row or one step up or down
+	void AppendCells(const FIntPoint& From, const FIntPoint& To, TArray<void*>& OutPath) const;
+
+	const FSideScrollGraph& Graph;
+
+	TArray<FNode> Nodes;
+	TArray<int32> FreeNodes;
+
+	TArray<FRow> Rows;
+	TArray<int32> DirtyRows;
+
+	// Start and end of the running query
+	FIntPoint QueryCells[NumQueryNodes];
+
+	// Edges out of the start query state
+	TArray<FQueryEdge> StartEdges;
+
+	// Nodes next to the end along its span, linked to the end query state. INDEX_NONE if there is none on that side.
+	int32 EndLeft;
+	int32 EndRight;
+
+	TArray<int32> StatePath;
+	TMicroPather<FSpanGraph> Pather;
+};
+
+FORCEINLINE float FSpanGraph::EstimateCost(int32 FromState, int32 ToState) const
+{
+	const FIntPoint& From = GetStateCell(FromState);
+	const FIntPoint& To = GetStateCell(ToState);
+
+	return FMath::Abs(From.X - To.X) + FMath::Abs(From.Y - To.Y);
+}
+
+template<typename FuncT>
+FORCEINLINE void FSpanGraph::ForEachAdjacent(int32 State, FuncT&& Func) const
+{
+	if (State >= Nodes.Num())
+	{
+		if (State - Nodes.Num() == StartQuery)
+		{
+			for (const FQueryEdge& Edge : StartEdges)
+			{
+				Func(Edge.State, Edge.Cost);
+			}
+		}
+
+		// Nothing leaves the end
+		return;
+	}
+
+	const FNode& Node = Nodes[State];
+
+	if (Node.Right != INDEX_NONE)
+	{
+		Func(Node.Right, (float)(Nodes[Node.Right].Cell.X - Node.Cell.X));
+	}
+
+	if (Node.Up != INDEX_NONE)
+	{
+		Func(Node.Up, 1.0f);
+	}
+
+	if (Node.Left != INDEX_NONE)
+	{
+		Func(Node.Left, (float)(Node.Cell.X - Nodes[Node.Left].Cell.X));
+	}
+
+	if (Node.Down != INDEX_NONE)
+	{
+		Func(Node.Down, 1.0f);
+	}
+
+	if (State == EndLeft || State == EndRight)
+	{
+		Func(Nodes.Num() + EndQuery, (float)FMath::Abs(QueryCells[EndQuery].X - Node.Cell.X));
+	}
+}
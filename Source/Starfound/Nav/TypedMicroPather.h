@@ -0,0 +1,335 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Micropather.h"
+
+/**
+ * A* specialised on a graph type, for graphs whose states are integers in [0, GetNumStates()).
+ * Neighbors come from an inlined callback instead of virtual calls and FStateCost arrays, and per state
+ * data lives in flat arrays indexed by state. Orders the open set like FMicroPather does, so it expands the same
+ * number of nodes and finds paths of the same cost, though ties between equally good paths may break differently.
+ *
+ * GraphT provides:
+ *	int32 GetNumStates() const;
+ *	float EstimateCost(int32 FromState, int32 ToState) const;
+ *	template<typename FuncT> void ForEachAdjacent(int32 State, FuncT&& Func) const;	// Func(int32 AdjacentState, float Cost)
+ *
+ * Results are FMicroPather::SOLVED, NO_SOLUTION, START_END_SAME, SOLVING and PARTIAL, as FMicroPather returns them.
+ */
+template<typename GraphT>
+class TMicroPather
+{
+public:
+	explicit TMicroPather(const GraphT* InGraph = nullptr)
+		: Graph(InGraph)
+		, Generation(0)
+		, ClosestState(INDEX_NONE)
+		, ClosestEstimate(FLT_MAX)
+		, NumExpandedNodes(0)
+		, bSearchRunning(false)
+	{
+	}
+
+	void SetGraph(const GraphT* InGraph)
+	{
+		Graph = InGraph;
+		bSearchRunning = false;
+	}
+
+	const GraphT* GetGraph() const { return Graph; }
+
+	int Solve(int32 StartState, int32 EndState, TArray<int32>& OutPath, float& OutCost)
+	{
+		int32 Goal;
+		return SolveForAnyGoal(StartState, &EndState, 1, OutPath, OutCost, Goal);
+	}
+
+	int SolveForAnyGoal(int32 StartState, const TArray<int32>& GoalStates, TArray<int32>& OutPath, float& OutCost, int32& OutGoalState)
+	{
+		return SolveForAnyGoal(StartState, GoalStates.GetData(), GoalStates.Num(), OutPath, OutCost, OutGoalState);
+	}
+
+	// Starts a search to be run with StepSolve. Returns SOLVING, or NO_SOLUTION / START_END_SAME if there is nothing to search.
+	int BeginSolveForAnyGoal(int32 StartState, const TArray<int32>& GoalStates)
+	{
+		bSearchRunning = false;
+
+		if (GoalStates.Num() == 0)
+		{
+			return MicroPanther::FMicroPather::NO_SOLUTION;
+		}
+
+		if (GoalStates.Contains(StartState))
+		{
+			return MicroPanther::FMicroPather::START_END_SAME;
+		}
+
+		BeginSearch(StartState, GoalStates.GetData(), GoalStates.Num());
+
+		return MicroPanther::FMicroPather::SOLVING;
+	}
+
+	// Expands at most MaxExpansions nodes of the running search. Returns SOLVING until it is done, then SOLVED or NO_SOLUTION.
+	int StepSolve(int32 MaxExpansions, TArray<int32>& OutPath, float& OutCost, int32& OutGoalState)
+	{
+		OutPath.Reset();
+		OutCost = 0;
+		OutGoalState = INDEX_NONE;
+
+		if (!ensure(bSearchRunning))
+		{
+			return MicroPanther::FMicroPather::NO_SOLUTION;
+		}
+
+		return StepSearch(MaxExpansions, OutPath, OutCost, OutGoalState);
+	}
+
+	void CancelSolve() { bSearchRunning = false; }
+
+	bool IsSolving() const { return bSearchRunning; }
+
+	// Caps the searches started from now on. A search that gives up returns PARTIAL and the path to the explored
+	// state closest to the goals by estimate, which may be the start alone. OutGoalState is where that path ends.
+	void SetSearchLimits(const MicroPanther::FSearchLimits& InSearchLimits) { SearchLimits = InSearchLimits; }
+	const MicroPanther::FSearchLimits& GetSearchLimits() const { return SearchLimits; }
+
+	// Nodes expanded by the last solve, every step of a BeginSolveForAnyGoal search included
+	int32 GetNumExpandedNodes() const { return NumExpandedNodes; }
+
+private:
+	enum
+	{
+		StateClosed = 1 << 0,
+		StateGoal = 1 << 1
+	};
+
+	struct FOpenEntry
+	{
+		float TotalCost;
+		float CostFromStart;
+		int32 State;
+	};
+
+	// Lowest total cost first, the node furthest from the start on ties
+	struct FOpenEntryPredicate
+	{
+		FORCEINLINE bool operator()(const FOpenEntry& A, const FOpenEntry& B) const
+		{
+			return (A.TotalCost < B.TotalCost) || (A.TotalCost == B.TotalCost && A.CostFromStart > B.CostFromStart);
+		}
+	};
+
+	int SolveForAnyGoal(int32 StartState, const int32* GoalStates, int32 NumGoals, TArray<int32>& OutPath, float& OutCost, int32& OutGoalState)
+	{
+		OutPath.Reset();
+		OutCost = 0;
+		OutGoalState = INDEX_NONE;
+
+		for (int32 i = 0; i < NumGoals; ++i)
+		{
+			if (GoalStates[i] == StartState)
+			{
+				OutGoalState = StartState;
+				return MicroPanther::FMicroPather::START_END_SAME;
+			}
+		}
+
+		if (NumGoals == 0)
+		{
+			return MicroPanther::FMicroPather::NO_SOLUTION;
+		}
+
+		BeginSearch(StartState, GoalStates, NumGoals);
+
+		return StepSearch(MAX_int32, OutPath, OutCost, OutGoalState);
+	}
+
+	// Per state data is valid only if its generation is the current one, so nothing is cleared between solves
+	FORCEINLINE void TouchState(int32 State)
+	{
+		if (StateGenerations[State] != Generation)
+		{
+			StateGenerations[State] = Generation;
+			CostsFromStart[State] = FLT_MAX;
+			Parents[State] = INDEX_NONE;
+			StateFlags[State] = 0;
+		}
+	}
+
+	FORCEINLINE float EstimateCostToGoals(int32 State) const
+	{
+		float MinCost = Graph->EstimateCost(State, GoalStates[0]);
+
+		for (int32 i = 1; i < GoalStates.Num(); ++i)
+		{
+			MinCost = FMath::Min(MinCost, Graph->EstimateCost(State, GoalStates[i]));
+		}
+
+		return MinCost;
+	}
+
+	void BeginSearch(int32 StartState, const int32* InGoalStates, int32 NumGoals)
+	{
+		const int32 NumStates = Graph->GetNumStates();
+
+		if (StateGenerations.Num() != NumStates)
+		{
+			StateGenerations.Init(0, NumStates);
+			CostsFromStart.SetNumUninitialized(NumStates);
+			Parents.SetNumUninitialized(NumStates);
+			StateFlags.SetNumUninitialized(NumStates);
+			Generation = 0;
+		}
+
+		if (++Generation == 0)
+		{
+			// Wrapped around. Old generations could look current.
+			StateGenerations.Init(0, NumStates);
+			Generation = 1;
+		}
+
+		GoalStates.Reset();
+		GoalStates.Append(InGoalStates, NumGoals);
+
+		for (int32 GoalState : GoalStates)
+		{
+			TouchState(GoalState);
+			StateFlags[GoalState] |= StateGoal;
+		}
+
+		TouchState(StartState);
+		CostsFromStart[StartState] = 0;
+
+		Open.Reset();
+		Open.HeapPush(FOpenEntry{ EstimateCostToGoals(StartState), 0.0f, StartState }, FOpenEntryPredicate());
+
+		RunningSearchLimits = SearchLimits;
+		ClosestState = StartState;
+		ClosestEstimate = FLT_MAX;
+
+		NumExpandedNodes = 0;
+		bSearchRunning = true;
+	}
+
+	int StepSearch(int32 MaxExpansions, TArray<int32>& OutPath, float& OutCost, int32& OutGoalState)
+	{
+		int32 NumStepExpansions = 0;
+
+		while (Open.Num() > 0)
+		{
+			if (NumStepExpansions == MaxExpansions)
+			{
+				return MicroPanther::FMicroPather::SOLVING;
+			}
+
+			FOpenEntry Entry;
+			Open.HeapPop(Entry, FOpenEntryPredicate(), false);
+
+			const int32 State = Entry.State;
+
+			// A cheaper entry of the same state came first. The old one stays in the heap instead of being moved.
+			if ((StateFlags[State] & StateClosed) || Entry.CostFromStart > CostsFromStart[State])
+			{
+				continue;
+			}
+
+			if (RunningSearchLimits.MaxExpansions > 0 && NumExpandedNodes >= RunningSearchLimits.MaxExpansions)
+			{
+				return PathReached(ClosestState, MicroPanther::FMicroPather::PARTIAL, OutPath, OutCost, OutGoalState);
+			}
+
+			// The heap is ordered by total cost, so no path left is cheap enough
+			if (RunningSearchLimits.MaxCost > 0 && Entry.TotalCost > RunningSearchLimits.MaxCost)
+			{
+				return PathReached(ClosestState, MicroPanther::FMicroPather::PARTIAL, OutPath, OutCost, OutGoalState);
+			}
+
+			++NumStepExpansions;
+			++NumExpandedNodes;
+
+			if (StateFlags[State] & StateGoal)
+			{
+				return PathReached(State, MicroPanther::FMicroPather::SOLVED, OutPath, OutCost, OutGoalState);
+			}
+
+			const float EstimateToGoals = Entry.TotalCost - Entry.CostFromStart;
+
+			if (EstimateToGoals < ClosestEstimate)
+			{
+				ClosestState = State;
+				ClosestEstimate = EstimateToGoals;
+			}
+
+			StateFlags[State] |= StateClosed;
+
+			const float CostFromStart = CostsFromStart[State];
+
+			Graph->ForEachAdjacent(State, [this, State, CostFromStart](int32 AdjacentState, float Cost)
+			{
+				TouchState(AdjacentState);
+
+				const float NewCost = CostFromStart + Cost;
+
+				if (!(StateFlags[AdjacentState] & StateClosed) && NewCost < CostsFromStart[AdjacentState])
+				{
+					CostsFromStart[AdjacentState] = NewCost;
+					Parents[AdjacentState] = State;
+
+					Open.HeapPush(FOpenEntry{ NewCost + EstimateCostToGoals(AdjacentState), NewCost, AdjacentState }, FOpenEntryPredicate());
+				}
+			});
+		}
+
+		bSearchRunning = false;
+
+		return MicroPanther::FMicroPather::NO_SOLUTION;
+	}
+
+	// Ends the search with the path from the start to EndState
+	int PathReached(int32 EndState, int Result, TArray<int32>& OutPath, float& OutCost, int32& OutGoalState)
+	{
+		bSearchRunning = false;
+
+		OutCost = CostsFromStart[EndState];
+		OutGoalState = EndState;
+
+		int32 PathLength = 0;
+
+		for (int32 PathState = EndState; PathState != INDEX_NONE; PathState = Parents[PathState])
+		{
+			++PathLength;
+		}
+
+		OutPath.SetNumUninitialized(PathLength);
+
+		for (int32 PathState = EndState; PathState != INDEX_NONE; PathState = Parents[PathState])
+		{
+			OutPath[--PathLength] = PathState;
+		}
+
+		return Result;
+	}
+
+	const GraphT* Graph;
+
+	TArray<int32> GoalStates;
+	TArray<FOpenEntry> Open;
+
+	// Per state. index = state
+	TArray<uint32> StateGenerations;
+	TArray<float> CostsFromStart;
+	TArray<int32> Parents;
+	TArray<uint8> StateFlags;
+
+	uint32 Generation;
+
+	MicroPanther::FSearchLimits SearchLimits;
+	MicroPanther::FSearchLimits RunningSearchLimits;
+
+	// Expanded state of the running search with the lowest estimate to the goals, the end of a PARTIAL path
+	int32 ClosestState;
+	float ClosestEstimate;
+
+	int32 NumExpandedNodes;
+	bool bSearchRunning;
+};
@@ -7,6 +7,10 @@
 
 const static float JobReachDistance = 350;
 
+// Cap of a job path search. Further jobs are walked toward one partial path at a time, a new one every think.
+// A search the cap stops before it gets any closer runs again without it.
+const static int32 JobPathMaxExpansions = 8192;
+
 static bool _IsJobInReach(const AStarfoundPawn& Pawn, const FIntPoint& JobLocation)
 {
 	UBlockActorScene* BlockScene = GetBlockActorScene(Pawn.GetWorld());
@@ -33,7 +37,17 @@ AStarfoundAIController::AStarfoundAIController()
 {
 	PrimaryActorTick.bCanEverTick = true;
 
+	// Spread the thinking of pawns spawned together over frames
+	ThinkingCoolSeconds = FMath::FRand();
 	bWorking = false;
+
+	MoveRequestId = 0;
+	MoveRequestStatus = EStarfoundMoveRequestStatus::None;
+	MoveRequestJobId = INDEX_NONE;
+	MoveRequestComponent = INDEX_NONE;
+	MoveRequestConnectivityVersion = 0;
+	MoveRequestJobLocation = FIntPoint::ZeroValue;
+	bMoveRequestCapped = false;
 }
 
 void AStarfoundAIController::Tick(float DeltaSeconds)
@@ -57,6 +71,13 @@ void AStarfoundAIController::Tick(float DeltaSeconds)
 	}
 }
 
+void AStarfoundAIController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	CancelMoveRequest();
+
+	Super::EndPlay(EndPlayReason);
+}
+
 bool AStarfoundAIController::MoveToLocation(const FVector& TargetLocation)
 {
 	AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
@@ -123,61 +144,241 @@ bool AStarfoundAIController::MoveToPickupItem(const AItemActor* ItemActor)
 
 	DrawDebugLine(GetWorld(), Pawn->GetActorLocation(), ItemLocation, FColor::Green);
 
-	FVector TargetLocation;
-	bool bFoundValidTargetLocation = false;
+	const bool bPathFound = MoveNextToGridLocation(ItemLocationInGrid);
+
+	if (!bPathFound)
+	{
+		DrawDebugString(GetWorld(), FVector(0, 0, 150), "Noway", Pawn, FColor::White, 0, true);
+	}
+
+	return bPathFound;
+}
+
+bool AStarfoundAIController::MoveNextToGridLocation(const FIntPoint& TargetLocation)
+{
+	AStarfoundPawn* Pawn = Cast<AStarfoundPawn>(GetPawn());
+
+	if (!Pawn)
+	{
+		return false;
+	}
+
+	AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+	if (!GameMode)
+	{
+		return false;
+	}
+
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!BlockScene)
+	{
+		return false;
+	}
+
+	TArray<FIntPoint> Candidates;
+	GameMode->GetNavigation()->GetCellsNextToGridLocation(TargetLocation, Candidates);
+
+	FIntPoint Goal;
+	TArray<FVector2D> PathPoints;
+	const bool bPathFound = GameMode->GetNavigation()->FindPathToAny(Pawn->GetActorLocation(), Candidates, Goal, PathPoints);
+
+	if (bPathFound)
+	{
+		DrawDebugPoint(GetWorld(), BlockScene->OriginSpaceGridToWorldSpace(Goal) + FVector(10, 0, 0), 40.0f, FColor::Blue, false, 0.2f);
+
+		Pawn->GetStarfoundMovementController()->FollowPath(PathPoints);
+	}
+
+	return bPathFound;
+}
+
+bool AStarfoundAIController::RequestMoveToLocation(const FVector& TargetLocation, ENavRequestPriority Priority)
+{
+	AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+	if (!GameMode || !GetPawn())
+	{
+		return false;
+	}
+
+	CancelMoveRequest();
+
+	MoveRequestId = GameMode->GetNavigation()->RequestPath(GetPawn()->GetActorLocation(), TargetLocation,
+		FNavPathDelegate::CreateUObject(this, &AStarfoundAIController::OnMovePathFound), Priority);
+
+	if (MoveRequestId == 0)
+	{
+		return false;
+	}
+
+	MoveRequestStatus = EStarfoundMoveRequestStatus::Pending;
+
+	return true;
+}
+
+bool AStarfoundAIController::RequestMoveToPickupItem(const AItemActor* ItemActor, ENavRequestPriority Priority)
+{
+	if (!ItemActor)
+	{
+		return false;
+	}
+
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	if (!BlockScene)
+	{
+		return false;
+	}
+
+	return RequestMoveNextToGridLocation(BlockScene->WorldSpaceToOriginSpaceGrid(ItemActor->GetActorLocation()), Priority);
+}
+
+bool AStarfoundAIController::RequestMoveNextToGridLocation(const FIntPoint& TargetLocation, ENavRequestPriority Priority,
+	const MicroPanther::FSearchLimits& Limits)
+{
+	AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+	if (!GameMode || !GetPawn())
+	{
+		return false;
+	}
+
+	TArray<FIntPoint> Candidates;
+	GameMode->GetNavigation()->GetCellsNextToGridLocation(TargetLocation, Candidates);
+
+	CancelMoveRequest();
 
-	float TargetLocationMinDistance = 10E5;
+	MoveRequestId = GameMode->GetNavigation()->RequestPathToAny(GetPawn()->GetActorLocation(), Candidates,
+		FNavPathDelegate::CreateUObject(this, &AStarfoundAIController::OnMovePathFound), Priority, Limits);
 
-	for (int32 X = -1; X <= 1; ++X)
+	if (MoveRequestId == 0)
 	{
-		for (int32 Y = -3; Y <= 1; ++Y)
+		return false;
+	}
+
+	MoveRequestStatus = EStarfoundMoveRequestStatus::Pending;
+
+	return true;
+}
+
+void AStarfoundAIController::CancelMoveRequest()
+{
+	if (MoveRequestId != 0)
+	{
+		AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+
+		if (GameMode)
 		{
-			if (X == 0 && Y == 0)
-			{
-				continue;
-			}
+			GameMode->GetNavigation()->CancelPathRequest(MoveRequestId);
+		}
+	}
 
-			const FIntPoint Location = ItemLocationInGrid + FIntPoint(X, Y);
+	MoveRequestId = 0;
+	MoveRequestStatus = EStarfoundMoveRequestStatus::None;
+	MoveRequestJobId = INDEX_NONE;
+}
 
-			const bool bFoundValidNeighbor = GameMode->GetNavigation()->IsValidGridLocation(Location);
-			const bool bHasFloor = BlockScene->GetBlock(Location.X, Location.Y - 1);
+void AStarfoundAIController::OnMovePathFound(const FNavPathResult& Result)
+{
+	if (Result.RequestId != MoveRequestId)
+	{
+		return;
+	}
+
+	MoveRequestId = 0;
+
+	AStarfoundPawn* Pawn = Cast<AStarfoundPawn>(GetPawn());
+
+	// Closer is still progress. A path of the start alone isn't.
+	if (Pawn && Result.bPartial && Result.Path.Num() > 1)
+	{
+		MoveRequestStatus = EStarfoundMoveRequestStatus::Partial;
+
+		Pawn->GetStarfoundMovementController()->FollowPath(Result.Path);
+
+		return;
+	}
 
-			if (bFoundValidNeighbor && bHasFloor)
+	// The cap ran out before the search got anywhere, which says nothing about the job. Search again without it.
+	if (Pawn && Result.bPartial && bMoveRequestCapped && MoveRequestJobId != INDEX_NONE)
+	{
+		const int32 JobId = MoveRequestJobId;
+		const int32 Component = MoveRequestComponent;
+		const uint32 ConnectivityVersion = MoveRequestConnectivityVersion;
+		const FIntPoint JobLocation = MoveRequestJobLocation;
+
+		if (RequestMoveNextToGridLocation(JobLocation, ENavRequestPriority::Low, MicroPanther::FSearchLimits()))
+		{
+			MoveRequestJobId = JobId;
+			MoveRequestComponent = Component;
+			MoveRequestConnectivityVersion = ConnectivityVersion;
+			MoveRequestJobLocation = JobLocation;
+			bMoveRequestCapped = false;
+
+			return;
+		}
+	}
+
+	if (!Pawn || !Result.bSuccess)
+	{
+		MoveRequestStatus = EStarfoundMoveRequestStatus::Failed;
+
+		if (Pawn)
+		{
+			DrawDebugString(GetWorld(), FVector(0, 0, 150), "Noway", Pawn, FColor::White, 0, true);
+
+			AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+
+			// Remembered on the job, so neither this pawn nor another one from the same component searches for it again.
+			// Only a search that ran to the end proves there is no way.
+			if (GameMode && MoveRequestJobId != INDEX_NONE && !Result.bPartial)
 			{
-				const FVector TargetLocationCandidate = BlockScene->OriginSpaceGridToWorldSpace(Location);
-
-				TArray<FVector2D> PathPoints;
-				const bool bPathFound = GameMode->GetNavigation()->FindPath(Pawn->GetActorLocation(), TargetLocationCandidate, PathPoints);
-
-				if (bPathFound)
-				{
-					const float Distance = (Pawn->GetActorLocation() - TargetLocationCandidate).Size();
-
-					if (Distance < TargetLocationMinDistance)
-					{
-						TargetLocationMinDistance = Distance;
-						TargetLocation = TargetLocationCandidate;
-						bFoundValidTargetLocation = true;
-					}
-				}
+				GameMode->GetJobQueue()->MarkAssignedJobUnreachable(Pawn, MoveRequestJobId, MoveRequestComponent, MoveRequestConnectivityVersion);
+				GameMode->GetJobQueue()->AssignAnotherJob(Pawn);
 			}
 		}
+
+		return;
 	}
 
-	if (!bFoundValidTargetLocation)
-	{
-		DrawDebugString(GetWorld(), FVector(0, 0, 150), "Noway", Pawn, FColor::White, 0, true);
+	MoveRequestStatus = EStarfoundMoveRequestStatus::Succeeded;
+
+	Pawn->GetStarfoundMovementController()->FollowPath(Result.Path);
+}
 
+bool AStarfoundAIController::FollowJobFlowField(const FStarfoundJob& Job, int32 PawnComponent, uint32 ConnectivityVersion)
+{
+	AStarfoundPawn* Pawn = Cast<AStarfoundPawn>(GetPawn());
+	AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+
+	if (!Pawn || !GameMode)
+	{
 		return false;
 	}
-	else
+
+	// Held by the storage while it issues jobs, so every trip to it reads the same field
+	UStorageComponent* Storage = Job.GatherTargetBlockActor.IsValid() ? Job.GatherTargetBlockActor->FindComponentByClass<UStorageComponent>() : nullptr;
+	const uint32 FlowFieldId = Storage ? Storage->GetFlowFieldId() : 0;
+
+	CancelMoveRequest();
+
+	FIntPoint Goal;
+	TArray<FVector2D> PathPoints;
+
+	// The field covers every cell, so no path means no path at all
+	if (FlowFieldId == 0 || !GameMode->GetNavigation()->FindFlowFieldPath(FlowFieldId, Pawn->GetActorLocation(), Goal, PathPoints))
 	{
-		const bool bPathFound = MoveToLocation(TargetLocation);
-		ensure(bPathFound);
+		DrawDebugString(GetWorld(), FVector(0, 0, 150), "Noway", Pawn, FColor::White, 0, true);
+
+		GameMode->GetJobQueue()->MarkAssignedJobUnreachable(Pawn, Job.JobId, PawnComponent, ConnectivityVersion);
+		GameMode->GetJobQueue()->AssignAnotherJob(Pawn);
 
-		return bPathFound;
+		return false;
 	}
 
+	MoveRequestStatus = EStarfoundMoveRequestStatus::Succeeded;
+
+	Pawn->GetStarfoundMovementController()->FollowPath(PathPoints);
+
 	return true;
 }
 
@@ -241,66 +442,47 @@ bool AStarfoundAIController::MoveToJobLocation()
 
 	DrawDebugLine(GetWorld(), Pawn->GetActorLocation(), JobLocation, FColor::Green);
 
-	FVector TargetLocation;
-	bool bFoundValidTargetLocation = false;
-
 	const bool bJobInReach = _IsJobInReach(*Pawn, Job.Location);
 
 	if (!bJobInReach)
 	{
-		float TargetLocationMinDistance = 10E5;
-		
-		for (int32 X = -1; X <= 1; ++X)
+		// Still waiting for the last answer. Asking again would put us at the back of the queue.
+		if (MoveRequestStatus == EStarfoundMoveRequestStatus::Pending)
 		{
-			for (int32 Y = -3; Y <= 1; ++Y)
-			{
-				if (X == 0 && Y == 0)
-				{
-					continue;
-				}
-
-				const FIntPoint Location = Job.Location + FIntPoint(X, Y);
-
-				const bool bFoundValidNeighbor = GameMode->GetNavigation()->IsValidGridLocation(Location);
-				const bool bHasFloor = BlockScene->GetBlock(Location.X, Location.Y - 1);
-
-				if (bFoundValidNeighbor && bHasFloor)
-				{
-					const FVector TargetLocationCandidate = BlockScene->OriginSpaceGridToWorldSpace(Location);
-
-					TArray<FVector2D> PathPoints;
-					const bool bPathFound = GameMode->GetNavigation()->FindPath(Pawn->GetActorLocation(), TargetLocationCandidate, PathPoints);
-
-					if (bPathFound)
-					{
-						const float Distance = (Pawn->GetActorLocation() - TargetLocationCandidate).Size();
-
-						if (Distance < TargetLocationMinDistance)
-						{
-							TargetLocationMinDistance = Distance;
-							TargetLocation = TargetLocationCandidate;
-							bFoundValidTargetLocation = true;
-						}
-					}
-				}
-			}
+			return true;
 		}
 
-		if (!bFoundValidTargetLocation)
+		ANavigation* Navigation = GameMode->GetNavigation();
+		const int32 PawnComponent = Navigation->GetGridComponent(BlockScene->WorldSpaceToOriginSpaceGrid(Pawn->GetActorLocation()));
+		const uint32 ConnectivityVersion = Navigation->GetConnectivityVersion();
+
+		// Searched before from here, and no block changed since that could open a way
+		if (Job.IsUnreachableFrom(PawnComponent, ConnectivityVersion))
 		{
 			DrawDebugString(GetWorld(), FVector(0, 0, 150), "Noway", Pawn, FColor::White, 0, true);
-
-			//GameMode->GetJobQueue()->AssignAnotherJob(Pawn);
-
+			GameMode->GetJobQueue()->AssignAnotherJob(Pawn);
 			return false;
 		}
-		else
+
+		// Every pawn gathering to the same storage reads its path off one shared field
+		if (Job.JobType == EStarfoundJobType::GatherItem)
 		{
-			const bool bPathFound = MoveToLocation(TargetLocation);
-			ensure(bPathFound);
+			return FollowJobFlowField(Job, PawnComponent, ConnectivityVersion);
+		}
 
-			return bPathFound;
+		// OnMovePathFound draws "Noway" if there is no path
+		if (!RequestMoveNextToGridLocation(Job.Location, ENavRequestPriority::Low, MicroPanther::FSearchLimits(JobPathMaxExpansions, 0)))
+		{
+			return false;
 		}
+
+		MoveRequestJobId = Job.JobId;
+		MoveRequestComponent = PawnComponent;
+		MoveRequestConnectivityVersion = ConnectivityVersion;
+		MoveRequestJobLocation = Job.Location;
+		bMoveRequestCapped = true;
+
+		return true;
 	}
 
 	return true;
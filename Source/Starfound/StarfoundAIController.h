@@ -4,8 +4,19 @@
 
 #include "CoreMinimal.h"
 #include "Classes/AIController.h"
+#include "Nav/Navigation.h"
 #include "StarfoundAIController.generated.h"
 
+enum class EStarfoundMoveRequestStatus : uint8
+{
+	None,
+	Pending,
+	Succeeded,
+	// Following a path toward the goal. The search limits stopped it short.
+	Partial,
+	Failed,
+};
+
 UCLASS()
 class STARFOUND_API AStarfoundAIController : public AAIController
 {
@@ -15,6 +26,7 @@ public:
 	AStarfoundAIController();
 
 	virtual void Tick(float DeltaSeconds);
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	bool MoveToLocation(const FVector& TargetLocation);
 
@@ -24,9 +36,28 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool MoveToPickupItem(const class AItemActor* ItemActor);
 
+	// Async versions. The path is found on a worker thread and the pawn starts following it when it arrives.
+	// A new request replaces the pending one. Returns false if the request couldn't be made.
+	bool RequestMoveToLocation(const FVector& TargetLocation, ENavRequestPriority Priority = ENavRequestPriority::Normal);
+	bool RequestMoveToPickupItem(const class AItemActor* ItemActor, ENavRequestPriority Priority = ENavRequestPriority::Normal);
+	void CancelMoveRequest();
+
+	EStarfoundMoveRequestStatus GetMoveRequestStatus() const { return MoveRequestStatus; }
+
 private:
 	void AssignJobIfNeeded();
 
+	// Moves to the cheapest reachable cell a pawn can work on TargetLocation (origin space) from.
+	bool MoveNextToGridLocation(const FIntPoint& TargetLocation);
+	bool RequestMoveNextToGridLocation(const FIntPoint& TargetLocation, ENavRequestPriority Priority,
+		const MicroPanther::FSearchLimits& Limits = MicroPanther::FSearchLimits());
+
+	void OnMovePathFound(const FNavPathResult& Result);
+
+	// Follows the flow field the storage of the job holds to the cells next to it, shared with every pawn gathering
+	// to it. Gives the job up if it can't be reached.
+	bool FollowJobFlowField(const struct FStarfoundJob& Job, int32 PawnComponent, uint32 ConnectivityVersion);
+
 	UFUNCTION(BlueprintCallable)
 	bool MoveToJobLocation();
 
@@ -35,4 +66,16 @@ private:
 
 	float ThinkingCoolSeconds;
 	bool bWorking;
+
+	uint32 MoveRequestId;
+	EStarfoundMoveRequestStatus MoveRequestStatus;
+
+	// Job the pending request moves to, INDEX_NONE for other moves. Where it was asked from, for the unreachable memo.
+	int32 MoveRequestJobId;
+	int32 MoveRequestComponent;
+	uint32 MoveRequestConnectivityVersion;
+
+	// Cell of that job, and whether its search was capped, to search again without the cap when it stopped short
+	FIntPoint MoveRequestJobLocation;
+	bool bMoveRequestCapped;
 };
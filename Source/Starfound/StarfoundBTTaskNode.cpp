@@ -11,6 +11,14 @@ UPickupItemActorBTTaskNode::UPickupItemActorBTTaskNode()
 
 EBTNodeResult::Type UPickupItemActorBTTaskNode::ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
 {
+	AStarfoundAIController* Controller = Cast<AStarfoundAIController>(OwnerComp.GetOwner());
+
+	if (Controller)
+	{
+		// Don't pick up the result of whoever asked before us
+		Controller->CancelMoveRequest();
+	}
+
 	return EBTNodeResult::InProgress;
 }
 
@@ -62,13 +70,25 @@ void UPickupItemActorBTTaskNode::TickTask(UBehaviorTreeComponent& OwnerComp, uin
 
 	if (!bItemInPickupRange)
 	{
-		const bool bCanMoveTo = Controller->MoveToPickupItem(ItemActor);
+		// Path finding runs off the game thread. Ask again whenever the last answer is in, so the path follows the item.
+		const EStarfoundMoveRequestStatus MoveRequestStatus = Controller->GetMoveRequestStatus();
 
-		if (!bCanMoveTo)
+		if (MoveRequestStatus == EStarfoundMoveRequestStatus::Failed)
 		{
 			FinishLatentTask(OwnerComp, EBTNodeResult::Failed);
 			return;
 		}
+
+		if (MoveRequestStatus != EStarfoundMoveRequestStatus::Pending)
+		{
+			const bool bRequested = Controller->RequestMoveToPickupItem(ItemActor);
+
+			if (!bRequested)
+			{
+				FinishLatentTask(OwnerComp, EBTNodeResult::Failed);
+				return;
+			}
+		}
 	}
 	else
 	{
@@ -84,3 +104,15 @@ void UPickupItemActorBTTaskNode::TickTask(UBehaviorTreeComponent& OwnerComp, uin
 		}
 	}
 }
+
+void UPickupItemActorBTTaskNode::OnTaskFinished(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTNodeResult::Type TaskResult)
+{
+	AStarfoundAIController* Controller = Cast<AStarfoundAIController>(OwnerComp.GetOwner());
+
+	if (Controller)
+	{
+		Controller->CancelMoveRequest();
+	}
+
+	Super::OnTaskFinished(OwnerComp, NodeMemory, TaskResult);
+}
@@ -21,12 +21,21 @@ void AStarfoundGameMode::StartPlay()
 {
 	BlockActorScene = NewObject<UBlockActorScene>(this);
 	GetWorld()->GetWorldSettings()->AddAssetUserData(BlockActorScene);
-	BlockActorScene->InitializeGrid(100.0f, 100, 100);
+	BlockActorScene->InitializeGrid(100.0f, Configuration.GridX, Configuration.GridY);
 
 	Super::StartPlay();
 
+	BlockInstances = nullptr;
+
+	if (Configuration.bInstanceScenaryBlocks)
+	{
+		BlockInstances = GetWorld()->SpawnActor<ABlockInstanceActor>();
+		BlockInstances->SetMeshChunks(Configuration.bMeshScenaryChunks);
+		BlockActorScene->SetBlockInstanceActor(BlockInstances);
+	}
+
 	BlockGenerator = NewObject<UBlockGenerator>();
-	BlockGenerator->GenerateRandomBlockWorld(GetWorld(), Configuration.ScenaryBlocks);
+	BlockGenerator->GenerateRandomBlockWorld(GetWorld(), Configuration.ScenaryBlocks, BlockInstances);
 
 	Navigation = GetWorld()->SpawnActor<ANavigation>();
 
@@ -101,12 +110,34 @@ bool UStarfoundJobQueue::AssignJob(AStarfoundPawn* Pawn)
 		return false;
 	}
 
-	FStarfoundJob Job = JobQueue[0];
-	JobQueue.RemoveAt(0);
+	AStarfoundGameMode* GameMode = GetStarfoundGameMode(GetWorld());
+	UBlockActorScene* BlockScene = GetBlockActorScene(GetWorld());
+
+	int32 PawnComponent = INDEX_NONE;
+	uint32 ConnectivityVersion = 0;
 
-	AssignedJobs.Add(Pawn, Job);
+	if (GameMode && GameMode->GetNavigation() && BlockScene)
+	{
+		PawnComponent = GameMode->GetNavigation()->GetGridComponent(BlockScene->WorldSpaceToOriginSpaceGrid(Pawn->GetActorLocation()));
+		ConnectivityVersion = GameMode->GetNavigation()->GetConnectivityVersion();
+	}
 
-	return true;
+	for (int32 i = 0; i < JobQueue.Num(); ++i)
+	{
+		if (JobQueue[i].IsUnreachableFrom(PawnComponent, ConnectivityVersion))
+		{
+			continue;
+		}
+
+		FStarfoundJob Job = JobQueue[i];
+		JobQueue.RemoveAt(i);
+
+		AssignedJobs.Add(Pawn, Job);
+
+		return true;
+	}
+
+	return false;
 }
 
 void UStarfoundJobQueue::AssignAnotherJob(AStarfoundPawn* Pawn)
@@ -165,6 +196,17 @@ float UStarfoundJobQueue::ProgressAssignedJob(const AStarfoundPawn* Pawn, float
 	return 0;
 }
 
+void UStarfoundJobQueue::MarkAssignedJobUnreachable(const AStarfoundPawn* Pawn, int32 JobId, int32 Component, uint32 ConnectivityVersion)
+{
+	FStarfoundJob* Job = AssignedJobs.Find(Pawn);
+
+	// Reassigned while the path was searched
+	if (Job && Job->JobId == JobId)
+	{
+		Job->MarkUnreachableFrom(Component, ConnectivityVersion);
+	}
+}
+
 void UStarfoundJobQueue::PopAssignedJob(const AStarfoundPawn* Pawn)
 {
 	AssignedJobs.Remove(Pawn);
@@ -195,8 +237,30 @@ void UStarfoundJobQueue::DebugDraw() const
 
 FStarfoundJob::FStarfoundJob() 
 	: ProgressPercentage(0)
+	, UnreachableVersion(0)
+{
+
+}
+
+bool FStarfoundJob::IsUnreachableFrom(int32 Component, uint32 ConnectivityVersion) const
 {
+	return UnreachableVersion == ConnectivityVersion && UnreachableComponents.Contains(Component);
+}
+
+void FStarfoundJob::MarkUnreachableFrom(int32 Component, uint32 ConnectivityVersion)
+{
+	if (Component == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (UnreachableVersion != ConnectivityVersion)
+	{
+		UnreachableComponents.Reset();
+		UnreachableVersion = ConnectivityVersion;
+	}
 
+	UnreachableComponents.AddUnique(Component);
 }
 
 void FStarfoundJob::InitConstruct(const FIntPoint& InLocation, const TSubclassOf<ABlockActor>& InConstructBlockClass)
@@ -51,11 +51,19 @@ struct FStarfoundJob
 	UPROPERTY(BlueprintReadOnly)
 	TWeakObjectPtr<ABlockActor> GatherTargetBlockActor;
 
+	// Nav components no pawn can reach the job from, known as of UnreachableVersion
+	// (ANavigation::GetConnectivityVersion). Forgotten once the version moves on.
+	TArray<int32> UnreachableComponents;
+	uint32 UnreachableVersion;
+
 	FStarfoundJob();
 
 	void InitConstruct(const FIntPoint& InLocation, const TSubclassOf<ABlockActor>& InConstructBlockClass);
 	void InitDestruct(TWeakObjectPtr<class ABlockActor> Actor);
 	void InitGather(ABlockActor* Actor, EItemType ItemType);
+
+	bool IsUnreachableFrom(int32 Component, uint32 ConnectivityVersion) const;
+	void MarkUnreachableFrom(int32 Component, uint32 ConnectivityVersion);
 };
 
 UCLASS(BlueprintType)
@@ -75,6 +83,7 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool RemoveJob(int32 JobId);
 
+	// Assigns the oldest job not known to be unreachable from where the pawn stands
 	UFUNCTION(BlueprintCallable)
 	bool AssignJob(AStarfoundPawn* Pawn);
 
@@ -86,6 +95,10 @@ public:
 
 	float ProgressAssignedJob(const AStarfoundPawn* Pawn, float AddProgressPercentage);
 
+	// Remembers that the job assigned to the pawn can't be reached from the nav component, so it isn't searched
+	// for again from there until ANavigation's connectivity version changes
+	void MarkAssignedJobUnreachable(const AStarfoundPawn* Pawn, int32 JobId, int32 Component, uint32 ConnectivityVersion);
+
 	UFUNCTION(BlueprintCallable)
 	void PopAssignedJob(const AStarfoundPawn* Pawn);
 
@@ -119,10 +132,35 @@ struct FStarfoundConfiguration
 {
 	GENERATED_BODY()
 
+	FStarfoundConfiguration()
+		: GridX(100)
+		, GridY(100)
+		, bInstanceScenaryBlocks(true)
+		, bMeshScenaryChunks(true)
+	{
+	}
+
+	// Cells the world reaches out from the origin on each axis. Only blocks are stored in chunks as they are placed.
+	// Navigation is still sized to the whole grid: edges, components, landmark distances, clusters, spans and flow
+	// fields take memory for every cell, however empty it is.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	int32 GridX;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	int32 GridY;
+
 	// Blocks that auto generate at beginning
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
 	TArray<TSubclassOf<ABlockActor>> ScenaryBlocks;
 
+	// Scenary blocks with an instanced mesh are drawn as instances, without an actor until something is done with them
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	bool bInstanceScenaryBlocks;
+
+	// Instanced scenary blocks are merged into one mesh per chunk of the block scene instead of one instance each
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	bool bMeshScenaryChunks;
+
 	// Blocks that player can construct
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
 	TArray<TSubclassOf<ABlockActor>> ConstructableBlocks;
@@ -162,6 +200,9 @@ private:
 	UPROPERTY(Transient)
 	UBlockActorScene* BlockActorScene;
 
+	UPROPERTY(Transient)
+	ABlockInstanceActor* BlockInstances;
+
 	UPROPERTY(Transient)
 	ANavigation* Navigation;
 
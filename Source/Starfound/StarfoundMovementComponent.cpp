@@ -161,17 +161,17 @@ bool UStarfoundMovementComponent::IsFreefalling() const
 	const FIntPoint PawnLocation = BlockScene->WorldSpaceToOriginSpaceGrid(GetOwner()->GetActorLocation() + FVector(0, 0, BlockScene->GetGridCellSize() * 0.5f));
 	const FIntPoint FloorLocation = PawnLocation + FIntPoint(0, -1);
 
-	ABlockActor* FloorBlock = BlockScene->GetBlock(FloorLocation.X, FloorLocation.Y);
+	const bool bHasFloorBlock = BlockScene->HasBlock(FloorLocation.X, FloorLocation.Y);
 
-	if (!FloorBlock)
+	if (!bHasFloorBlock)
 	{
 		// See if we are climbing
 		if (FollowingPath.Num() > 0)
 		{
 			const FIntPoint SecondFloorLocation = PawnLocation + FIntPoint(0, -2);
-			ABlockActor* SecondFloorBlock = BlockScene->GetBlock(SecondFloorLocation.X, SecondFloorLocation.Y);
+			const bool bHasSecondFloorBlock = BlockScene->HasBlock(SecondFloorLocation.X, SecondFloorLocation.Y);
 
-			if (SecondFloorBlock)
+			if (bHasSecondFloorBlock)
 			{
 				return false;
 			}
@@ -194,13 +194,13 @@ void UStarfoundMovementComponent::PopupIfBuried()
 
 	const FIntPoint PawnLocation = BlockScene->WorldSpaceToOriginSpaceGrid(GetOwner()->GetActorLocation());
 
-	const bool bIsBuried = (BlockScene->GetBlock(PawnLocation) != nullptr);
+	const bool bIsBuried = BlockScene->HasBlock(PawnLocation.X, PawnLocation.Y);
 
 	if (bIsBuried)
 	{
 		bool bHasEnoughSpaceToPop = 
-			(BlockScene->GetBlock(PawnLocation + FIntPoint(0, 1)) == nullptr)
-			&& (BlockScene->GetBlock(PawnLocation + FIntPoint(0, 2)) == nullptr);
+			!BlockScene->HasBlock(PawnLocation.X, PawnLocation.Y + 1)
+			&& !BlockScene->HasBlock(PawnLocation.X, PawnLocation.Y + 2);
 
 		if (bHasEnoughSpaceToPop)
 		{
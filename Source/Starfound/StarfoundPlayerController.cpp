@@ -79,12 +79,26 @@ void AStarfoundPlayerController::DestructBlock()
 	FHitResult HitResult;
 	bool bHitFound = GetHitResultUnderCursorByChannel(UEngineTypes::ConvertToTraceType(ECollisionChannel::ECC_WorldStatic), true, HitResult);
 
-	if (bHitFound && HitResult.Actor.IsValid() && HitResult.Actor->IsA(ABlockActor::StaticClass()))
+	if (!bHitFound || !HitResult.Actor.IsValid())
 	{
-		const FIntPoint GridLocation = BlockScene->WorldSpaceToOriginSpaceGrid(HitResult.Actor->GetActorLocation());
+		return;
+	}
+
+	ABlockActor* BlockActor = Cast<ABlockActor>(HitResult.Actor.Get());
+
+	// Instanced blocks get an actor once there is something to do with them
+	ABlockInstanceActor* BlockInstances = Cast<ABlockInstanceActor>(HitResult.Actor.Get());
+	FIntPoint InstanceCell;
 
+	if (BlockInstances && BlockInstances->GetHitCell(HitResult, InstanceCell))
+	{
+		BlockActor = BlockInstances->PromoteBlock(InstanceCell);
+	}
+
+	if (BlockActor)
+	{
 		FStarfoundJob Job;
-		Job.InitDestruct(Cast<ABlockActor>(HitResult.Actor.Get()));
+		Job.InitDestruct(BlockActor);
 
 		Cast<AStarfoundGameMode>(GetWorld()->GetAuthGameMode())->GetJobQueue()->AddJob(Job);
 	}
@@ -97,7 +111,7 @@ void AStarfoundPlayerController::MoveToCursorLocation()
 		return;
 	}
 
-	SelectedPawn->GetAIController()->MoveToLocation(GetCursorLocation());
+	SelectedPawn->GetAIController()->RequestMoveToLocation(GetCursorLocation(), ENavRequestPriority::High);
 }
 
 FVector AStarfoundPlayerController::GetCursorLocation()